@@ -15,15 +15,45 @@ split src/gui.h
 tabnew src/playlist.c
 split src/playlist.h
 
+tabnew src/plcache.c
+split src/plcache.h
+
 tabnew src/library.c
 split src/library.h
 
 tabnew src/pathbar.c
 split src/pathbar.h
 
+tabnew src/cellrenderer.c
+split src/cellrenderer.h
+
+tabnew src/libcache.c
+split src/libcache.h
+
+tabnew src/listcache.c
+split src/listcache.h
+
+tabnew src/libindex.c
+split src/libindex.h
+
+tabnew src/tagsort.c
+split src/tagsort.h
+
+tabnew src/art.c
+split src/art.h
+
 tabnew src/client.c
 split src/client.h
 
+tabnew src/selection.c
+split src/selection.h
+
+tabnew src/foldbuf.c
+split src/foldbuf.h
+
+tabnew src/strsearch.c
+split src/strsearch.h
+
 tabnew src/songattr.c
 split src/songattr.h
 
@@ -0,0 +1,552 @@
+#include <string.h>
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <mpd/client.h>
+
+#include "art.h"
+#include "client.h"
+#include "profile.h"
+#include "util.h"
+
+enum art_job_type {
+	ART_JOB_LOAD, /* read thumbnail from disk */
+	ART_JOB_DECODE /* decode received picture and store its thumbnail */
+};
+
+/**
+  Work done by a worker thread. Only @a pixbuf is written by the worker.
+  */
+struct art_job {
+	struct art_cache *art;
+	enum art_job_type type;
+	guint generation; /** Generation of the cache when the job was created */
+	gchar *key;
+	gchar *path; /** Thumbnail file or NULL */
+	GBytes *data; /** Picture to decode */
+	GdkPixbuf *pixbuf; /** Thumbnail or NULL */
+	GList link; /** Link in the queue of jobs of the cache */
+};
+
+static void art_job_free(struct art_job *job)
+{
+	g_free(job->key);
+	g_free(job->path);
+	if (job->data) {
+		g_bytes_unref(job->data);
+	}
+	if (job->pixbuf) {
+		g_object_unref(job->pixbuf);
+	}
+	g_free(job);
+}
+
+static void art_request_free(gpointer data)
+{
+	struct art_request *request = (struct art_request *) data;
+
+	g_free(request->key);
+	g_free(request->uri);
+	if (request->data) {
+		g_byte_array_free(request->data, TRUE);
+	}
+	g_list_free_full(request->waiters, g_free);
+	g_free(request);
+}
+
+static void art_entry_free(gpointer data)
+{
+	struct art_entry *entry = (struct art_entry *) data;
+
+	g_free(entry->key);
+	if (entry->pixbuf) {
+		g_object_unref(entry->pixbuf);
+	}
+	g_free(entry);
+}
+
+/**
+  @brief Scale pictures while they are decoded, so that a full size bitmap is
+  never allocated for large covers.
+  */
+static void art_size_prepared(GdkPixbufLoader *loader, gint width, gint height, gpointer data)
+{
+	if (width <= ART_THUMB_SIZE && height <= ART_THUMB_SIZE) {
+		return;
+	}
+
+	if (width > height) {
+		gdk_pixbuf_loader_set_size(loader, ART_THUMB_SIZE, MAX(1, height * ART_THUMB_SIZE / width));
+	} else {
+		gdk_pixbuf_loader_set_size(loader, MAX(1, width * ART_THUMB_SIZE / height), ART_THUMB_SIZE);
+	}
+}
+
+static GdkPixbuf *art_decode(GBytes *data)
+{
+	GdkPixbufLoader *loader;
+	GdkPixbuf *pixbuf = NULL;
+	GError *err = NULL;
+	gsize len;
+	const guchar *buf;
+
+	buf = g_bytes_get_data(data, &len);
+
+	loader = gdk_pixbuf_loader_new();
+	g_signal_connect(loader, "size-prepared", G_CALLBACK(art_size_prepared), NULL);
+	if (gdk_pixbuf_loader_write(loader, buf, len, &err) && gdk_pixbuf_loader_close(loader, &err)) {
+		pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+		if (pixbuf) {
+			g_object_ref(pixbuf);
+		}
+	} else {
+		MSG_WARNING("couldn't decode album art: %s", err->message);
+		g_error_free(err);
+		/* the loader complains when it's not closed */
+		gdk_pixbuf_loader_close(loader, NULL);
+	}
+	g_object_unref(loader);
+
+	return pixbuf;
+}
+
+static void art_save(GdkPixbuf *pixbuf, const gchar *path)
+{
+	gchar *buf;
+	gsize len;
+	GError *err = NULL;
+
+	if (!gdk_pixbuf_save_to_buffer(pixbuf, &buf, &len, "png", &err, NULL)) {
+		MSG_WARNING("couldn't encode thumbnail: %s", err->message);
+		g_error_free(err);
+		return;
+	}
+
+	/* written atomically, other instances may read it */
+	if (!g_file_set_contents(path, buf, len, &err)) {
+		MSG_WARNING("couldn't save thumbnail: %s", err->message);
+		g_error_free(err);
+	}
+	g_free(buf);
+}
+
+static void art_cache_finish(struct art_cache *art, const gchar *key, GdkPixbuf *pixbuf, gboolean local);
+static void art_fetch_next(struct art_cache *art);
+
+/**
+  @brief Take over results of a finished job in the GTK thread.
+  */
+static gboolean art_job_done(gpointer data)
+{
+	struct art_job *job = (struct art_job *) data;
+	struct art_cache *art = job->art;
+	struct art_request *request;
+
+	g_queue_unlink(&art->jobs, &job->link);
+
+	if (job->generation != art->generation) {
+		art_job_free(job);
+		return G_SOURCE_REMOVE;
+	}
+
+	request = g_hash_table_lookup(art->requests, job->key);
+
+	if (job->type == ART_JOB_LOAD && !job->pixbuf && request && request->uri && art->mpdsource) {
+		g_queue_push_tail(&art->fetches, request);
+		if (art->fetches.length == 1) {
+			art_fetch_next(art);
+		}
+	} else {
+		/* a miss on disk only says the server wasn't asked */
+		art_cache_finish(art, job->key, job->pixbuf, job->type == ART_JOB_LOAD);
+	}
+
+	art_job_free(job);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void art_job_run(gpointer data, gpointer user_data)
+{
+	struct art_job *job = (struct art_job *) data;
+
+	switch (job->type) {
+	case ART_JOB_LOAD:
+		if (job->path) {
+			/* missing file is not an error */
+			job->pixbuf = gdk_pixbuf_new_from_file(job->path, NULL);
+		}
+		break;
+	case ART_JOB_DECODE:
+		job->pixbuf = art_decode(job->data);
+		if (job->pixbuf && job->path) {
+			art_save(job->pixbuf, job->path);
+		}
+		break;
+	}
+
+	g_idle_add(art_job_done, job);
+}
+
+static void art_job_push(struct art_cache *art, enum art_job_type type, const gchar *key, GBytes *data)
+{
+	struct art_job *job;
+	gchar *sum;
+	gchar *name;
+
+	job = g_malloc(sizeof(struct art_job));
+	job->art = art;
+	job->type = type;
+	job->generation = art->generation;
+	job->key = g_strdup(key);
+	job->path = NULL;
+	job->data = data;
+	job->pixbuf = NULL;
+	job->link.data = job;
+	job->link.prev = NULL;
+	job->link.next = NULL;
+
+	if (art->dir) {
+		sum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+		name = g_strconcat(sum, ".png", NULL);
+		job->path = g_build_filename(art->dir, name, NULL);
+		g_free(name);
+		g_free(sum);
+	}
+
+	g_queue_push_tail_link(&art->jobs, &job->link);
+	g_thread_pool_push(art->pool, job, NULL);
+}
+
+struct art_cache *art_cache_new(void)
+{
+	struct art_cache *art;
+
+	art = g_malloc(sizeof(struct art_cache));
+	art->mpdsource = NULL;
+	art->dir = NULL;
+	art->generation = 0;
+	art->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, art_entry_free);
+	g_queue_init(&art->lru);
+	art->requests = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, art_request_free);
+	g_queue_init(&art->fetches);
+	art->pool = g_thread_pool_new(art_job_run, NULL, ART_WORKERS, FALSE, NULL);
+	g_queue_init(&art->jobs);
+
+	return art;
+}
+
+void art_cache_free(struct art_cache *art)
+{
+	struct art_job *job;
+
+	/* running jobs finish, queued ones are dropped */
+	g_thread_pool_free(art->pool, TRUE, TRUE);
+	/* finished jobs wait for art_job_done() which must not run anymore */
+	while ((job = g_queue_pop_head(&art->jobs))) {
+		g_idle_remove_by_data(job);
+		art_job_free(job);
+	}
+	g_queue_clear(&art->fetches);
+	g_hash_table_destroy(art->requests);
+	g_hash_table_destroy(art->entries);
+	g_free(art->dir);
+	g_free(art);
+}
+
+void art_cache_set_source(struct art_cache *art, GSource *source, const gchar *profile)
+{
+	art->generation++;
+	g_queue_clear(&art->fetches);
+	g_hash_table_remove_all(art->requests);
+	/* another server may have different art */
+	g_queue_init(&art->lru);
+	g_hash_table_remove_all(art->entries);
+
+	g_free(art->dir);
+	art->dir = NULL;
+	art->mpdsource = source;
+
+	if (profile) {
+		art->dir = sonatina_profile_cache_path(profile, "art");
+		if (g_mkdir_with_parents(art->dir, 0700)) {
+			MSG_WARNING("couldn't create directory for thumbnails %s", art->dir);
+			g_free(art->dir);
+			art->dir = NULL;
+		}
+	}
+
+	if (source) {
+		mpd_source_register(source, MPD_CMD_ALBUMART, art_picture_cb, art);
+		mpd_source_register(source, MPD_CMD_READPICTURE, art_picture_cb, art);
+		mpd_source_register_error(source, art_error_cb, art);
+		mpd_send(source, MPD_CMD_BINARYLIMIT, ART_BINARY_LIMIT, NULL);
+	}
+}
+
+gchar *art_album_key(const gchar *artist, const gchar *album)
+{
+	/* MPD tags can't contain newlines */
+	return g_strdup_printf("%s\n%s", artist ? artist : "", album ? album : "");
+}
+
+gchar *art_song_key(const struct mpd_song *song)
+{
+	const gchar *album;
+	const gchar *artist;
+	gchar *dir;
+	gchar *key;
+
+	album = mpd_song_get_tag(song, MPD_TAG_ALBUM, 0);
+	if (!album) {
+		/* songs without album share art of their directory */
+		dir = g_path_get_dirname(mpd_song_get_uri(song));
+		key = g_strdup_printf("\n\n%s", dir);
+		g_free(dir);
+		return key;
+	}
+
+	artist = mpd_song_get_tag(song, MPD_TAG_ALBUM_ARTIST, 0);
+	if (!artist) {
+		artist = mpd_song_get_tag(song, MPD_TAG_ARTIST, 0);
+	}
+
+	return art_album_key(artist, album);
+}
+
+gboolean art_cache_lookup(struct art_cache *art, const gchar *key, const gchar *uri, GdkPixbuf **pixbuf)
+{
+	struct art_entry *entry;
+
+	entry = g_hash_table_lookup(art->entries, key);
+	if (!entry) {
+		return FALSE;
+	}
+
+	if (entry->local && !entry->pixbuf && uri && art->mpdsource) {
+		/* fetched by a new request */
+		return FALSE;
+	}
+
+	g_queue_unlink(&art->lru, &entry->link);
+	g_queue_push_head_link(&art->lru, &entry->link);
+	*pixbuf = entry->pixbuf;
+
+	return TRUE;
+}
+
+gboolean art_cache_pending(struct art_cache *art, const gchar *key)
+{
+	return g_hash_table_contains(art->requests, key);
+}
+
+void art_cache_request(struct art_cache *art, const gchar *key, const gchar *uri, ArtFunc func, gpointer data)
+{
+	struct art_request *request;
+	struct art_waiter *waiter;
+	GdkPixbuf *pixbuf;
+
+	if (art_cache_lookup(art, key, uri, &pixbuf)) {
+		func(key, pixbuf, data);
+		return;
+	}
+
+	waiter = g_malloc(sizeof(struct art_waiter));
+	waiter->func = func;
+	waiter->data = data;
+
+	request = g_hash_table_lookup(art->requests, key);
+	if (request) {
+		request->waiters = g_list_prepend(request->waiters, waiter);
+		if (!request->uri && uri) {
+			/* fetched if it's not on disk */
+			request->uri = g_strdup(uri);
+		}
+		return;
+	}
+
+	request = g_malloc(sizeof(struct art_request));
+	request->key = g_strdup(key);
+	request->uri = g_strdup(uri);
+	request->data = NULL;
+	request->cmd = MPD_CMD_NONE;
+	request->waiters = g_list_prepend(NULL, waiter);
+	g_hash_table_insert(art->requests, request->key, request);
+
+	art_job_push(art, ART_JOB_LOAD, key, NULL);
+}
+
+void art_cache_cancel(struct art_cache *art, gpointer data)
+{
+	struct art_request *request;
+	struct art_waiter *waiter;
+	GHashTableIter iter;
+	GList *cur, *next;
+
+	g_hash_table_iter_init(&iter, art->requests);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &request)) {
+		for (cur = request->waiters; cur; cur = next) {
+			next = cur->next;
+			waiter = cur->data;
+			if (waiter->data == data) {
+				g_free(waiter);
+				request->waiters = g_list_delete_link(request->waiters, cur);
+			}
+		}
+	}
+}
+
+/**
+  @brief Remember art of an album and pass it to everyone waiting for it.
+  */
+static void art_cache_finish(struct art_cache *art, const gchar *key, GdkPixbuf *pixbuf, gboolean local)
+{
+	struct art_request *request;
+	struct art_entry *entry;
+	struct art_waiter *waiter;
+	GList *waiters;
+	GList *cur;
+
+	entry = g_hash_table_lookup(art->entries, key);
+	if (entry) {
+		g_queue_unlink(&art->lru, &entry->link);
+		g_hash_table_remove(art->entries, key);
+	}
+
+	entry = g_malloc(sizeof(struct art_entry));
+	entry->key = g_strdup(key);
+	entry->pixbuf = pixbuf ? g_object_ref(pixbuf) : NULL;
+	entry->local = local;
+	entry->link.data = entry;
+	entry->link.prev = NULL;
+	entry->link.next = NULL;
+	g_hash_table_insert(art->entries, entry->key, entry);
+	g_queue_push_head_link(&art->lru, &entry->link);
+
+	while (art->lru.length > ART_MEMORY_ENTRIES) {
+		entry = g_queue_peek_tail(&art->lru);
+		g_queue_unlink(&art->lru, &entry->link);
+		g_hash_table_remove(art->entries, entry->key);
+	}
+
+	request = g_hash_table_lookup(art->requests, key);
+	if (!request) {
+		return;
+	}
+
+	/* waiters may request more art */
+	waiters = request->waiters;
+	request->waiters = NULL;
+	g_hash_table_remove(art->requests, key);
+
+	for (cur = waiters; cur; cur = cur->next) {
+		waiter = cur->data;
+		waiter->func(key, pixbuf, waiter->data);
+	}
+	g_list_free_full(waiters, g_free);
+}
+
+static void art_fetch_send(struct art_cache *art, struct art_request *request)
+{
+	gchar offset[24];
+
+	g_snprintf(offset, sizeof(offset), "%u", request->data->len);
+	mpd_send(art->mpdsource, request->cmd, request->uri, offset, NULL);
+}
+
+/**
+  @brief Start fetching the first waiting request.
+  */
+static void art_fetch_next(struct art_cache *art)
+{
+	struct art_request *request;
+
+	request = g_queue_peek_head(&art->fetches);
+	if (!request) {
+		return;
+	}
+
+	MSG_DEBUG("fetching album art of %s", request->uri);
+	/* cover files are preferred to pictures embedded in songs */
+	request->cmd = MPD_CMD_ALBUMART;
+	request->data = g_byte_array_new();
+	art_fetch_send(art, request);
+}
+
+/**
+  @brief Try another way of getting the picture or give up.
+  */
+static void art_fetch_failed(struct art_cache *art, struct art_request *request)
+{
+	if (request->cmd == MPD_CMD_ALBUMART) {
+		request->cmd = MPD_CMD_READPICTURE;
+		g_byte_array_set_size(request->data, 0);
+		art_fetch_send(art, request);
+		return;
+	}
+
+	g_queue_pop_head(&art->fetches);
+	art_cache_finish(art, request->key, NULL, FALSE);
+	art_fetch_next(art);
+}
+
+/**
+  @brief Get the request an answer belongs to.
+  */
+static struct art_request *art_fetch_current(struct art_cache *art, enum mpd_cmd_type cmd, GList *args)
+{
+	struct art_request *request;
+
+	request = g_queue_peek_head(&art->fetches);
+	if (!request || request->cmd != cmd || !args || g_strcmp0(args->data, request->uri)) {
+		return NULL;
+	}
+
+	return request;
+}
+
+void art_picture_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct art_cache *art = (struct art_cache *) data;
+	struct art_request *request;
+	GByteArray *chunk = answer->picture.data;
+
+	request = art_fetch_current(art, cmd, args);
+	if (!request) {
+		return;
+	}
+
+	if (!chunk || chunk->len == 0) {
+		/* readpicture answers nothing for songs without a picture */
+		art_fetch_failed(art, request);
+		return;
+	}
+
+	g_byte_array_append(request->data, chunk->data, chunk->len);
+	if (request->data->len < answer->picture.size) {
+		art_fetch_send(art, request);
+		return;
+	}
+
+	g_queue_pop_head(&art->fetches);
+	MSG_DEBUG("received %u bytes of album art", request->data->len);
+	art_job_push(art, ART_JOB_DECODE, request->key, g_byte_array_free_to_bytes(request->data));
+	request->data = NULL;
+
+	art_fetch_next(art);
+}
+
+void art_error_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct art_cache *art = (struct art_cache *) data;
+	struct art_request *request;
+
+	if (cmd == MPD_CMD_BINARYLIMIT) {
+		MSG_INFO("server doesn't support binarylimit, album art is received in small chunks");
+		return;
+	}
+
+	request = art_fetch_current(art, cmd, args);
+	if (request) {
+		art_fetch_failed(art, request);
+	}
+}
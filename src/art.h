@@ -0,0 +1,160 @@
+#ifndef ART_H
+#define ART_H
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include <mpd/client.h>
+
+#include "client.h"
+
+/*
+ * Album art fetched with MPD's albumart and readpicture commands. Pictures
+ * are decoded and scaled to thumbnails by worker threads, kept in memory in
+ * an LRU cache and on disk in the user's cache directory, keyed by album.
+ * The GTK thread only ever handles decoded thumbnails.
+ */
+
+#define ART_THUMB_SIZE 64 /** Maximal width and height of thumbnails */
+#define ART_MEMORY_ENTRIES 256 /** Number of albums kept in memory */
+#define ART_WORKERS 2 /** Number of threads decoding pictures */
+#define ART_BINARY_LIMIT "1048576" /** Size of picture chunks requested from
+				     the server; the default 8 KiB needs a
+				     round trip for every chunk */
+
+/**
+  @brief Function called when art of an album was loaded.
+  @param key Key of the album.
+  @param pixbuf Thumbnail or NULL if the album has no art.
+  @param data User data.
+  */
+typedef void (*ArtFunc)(const gchar *key, GdkPixbuf *pixbuf, gpointer data);
+
+/**
+  Thumbnail kept in memory.
+  */
+struct art_entry {
+	gchar *key;
+	GdkPixbuf *pixbuf; /** Thumbnail or NULL if the album has no art */
+	gboolean local; /** Only thumbnails on disk were searched, the server
+			  may still have art */
+	GList link; /** Link in the LRU queue */
+};
+
+/**
+  Art being loaded.
+  */
+struct art_request {
+	gchar *key;
+	gchar *uri; /** Song to fetch the art for or NULL if it's only looked up
+		      on disk */
+	GByteArray *data; /** Received part of the picture */
+	enum mpd_cmd_type cmd; /** Command fetching the picture or
+				 MPD_CMD_NONE */
+	GList *waiters; /** struct art_waiter */
+};
+
+struct art_waiter {
+	ArtFunc func;
+	gpointer data;
+};
+
+struct art_cache {
+	GSource *mpdsource; /** Connection pictures are fetched from or NULL */
+	gchar *dir; /** Directory of thumbnails or NULL */
+	guint generation; /** Incremented when the connection changes, so that
+			    results of older jobs are dropped */
+	GHashTable *entries; /** Maps keys to struct art_entry */
+	GQueue lru; /** Entries, most recently used first */
+	GHashTable *requests; /** Maps keys to struct art_request */
+	GQueue fetches; /** Requests waiting for the server, the first one is
+			  being received */
+	GThreadPool *pool; /** Workers loading and decoding pictures */
+	GQueue jobs; /** Jobs not taken over by the GTK thread yet */
+};
+
+/**
+  @brief Create art cache.
+  @returns Newly allocated cache that should be freed with @a art_cache_free().
+  */
+struct art_cache *art_cache_new(void);
+
+/**
+  @brief Free art cache. Waits for running workers, queued jobs are dropped.
+  @param art Art cache.
+  */
+void art_cache_free(struct art_cache *art);
+
+/**
+  @brief Set connection pictures are fetched from. Requests in progress are
+  dropped.
+  @param art Art cache.
+  @param source MPD source or NULL when disconnected.
+  @param profile Name of the connected profile used to locate thumbnails on
+  disk or NULL.
+  */
+void art_cache_set_source(struct art_cache *art, GSource *source, const gchar *profile);
+
+/**
+  @brief Get key of the album a song belongs to.
+  @param song MPD song.
+  @returns Newly allocated key that should be freed with g_free().
+  */
+gchar *art_song_key(const struct mpd_song *song);
+
+/**
+  @brief Get key of an album.
+  @param artist Album artist.
+  @param album Album name.
+  @returns Newly allocated key that should be freed with g_free().
+  */
+gchar *art_album_key(const gchar *artist, const gchar *album);
+
+/**
+  @brief Look up art in memory.
+  @param art Art cache.
+  @param key Key of the album.
+  @param uri URI of a song of the album or NULL. When given, albums only
+  missing on disk are not known yet as their art can be fetched.
+  @param pixbuf Location to store the thumbnail, owned by the cache, or NULL
+  if the album has no art.
+  @returns TRUE if art of the album is known, FALSE if it has to be requested.
+  */
+gboolean art_cache_lookup(struct art_cache *art, const gchar *key, const gchar *uri, GdkPixbuf **pixbuf);
+
+/**
+  @brief Check whether art of an album is being loaded.
+  @param art Art cache.
+  @param key Key of the album.
+  @returns TRUE if it's being loaded.
+  */
+gboolean art_cache_pending(struct art_cache *art, const gchar *key);
+
+/**
+  @brief Load art of an album from disk or fetch it from the server.
+  @param art Art cache.
+  @param key Key of the album.
+  @param uri URI of a song of the album or NULL if the art should only be
+  looked up on disk.
+  @param func Function called when the art is loaded.
+  @param data User data passed to @a func.
+  */
+void art_cache_request(struct art_cache *art, const gchar *key, const gchar *uri, ArtFunc func, gpointer data);
+
+/**
+  @brief Forget all waiters with given user data.
+  @param art Art cache.
+  @param data User data passed to @a art_cache_request().
+  */
+void art_cache_cancel(struct art_cache *art, gpointer data);
+
+/**
+  @brief Callback for answers to albumart and readpicture commands.
+  */
+void art_picture_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Callback for failed commands.
+  */
+void art_error_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+#endif
@@ -0,0 +1,274 @@
+#include "cellrenderer.h"
+
+/*
+ * Text cell renderer that keeps shaped PangoLayouts of recently rendered
+ * strings. GtkCellRendererText lays out the text again every time a cell is
+ * measured or drawn, which is what dominates scrolling through long lists.
+ * Layouts are looked up by text and font weight, so rows that change simply
+ * miss the cache; the cache is dropped when the widget's Pango context changes
+ * (font, direction, ...) and old entries are evicted in LRU order.
+ */
+
+#define CELL_RENDERER_CACHE_SIZE 4096
+
+enum {
+	PROP_0,
+	PROP_TEXT,
+	PROP_WEIGHT,
+	N_PROPS
+};
+
+struct layout_entry {
+	gchar *text; /** Key in the per-weight table */
+	gint weight;
+	PangoLayout *layout;
+	GList link; /** Link in the LRU queue */
+};
+
+typedef struct {
+	gchar *text; /** Text of the cell being rendered */
+	gint weight; /** Font weight of the cell being rendered */
+	GHashTable *layouts; /** Maps weight to a table mapping text to struct
+			       layout_entry */
+	GQueue lru; /** Entries, most recently used first */
+	PangoContext *context; /** Context the cached layouts belong to */
+	guint serial; /** Serial of the context when layouts were created */
+} SonatinaCellRendererTextPrivate;
+
+struct _SonatinaCellRendererText
+{
+  GtkCellRenderer parent_instance;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE(SonatinaCellRendererText, sonatina_cell_renderer_text, GTK_TYPE_CELL_RENDERER)
+
+static GParamSpec *cell_renderer_props[N_PROPS];
+
+static void layout_entry_free(gpointer data)
+{
+	struct layout_entry *entry = (struct layout_entry *) data;
+
+	g_object_unref(entry->layout);
+	g_free(entry->text);
+	g_free(entry);
+}
+
+static void sonatina_cell_renderer_text_set_property(GObject *object, guint id, const GValue *value, GParamSpec *pspec)
+{
+	SonatinaCellRendererTextPrivate *priv = sonatina_cell_renderer_text_get_instance_private(SONATINA_CELL_RENDERER_TEXT(object));
+
+	switch (id) {
+	case PROP_TEXT:
+		g_free(priv->text);
+		priv->text = g_value_dup_string(value);
+		break;
+	case PROP_WEIGHT:
+		priv->weight = g_value_get_int(value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, pspec);
+		break;
+	}
+}
+
+static void sonatina_cell_renderer_text_get_property(GObject *object, guint id, GValue *value, GParamSpec *pspec)
+{
+	SonatinaCellRendererTextPrivate *priv = sonatina_cell_renderer_text_get_instance_private(SONATINA_CELL_RENDERER_TEXT(object));
+
+	switch (id) {
+	case PROP_TEXT:
+		g_value_set_string(value, priv->text);
+		break;
+	case PROP_WEIGHT:
+		g_value_set_int(value, priv->weight);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, pspec);
+		break;
+	}
+}
+
+static void sonatina_cell_renderer_text_finalize(GObject *object)
+{
+	SonatinaCellRendererText *self = SONATINA_CELL_RENDERER_TEXT(object);
+	SonatinaCellRendererTextPrivate *priv = sonatina_cell_renderer_text_get_instance_private(self);
+
+	sonatina_cell_renderer_text_clear_cache(self);
+	g_hash_table_destroy(priv->layouts);
+	g_free(priv->text);
+
+	G_OBJECT_CLASS(sonatina_cell_renderer_text_parent_class)->finalize(object);
+}
+
+/**
+  @brief Get layout of the current text, shaping it only when it's not cached.
+  */
+static PangoLayout *cell_renderer_get_layout(SonatinaCellRendererText *self, GtkWidget *widget)
+{
+	SonatinaCellRendererTextPrivate *priv = sonatina_cell_renderer_text_get_instance_private(self);
+	PangoContext *context;
+	GHashTable *table;
+	struct layout_entry *entry;
+	PangoAttrList *attrs;
+	const gchar *text;
+
+	context = gtk_widget_get_pango_context(widget);
+	if (context != priv->context || pango_context_get_serial(context) != priv->serial) {
+		sonatina_cell_renderer_text_clear_cache(self);
+		priv->context = context;
+		priv->serial = pango_context_get_serial(context);
+	}
+
+	text = priv->text ? priv->text : "";
+
+	table = g_hash_table_lookup(priv->layouts, GINT_TO_POINTER(priv->weight));
+	if (!table) {
+		table = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, layout_entry_free);
+		g_hash_table_insert(priv->layouts, GINT_TO_POINTER(priv->weight), table);
+	}
+
+	entry = g_hash_table_lookup(table, text);
+	if (entry) {
+		g_queue_unlink(&priv->lru, &entry->link);
+		g_queue_push_head_link(&priv->lru, &entry->link);
+		return entry->layout;
+	}
+
+	if (priv->lru.length >= CELL_RENDERER_CACHE_SIZE) {
+		entry = (struct layout_entry *) g_queue_peek_tail(&priv->lru);
+		g_queue_unlink(&priv->lru, &entry->link);
+		g_hash_table_remove(g_hash_table_lookup(priv->layouts, GINT_TO_POINTER(entry->weight)), entry->text);
+	}
+
+	entry = g_malloc(sizeof(struct layout_entry));
+	entry->text = g_strdup(text);
+	entry->weight = priv->weight;
+	entry->layout = gtk_widget_create_pango_layout(widget, text);
+	if (priv->weight != PANGO_WEIGHT_NORMAL) {
+		attrs = pango_attr_list_new();
+		pango_attr_list_insert(attrs, pango_attr_weight_new(priv->weight));
+		pango_layout_set_attributes(entry->layout, attrs);
+		pango_attr_list_unref(attrs);
+	}
+	entry->link.data = entry;
+	entry->link.prev = NULL;
+	entry->link.next = NULL;
+
+	g_hash_table_insert(table, entry->text, entry);
+	g_queue_push_head_link(&priv->lru, &entry->link);
+
+	return entry->layout;
+}
+
+static void sonatina_cell_renderer_text_get_preferred_width(GtkCellRenderer *cell, GtkWidget *widget, gint *minimum, gint *natural)
+{
+	PangoLayout *layout;
+	PangoRectangle rect;
+	gint xpad;
+
+	layout = cell_renderer_get_layout(SONATINA_CELL_RENDERER_TEXT(cell), widget);
+	pango_layout_get_pixel_extents(layout, NULL, &rect);
+	gtk_cell_renderer_get_padding(cell, &xpad, NULL);
+
+	if (minimum) {
+		*minimum = rect.width + 2 * xpad;
+	}
+	if (natural) {
+		*natural = rect.width + 2 * xpad;
+	}
+}
+
+static void sonatina_cell_renderer_text_get_preferred_height(GtkCellRenderer *cell, GtkWidget *widget, gint *minimum, gint *natural)
+{
+	PangoLayout *layout;
+	PangoRectangle rect;
+	gint ypad;
+
+	layout = cell_renderer_get_layout(SONATINA_CELL_RENDERER_TEXT(cell), widget);
+	pango_layout_get_pixel_extents(layout, NULL, &rect);
+	gtk_cell_renderer_get_padding(cell, NULL, &ypad);
+
+	if (minimum) {
+		*minimum = rect.height + 2 * ypad;
+	}
+	if (natural) {
+		*natural = rect.height + 2 * ypad;
+	}
+}
+
+static void sonatina_cell_renderer_text_render(GtkCellRenderer *cell, cairo_t *cr, GtkWidget *widget,
+		const GdkRectangle *background_area, const GdkRectangle *cell_area, GtkCellRendererState flags)
+{
+	PangoLayout *layout;
+	PangoRectangle rect;
+	gint xpad, ypad;
+	gfloat xalign, yalign;
+	gint x, y;
+
+	layout = cell_renderer_get_layout(SONATINA_CELL_RENDERER_TEXT(cell), widget);
+	pango_layout_get_pixel_extents(layout, NULL, &rect);
+	gtk_cell_renderer_get_padding(cell, &xpad, &ypad);
+	gtk_cell_renderer_get_alignment(cell, &xalign, &yalign);
+
+	if (gtk_widget_get_direction(widget) == GTK_TEXT_DIR_RTL) {
+		xalign = 1.0 - xalign;
+	}
+
+	x = cell_area->x + xpad + MAX(0, xalign * (cell_area->width - 2 * xpad - rect.width));
+	y = cell_area->y + ypad + MAX(0, yalign * (cell_area->height - 2 * ypad - rect.height));
+
+	cairo_save(cr);
+	gdk_cairo_rectangle(cr, cell_area);
+	cairo_clip(cr);
+	gtk_render_layout(gtk_widget_get_style_context(widget), cr, x - rect.x, y - rect.y, layout);
+	cairo_restore(cr);
+}
+
+static void sonatina_cell_renderer_text_class_init(SonatinaCellRendererTextClass *class)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(class);
+	GtkCellRendererClass *cell_class = GTK_CELL_RENDERER_CLASS(class);
+
+	object_class->set_property = sonatina_cell_renderer_text_set_property;
+	object_class->get_property = sonatina_cell_renderer_text_get_property;
+	object_class->finalize = sonatina_cell_renderer_text_finalize;
+
+	cell_class->get_preferred_width = sonatina_cell_renderer_text_get_preferred_width;
+	cell_class->get_preferred_height = sonatina_cell_renderer_text_get_preferred_height;
+	cell_class->render = sonatina_cell_renderer_text_render;
+
+	cell_renderer_props[PROP_TEXT] = g_param_spec_string("text", "Text", "Text to render",
+			NULL, G_PARAM_READWRITE);
+	cell_renderer_props[PROP_WEIGHT] = g_param_spec_int("weight", "Font weight", "Font weight of the text",
+			0, G_MAXINT, PANGO_WEIGHT_NORMAL, G_PARAM_READWRITE);
+	g_object_class_install_properties(object_class, N_PROPS, cell_renderer_props);
+}
+
+static void sonatina_cell_renderer_text_init(SonatinaCellRendererText *self)
+{
+	SonatinaCellRendererTextPrivate *priv = sonatina_cell_renderer_text_get_instance_private(self);
+
+	priv->text = NULL;
+	priv->weight = PANGO_WEIGHT_NORMAL;
+	priv->layouts = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_hash_table_destroy);
+	g_queue_init(&priv->lru);
+	priv->context = NULL;
+	priv->serial = 0;
+
+	gtk_cell_renderer_set_padding(GTK_CELL_RENDERER(self), 2, 2);
+}
+
+GtkCellRenderer *sonatina_cell_renderer_text_new(void)
+{
+	return GTK_CELL_RENDERER(g_object_new(SONATINA_TYPE_CELL_RENDERER_TEXT, NULL));
+}
+
+void sonatina_cell_renderer_text_clear_cache(SonatinaCellRendererText *self)
+{
+	SonatinaCellRendererTextPrivate *priv = sonatina_cell_renderer_text_get_instance_private(self);
+
+	/* entries are owned by the tables */
+	g_queue_init(&priv->lru);
+	g_hash_table_remove_all(priv->layouts);
+	priv->context = NULL;
+}
@@ -0,0 +1,23 @@
+#ifndef SONATINA__CELLRENDERER_H
+#define SONATINA__CELLRENDERER_H
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Type declaration.
+ */
+#define SONATINA_TYPE_CELL_RENDERER_TEXT sonatina_cell_renderer_text_get_type()
+G_DECLARE_FINAL_TYPE(SonatinaCellRendererText, sonatina_cell_renderer_text, SONATINA, CELL_RENDERER_TEXT, GtkCellRenderer)
+
+/*
+ * Method definitions.
+ */
+GtkCellRenderer *sonatina_cell_renderer_text_new(void);
+void sonatina_cell_renderer_text_clear_cache(SonatinaCellRendererText *self);
+
+G_END_DECLS
+
+#endif
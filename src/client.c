@@ -144,6 +144,26 @@ const char *mpd_cmd_to_str(enum mpd_cmd_type cmd)
 		return "consume";
 	case MPD_CMD_SHUFFLE:
 		return "shuffle";
+	case MPD_CMD_PLCHANGES:
+		return "plchanges";
+	case MPD_CMD_LSINFO_RAW:
+		return "lsinfo";
+	case MPD_CMD_ALBUMART:
+		return "albumart";
+	case MPD_CMD_READPICTURE:
+		return "readpicture";
+	case MPD_CMD_BINARYLIMIT:
+		return "binarylimit";
+	case MPD_CMD_SEARCH:
+		return "search";
+	case MPD_CMD_COUNTSONGS:
+		return "count";
+	case MPD_CMD_TAGTYPES:
+		return "tagtypes";
+	case MPD_CMD_PLAYID:
+		return "playid";
+	case MPD_CMD_PLID:
+		return "playlistid";
 	default:
 		return NULL;
 	}
@@ -159,6 +179,9 @@ struct mpd_cmd *mpd_cmd_new(enum mpd_cmd_type type)
 	cmd->parse_pair = NULL;
 	cmd->process = NULL;
 	cmd->free_answer = NULL;
+	cmd->parse_binary = NULL;
+	cmd->binary = 0;
+	cmd->serial = 0;
 
 	switch (type) {
 	case MPD_CMD_CURRENTSONG:
@@ -170,6 +193,7 @@ struct mpd_cmd *mpd_cmd_new(enum mpd_cmd_type type)
 		cmd->answer.status = NULL;
 		break;
 	case MPD_CMD_STATS:
+		cmd->parse_pair = parse_pair_stats;
 		cmd->answer.stats = NULL;
 		break;
 	case MPD_CMD_IDLE:
@@ -178,6 +202,8 @@ struct mpd_cmd *mpd_cmd_new(enum mpd_cmd_type type)
 		cmd->answer.idle = 0;
 		break;
 	case MPD_CMD_PLINFO:
+	case MPD_CMD_PLCHANGES:
+	case MPD_CMD_PLID:
 		cmd->parse_pair = parse_pair_plsong;
 		cmd->process = cmd_process_plinfo;
 		cmd->answer.plinfo.song = NULL;
@@ -185,6 +211,7 @@ struct mpd_cmd *mpd_cmd_new(enum mpd_cmd_type type)
 		break;
 	case MPD_CMD_LSINFO:
 	case MPD_CMD_FIND:
+	case MPD_CMD_SEARCH:
 	case MPD_CMD_LISTPL:
 	case MPD_CMD_LISTPLINFO:
 	case MPD_CMD_LISTPLS:
@@ -198,6 +225,26 @@ struct mpd_cmd *mpd_cmd_new(enum mpd_cmd_type type)
 		cmd->process = cmd_process_list;
 		cmd->answer.list.entity = NULL;
 		cmd->answer.list.list = NULL;
+		cmd->answer.list.tag = NULL;
+		cmd->answer.list.complete = FALSE;
+		break;
+	case MPD_CMD_LSINFO_RAW:
+		cmd->parse_pair = parse_pair_raw;
+		cmd->answer.pairs = NULL;
+		break;
+	case MPD_CMD_ALBUMART:
+	case MPD_CMD_READPICTURE:
+		cmd->parse_pair = parse_pair_picture;
+		cmd->parse_binary = parse_binary_picture;
+		cmd->answer.picture.size = 0;
+		cmd->answer.picture.data = NULL;
+		break;
+	case MPD_CMD_COUNTSONGS:
+		cmd->parse_pair = parse_pair_count;
+		cmd->process = cmd_process_count;
+		cmd->answer.count.songs = 0;
+		cmd->answer.count.playtime = 0;
+		cmd->answer.count.groups = NULL;
 		break;
 	default:
 		break;
@@ -206,6 +253,14 @@ struct mpd_cmd *mpd_cmd_new(enum mpd_cmd_type type)
 	return cmd;
 }
 
+static void mpd_count_group_free(gpointer data)
+{
+	struct mpd_count_group *group = (struct mpd_count_group *) data;
+
+	g_free(group->name);
+	g_free(group);
+}
+
 void mpd_cmd_free(struct mpd_cmd *cmd)
 {
 	if (!cmd) {
@@ -218,16 +273,24 @@ void mpd_cmd_free(struct mpd_cmd *cmd)
 			mpd_status_free(cmd->answer.status);
 		}
 		break;
+	case MPD_CMD_STATS:
+		if (cmd->answer.stats) {
+			mpd_stats_free(cmd->answer.stats);
+		}
+		break;
 	case MPD_CMD_CURRENTSONG:
 		if (cmd->answer.song) {
 			mpd_song_free(cmd->answer.song);
 		}
 		break;
 	case MPD_CMD_PLINFO:
+	case MPD_CMD_PLCHANGES:
+	case MPD_CMD_PLID:
 		g_list_free_full(cmd->answer.plinfo.list, (GDestroyNotify) mpd_song_free);
 		break;
 	case MPD_CMD_LSINFO:
 	case MPD_CMD_FIND:
+	case MPD_CMD_SEARCH:
 	case MPD_CMD_LISTPL:
 	case MPD_CMD_LISTPLINFO:
 	case MPD_CMD_LISTPLS:
@@ -236,6 +299,20 @@ void mpd_cmd_free(struct mpd_cmd *cmd)
 	case MPD_CMD_LIST:
 		g_list_free_full(cmd->answer.list.list, (GDestroyNotify) mpd_tag_entity_free);
 		break;
+	case MPD_CMD_LSINFO_RAW:
+		if (cmd->answer.pairs) {
+			g_ptr_array_free(cmd->answer.pairs, TRUE);
+		}
+		break;
+	case MPD_CMD_ALBUMART:
+	case MPD_CMD_READPICTURE:
+		if (cmd->answer.picture.data) {
+			g_byte_array_free(cmd->answer.picture.data, TRUE);
+		}
+		break;
+	case MPD_CMD_COUNTSONGS:
+		g_list_free_full(cmd->answer.count.groups, mpd_count_group_free);
+		break;
 	default:
 		break;
 	}
@@ -247,14 +324,13 @@ void mpd_cmd_free(struct mpd_cmd *cmd)
 
 void cmd_process_idle(union mpd_cmd_answer *answer)
 {
+	/* the playlist tab syncs the queue when its version in the status changes */
 	if (answer->idle & MPD_CHANGED_PLAYER ||
+	    answer->idle & MPD_CHANGED_PL ||
 	    answer->idle & MPD_CHANGED_MIXER ||
 	    answer->idle & MPD_CHANGED_OPTIONS ) {
 		mpd_send(sonatina.mpdsource, MPD_CMD_STATUS, NULL);
 	}
-	if (answer->idle & MPD_CHANGED_PL) {
-		mpd_send(sonatina.mpdsource, MPD_CMD_PLINFO, NULL);
-	}
 	if (answer->idle & MPD_CHANGED_PLAYER) {
 		mpd_send(sonatina.mpdsource, MPD_CMD_CURRENTSONG, NULL);
 	}
@@ -301,6 +377,20 @@ gboolean parse_pair_status(union mpd_cmd_answer *answer, const struct mpd_pair *
 	return TRUE;
 }
 
+gboolean parse_pair_stats(union mpd_cmd_answer *answer, const struct mpd_pair *pair)
+{
+	if (!(answer->stats)) {
+		answer->stats = mpd_stats_begin();
+		if (!(answer->stats)) {
+			MSG_ERROR("Couldn't allocate mpd stats");
+			return FALSE;
+		}
+	}
+	mpd_stats_feed(answer->stats, pair);
+
+	return TRUE;
+}
+
 gboolean parse_pair_song(union mpd_cmd_answer *answer, const struct mpd_pair *pair)
 {
 	if (answer->song) {
@@ -359,13 +449,24 @@ gboolean parse_pair_lsinfo(union mpd_cmd_answer *answer, const struct mpd_pair *
 
 gboolean parse_pair_list(union mpd_cmd_answer *answer, const struct mpd_pair *pair)
 {
+	struct mpd_tag_entity *prev;
+
 	if (!answer->list.entity) {
 		answer->list.entity = mpd_tag_entity_begin(pair);
-	} else if (!mpd_tag_entity_feed(answer->list.entity, pair)) {
-		answer->list.list = g_list_prepend(answer->list.list, answer->list.entity);
-		answer->list.entity = mpd_tag_entity_begin(pair);
+	} else if (answer->list.complete || !mpd_tag_entity_feed(answer->list.entity, pair)) {
+		prev = answer->list.entity;
+		answer->list.list = g_list_prepend(answer->list.list, prev);
+		if (answer->list.tag) {
+			/* group values are only sent when they change */
+			answer->list.entity = mpd_tag_entity_next(prev, pair, answer->list.tag);
+		} else {
+			answer->list.entity = mpd_tag_entity_begin(pair);
+		}
 	}
 
+	/* group values precede the listed value of every entity */
+	answer->list.complete = !answer->list.tag || !g_ascii_strcasecmp(pair->name, answer->list.tag);
+
 	return TRUE;
 }
 
@@ -404,6 +505,100 @@ gboolean parse_pair_idle(union mpd_cmd_answer *answer, const struct mpd_pair *pa
 	return TRUE;
 }
 
+gboolean parse_pair_raw(union mpd_cmd_answer *answer, const struct mpd_pair *pair)
+{
+	if (!answer->pairs) {
+		answer->pairs = g_ptr_array_new_with_free_func(g_free);
+	}
+
+	g_ptr_array_add(answer->pairs, g_strdup(pair->name));
+	g_ptr_array_add(answer->pairs, g_strdup(pair->value));
+
+	return TRUE;
+}
+
+gboolean parse_pair_picture(union mpd_cmd_answer *answer, const struct mpd_pair *pair)
+{
+	if (!strcmp(pair->name, "size")) {
+		answer->picture.size = g_ascii_strtoull(pair->value, NULL, 10);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+gboolean parse_pair_count(union mpd_cmd_answer *answer, const struct mpd_pair *pair)
+{
+	struct mpd_count_group *group;
+
+	/* with group, every tag value is followed by its counts */
+	group = answer->count.groups ? answer->count.groups->data : NULL;
+
+	if (!strcmp(pair->name, "songs")) {
+		if (group) {
+			group->songs = g_ascii_strtoull(pair->value, NULL, 10);
+		} else {
+			answer->count.songs = g_ascii_strtoull(pair->value, NULL, 10);
+		}
+	} else if (!strcmp(pair->name, "playtime")) {
+		if (group) {
+			group->playtime = g_ascii_strtoull(pair->value, NULL, 10);
+		} else {
+			answer->count.playtime = g_ascii_strtoull(pair->value, NULL, 10);
+		}
+	} else {
+		group = g_malloc(sizeof(struct mpd_count_group));
+		group->name = g_strdup(pair->value);
+		group->songs = 0;
+		group->playtime = 0;
+		answer->count.groups = g_list_prepend(answer->count.groups, group);
+	}
+
+	return TRUE;
+}
+
+void cmd_process_count(union mpd_cmd_answer *answer)
+{
+	answer->count.groups = g_list_reverse(answer->count.groups);
+}
+
+gboolean parse_binary_picture(union mpd_cmd_answer *answer, const void *data, gsize len)
+{
+	if (!answer->picture.data) {
+		answer->picture.data = g_byte_array_new();
+	}
+	g_byte_array_append(answer->picture.data, data, len);
+
+	return TRUE;
+}
+
+/**
+  @brief Receive binary data of the pending command that are already buffered.
+  @returns TRUE when all binary data were received, FALSE if more are to come.
+  */
+static gboolean mpd_recv_binary(struct mpd_source *source, struct mpd_cmd *cmd)
+{
+	guint8 buf[MPD_RECV_BINARY_BUF];
+	gsize len;
+
+	while (cmd->binary > 0) {
+		len = mpd_async_recv_raw(source->async, buf, MIN(sizeof(buf), cmd->binary));
+		if (len == 0) {
+			return FALSE;
+		}
+		cmd->binary -= len;
+		/* the newline terminating binary data is not a part of them */
+		if (cmd->binary == 0) {
+			len--;
+		}
+		if (len > 0 && cmd->parse_binary) {
+			cmd->parse_binary(&cmd->answer, buf, len);
+		}
+	}
+
+	return TRUE;
+}
+
 #define MPD_GREETING "OK MPD"
 
 gboolean mpd_recv(struct mpd_source *source)
@@ -414,6 +609,7 @@ gboolean mpd_recv(struct mpd_source *source)
 	struct mpd_pair pair;
 	gboolean end = FALSE;
 	gboolean success = FALSE;
+	gboolean failed = FALSE;
 	struct mpd_cmd_cb *cur;
 
 	cmd = g_queue_peek_head(&source->pending);
@@ -424,6 +620,10 @@ gboolean mpd_recv(struct mpd_source *source)
 	MSG_INFO("expecting answer for MPD command %s", mpd_cmd_to_str(cmd->type));
 
 	while (!end) {
+		if (cmd->binary > 0 && !mpd_recv_binary(source, cmd)) {
+			return FALSE;
+		}
+
 		line = mpd_async_recv_line(source->async);
 		if (!line) {
 			return FALSE;
@@ -448,11 +648,15 @@ gboolean mpd_recv(struct mpd_source *source)
 		case MPD_PARSER_ERROR:
 			MSG_ERROR("MPD error %d: %s", mpd_parser_get_server_error(source->parser), mpd_parser_get_message(source->parser));
 			end = TRUE;
+			failed = TRUE;
 			break;
 		case MPD_PARSER_PAIR:
 			pair.name = mpd_parser_get_name(source->parser);
 			pair.value = mpd_parser_get_value(source->parser);
-			if (cmd->parse_pair) {
+			if (!strcmp(pair.name, "binary")) {
+				/* raw bytes and a newline follow */
+				cmd->binary = g_ascii_strtoull(pair.value, NULL, 10) + 1;
+			} else if (cmd->parse_pair) {
 				cmd->parse_pair(&cmd->answer, &pair);
 			}
 			break;
@@ -466,6 +670,10 @@ gboolean mpd_recv(struct mpd_source *source)
 		for (cur = source->cbs[cmd->type]; cur; cur = cur->next) {
 			cur->cb(cmd->type, cmd->args, &cmd->answer, cur->data);
 		}
+	} else if (failed) {
+		for (cur = source->error_cbs; cur; cur = cur->next) {
+			cur->cb(cmd->type, cmd->args, NULL, cur->data);
+		}
 	}
 	mpd_cmd_free(cmd);
 	g_queue_pop_head(&source->pending);
@@ -489,14 +697,35 @@ gboolean mpd_cmd_send(GSource *source, struct mpd_cmd *cmd, ...)
 	return retval;
 }
 
-gboolean mpd_cmd_send_v(GSource *source, struct mpd_cmd *cmd, va_list args)
+/**
+  @brief Append an argument to a command line, quoted and escaped the way MPD
+  parses it.
+  */
+static void mpd_cmd_quote(GString *line, const char *arg)
+{
+	const char *c;
+
+	g_string_append(line, " \"");
+	for (c = arg; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			g_string_append_c(line, '\\');
+		}
+		g_string_append_c(line, *c);
+	}
+	g_string_append_c(line, '"');
+}
+
+/**
+  @brief Send a command with arguments collected in @a cmd->args and queue it
+  for its answer. Arguments are dropped when the command can't be sent.
+  */
+static gboolean mpd_cmd_send_args(struct mpd_source *mpdsource, struct mpd_cmd *cmd)
 {
-	struct mpd_source *mpdsource = (struct mpd_source *) source;
-	va_list args2;
 	struct mpd_cmd *pending;
-	gboolean retval;
-	const char *arg;
+	GString *line;
+	GList *cur;
 	const char *cmd_str;
+	gboolean retval;
 
 	cmd_str = mpd_cmd_to_str(cmd->type);
 
@@ -509,25 +738,46 @@ gboolean mpd_cmd_send_v(GSource *source, struct mpd_cmd *cmd, va_list args)
 
 	MSG_INFO("sending MPD command %s", cmd_str);
 
-	va_copy(args2, args);
-	retval = mpd_async_send_command_v(mpdsource->async, cmd_str, args);
+	/* the line is complete, libmpdclient only terminates it */
+	line = g_string_new(cmd_str);
+	for (cur = cmd->args; cur; cur = cur->next) {
+		mpd_cmd_quote(line, cur->data);
+	}
+	retval = mpd_async_send_command(mpdsource->async, line->str, NULL);
 	mpd_async_io(mpdsource->async, MPD_ASYNC_EVENT_WRITE);
+	g_string_free(line, TRUE);
 
 	if (!retval) {
-		va_end(args2);
+		g_list_free_full(cmd->args, g_free);
+		cmd->args = NULL;
 		return FALSE;
 	}
 
-	while ((arg = va_arg(args2, const char *)) != NULL) {
-		cmd->args = g_list_prepend(cmd->args, g_strdup(arg));
+	if (cmd->type == MPD_CMD_LIST && cmd->args) {
+		/* tells group values from listed values in the answer */
+		cmd->answer.list.tag = cmd->args->data;
 	}
-	cmd->args = g_list_reverse(cmd->args);
+	if (++mpdsource->serial == 0) {
+		mpdsource->serial++;
+	}
+	cmd->serial = mpdsource->serial;
 	g_queue_push_tail(&mpdsource->pending, cmd);
-	va_end(args2);
 
 	return TRUE;
 }
 
+gboolean mpd_cmd_send_v(GSource *source, struct mpd_cmd *cmd, va_list args)
+{
+	const char *arg;
+
+	while ((arg = va_arg(args, const char *)) != NULL) {
+		cmd->args = g_list_prepend(cmd->args, g_strdup(arg));
+	}
+	cmd->args = g_list_reverse(cmd->args);
+
+	return mpd_cmd_send_args((struct mpd_source *) source, cmd);
+}
+
 gboolean mpd_send(GSource *source, enum mpd_cmd_type type, ...)
 {
 	va_list args;
@@ -554,6 +804,32 @@ gboolean mpd_send(GSource *source, enum mpd_cmd_type type, ...)
 	return retval;
 }
 
+gboolean mpd_send_argv(GSource *source, enum mpd_cmd_type type, const char *const *argv)
+{
+	const char *cmd_str;
+	struct mpd_cmd *cmd;
+	guint i;
+
+	if (!source) {
+		MSG_ERROR("mpd_send_argv(): invalid source");
+		return FALSE;
+	}
+
+	cmd_str = mpd_cmd_to_str(type);
+	if (!cmd_str) {
+		MSG_WARNING("invalid command");
+		return FALSE;
+	}
+
+	cmd = mpd_cmd_new(type);
+	for (i = 0; argv[i]; i++) {
+		cmd->args = g_list_prepend(cmd->args, g_strdup(argv[i]));
+	}
+	cmd->args = g_list_reverse(cmd->args);
+
+	return mpd_cmd_send_args((struct mpd_source *) source, cmd);
+}
+
 int client_connect(const char *host, int port)
 {
 	struct addrinfo hints;
@@ -610,6 +886,8 @@ GSource *mpd_source_new(int fd)
 	for (i = 0; i < MPD_CMD_COUNT; i++) {
 		mpdsource->cbs[i] = NULL;
 	}
+	mpdsource->error_cbs = NULL;
+	mpdsource->serial = 0;
 
 	return source;
 }
@@ -627,6 +905,10 @@ void mpd_source_close(GSource *source)
 			g_free(cur);
 		}
 	}
+	for (cur = mpdsource->error_cbs; cur; cur = next) {
+		next = cur->next;
+		g_free(cur);
+	}
 
 	close(mpd_async_get_fd(mpdsource->async));
 	mpd_async_free(mpdsource->async);
@@ -649,6 +931,47 @@ void mpd_source_register(GSource *source, enum mpd_cmd_type cmd, CMDCallback cb,
 	mpdsource->cbs[cmd] = mpd_cmd_cb_append(mpdsource->cbs[cmd], cb, data);
 }
 
+void mpd_source_register_error(GSource *source, CMDCallback cb, void *data)
+{
+	struct mpd_source *mpdsource = (struct mpd_source *) source;
+
+	mpdsource->error_cbs = mpd_cmd_cb_append(mpdsource->error_cbs, cb, data);
+}
+
+gboolean mpd_source_is_idle(GSource *source)
+{
+	struct mpd_source *mpdsource = (struct mpd_source *) source;
+	struct mpd_cmd *pending;
+
+	switch (g_queue_get_length(&mpdsource->pending)) {
+	case 0:
+		return TRUE;
+	case 1:
+		pending = g_queue_peek_head(&mpdsource->pending);
+		return pending->type == MPD_CMD_IDLE;
+	default:
+		return FALSE;
+	}
+}
+
+guint mpd_source_last_sent(GSource *source)
+{
+	struct mpd_source *mpdsource = (struct mpd_source *) source;
+
+	return mpdsource->serial;
+}
+
+guint mpd_source_answered(GSource *source)
+{
+	struct mpd_source *mpdsource = (struct mpd_source *) source;
+	struct mpd_cmd *cmd;
+
+	/* the answered command leaves the queue after its callbacks */
+	cmd = g_queue_peek_head(&mpdsource->pending);
+
+	return cmd ? cmd->serial : 0;
+}
+
 struct mpd_cmd_cb *mpd_cmd_cb_append(struct mpd_cmd_cb *list, CMDCallback cb, void *data)
 {
 	struct mpd_cmd_cb *new;
@@ -42,6 +42,16 @@ enum mpd_cmd_type {
 	MPD_CMD_SINGLE,
 	MPD_CMD_CONSUME,
 	MPD_CMD_SHUFFLE,
+	MPD_CMD_PLCHANGES,
+	MPD_CMD_LSINFO_RAW,
+	MPD_CMD_ALBUMART,
+	MPD_CMD_READPICTURE,
+	MPD_CMD_BINARYLIMIT,
+	MPD_CMD_SEARCH,
+	MPD_CMD_COUNTSONGS,
+	MPD_CMD_TAGTYPES,
+	MPD_CMD_PLAYID,
+	MPD_CMD_PLID,
 	MPD_CMD_COUNT
 };
 
@@ -53,19 +63,41 @@ union mpd_cmd_answer {
 	struct {
 		struct mpd_song *song;
 		GList *list;
-	} plinfo; /* MPD_CMD_PLINFO */
+	} plinfo; /* MPD_CMD_PLINFO, MPD_CMD_PLCHANGES, MPD_CMD_PLID */
 	struct {
 		struct mpd_entity *entity;
 		GList *list;
-	} lsinfo; /* MPD_CMD_LSINFO */
+	} lsinfo; /* MPD_CMD_LSINFO, MPD_CMD_FIND, MPD_CMD_SEARCH */
 	struct {
 		struct mpd_tag_entity *entity;
 		GList *list;
+		const gchar *tag; /* listed tag, other tags are group values */
+		gboolean complete; /* TRUE if entity has the listed tag */
 	} list; /* MPD_CMD_LIST */
+	GPtrArray *pairs; /* MPD_CMD_LSINFO_RAW: names and values of received
+			     pairs in turn */
+	struct {
+		gsize size; /* size of the whole picture */
+		GByteArray *data; /* received chunk */
+	} picture; /* MPD_CMD_ALBUMART, MPD_CMD_READPICTURE */
+	struct {
+		guint songs;
+		guint playtime;
+		GList *groups; /* struct mpd_count_group when counted with group */
+	} count; /* MPD_CMD_COUNTSONGS */
 	int idle; /* MPD_CMD_IDLE */
 	gboolean ok;
 };
 
+/**
+  Songs with one value of the tag counted by.
+  */
+struct mpd_count_group {
+	gchar *name; /** Tag value */
+	guint songs;
+	guint playtime; /** Seconds */
+};
+
 typedef void (*CMDCallback)(enum mpd_cmd_type, GList *, union mpd_cmd_answer *, void *);
 
 struct mpd_cmd_cb {
@@ -84,6 +116,8 @@ struct mpd_source {
 	struct mpd_parser *parser;
 	GQueue pending;
 	struct mpd_cmd_cb *cbs[MPD_CMD_COUNT];
+	struct mpd_cmd_cb *error_cbs; /** Callbacks for commands that failed */
+	guint serial; /** Serial number of the last sent command */
 };
 
 /**
@@ -97,19 +131,29 @@ struct mpd_cmd {
 			const struct mpd_pair *pair); /** Function to parse single pair. Called each time a pair is received */
 	void (*process)(union mpd_cmd_answer *answer); /** Function to process received answer. Called after whole answer is received */
 	void (*free_answer)(union mpd_cmd_answer *answer);
+	gboolean (*parse_binary)(union mpd_cmd_answer *answer, const void *data,
+			gsize len); /** Function to parse binary data announced by
+				      a 'binary' pair. Called for every received
+				      piece */
+	gsize binary; /** Bytes of binary data (and the newline following it)
+			still to be received */
+	guint serial; /** Serial number of the command on its connection, never
+			0 for sent commands */
 };
 
+#define MPD_RECV_BINARY_BUF 8192 /** Size of buffer for receiving binary data */
+
 #define MPD_CHANGED_DB		0x001
 #define MPD_CHANGED_UPDATE	0x002
 #define MPD_CHANGED_STORED_PL	0x004
 #define MPD_CHANGED_PL		0x008
-#define MPD_CHANGED_PLAYER	0x00f
-#define MPD_CHANGED_MIXER	0x010
-#define MPD_CHANGED_OUTPUT	0x020
-#define MPD_CHANGED_OPTIONS	0x040
-#define MPD_CHANGED_STICKER	0x080
-#define MPD_CHANGED_SUBSCR	0x0f0
-#define MPD_CHANGED_MESSAGE	0x100
+#define MPD_CHANGED_PLAYER	0x010
+#define MPD_CHANGED_MIXER	0x020
+#define MPD_CHANGED_OUTPUT	0x040
+#define MPD_CHANGED_OPTIONS	0x080
+#define MPD_CHANGED_STICKER	0x100
+#define MPD_CHANGED_SUBSCR	0x200
+#define MPD_CHANGED_MESSAGE	0x400
 
 const char *mpd_cmd_to_str(enum mpd_cmd_type cmd);
 /**
@@ -134,16 +178,22 @@ void mpd_cmd_free(struct mpd_cmd *cmd);
 void mpd_cmd_process_answer(struct mpd_cmd *cmd);
 
 gboolean parse_pair_status(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
+gboolean parse_pair_stats(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
 gboolean parse_pair_song(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
 gboolean parse_pair_plsong(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
 gboolean parse_pair_lsinfo(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
 gboolean parse_pair_list(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
 gboolean parse_pair_idle(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
+gboolean parse_pair_raw(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
+gboolean parse_pair_picture(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
+gboolean parse_pair_count(union mpd_cmd_answer *answer, const struct mpd_pair *pair);
+gboolean parse_binary_picture(union mpd_cmd_answer *answer, const void *data, gsize len);
 
 void cmd_process_idle(union mpd_cmd_answer *answer);
 void cmd_process_plinfo(union mpd_cmd_answer *answer);
 void cmd_process_lsinfo(union mpd_cmd_answer *answer);
 void cmd_process_list(union mpd_cmd_answer *answer);
+void cmd_process_count(union mpd_cmd_answer *answer);
 
 /**
   @brief Function to create TCP connection to the server.
@@ -222,6 +272,15 @@ gboolean mpd_cmd_send_v(GSource *source, struct mpd_cmd *cmd, va_list args);
   */
 gboolean mpd_send(GSource *source, enum mpd_cmd_type type, ...);
 
+/**
+  Create and send MPD command with arguments collected in an array.
+  @param source MPD source connected to a MPD server.
+  @param type Command type.
+  @param argv NULL terminated array of arguments.
+  @returns TRUE when command was sent, FALSE otherwise.
+  */
+gboolean mpd_send_argv(GSource *source, enum mpd_cmd_type type, const char *const *argv);
+
 /**
   @brief Register a callback that will be called when an answer to a comand is
   received in addition to the command's own process function.
@@ -231,6 +290,38 @@ gboolean mpd_send(GSource *source, enum mpd_cmd_type type, ...);
   */
 void mpd_source_register(GSource *source, enum mpd_cmd_type cmd, CMDCallback cb, void *data);
 
+/**
+  @brief Register a callback that will be called when the server reports an
+  error for a command of any type. The answer passed to the callback is NULL.
+  @param source MPD source
+  @param cb Callback function
+  */
+void mpd_source_register_error(GSource *source, CMDCallback cb, void *data);
+
+/**
+  @brief Check whether the server is idling, i.e. no command other than idle
+  is waiting for an answer.
+  @param source MPD source
+  @returns TRUE if a command sent now would be answered right away.
+  */
+gboolean mpd_source_is_idle(GSource *source);
+
+/**
+  @brief Get serial number of the last sent command, e.g. to recognize its
+  answer with @a mpd_source_answered().
+  @param source MPD source
+  @returns Serial number or 0 if no command was sent yet.
+  */
+guint mpd_source_last_sent(GSource *source);
+
+/**
+  @brief Get serial number of the oldest command waiting for its answer. In
+  command callbacks it's the command being answered.
+  @param source MPD source
+  @returns Serial number or 0 if no command is waiting.
+  */
+guint mpd_source_answered(GSource *source);
+
 struct mpd_cmd_cb *mpd_cmd_cb_append(struct mpd_cmd_cb *list, CMDCallback cb, void *data);
 
 const char *mpd_bool_str(bool value);
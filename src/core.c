@@ -20,28 +20,71 @@ struct sonatina_instance sonatina;
 void sonatina_init()
 {
 	struct sonatina_tab *tab;
+	gchar *format;
 
 	MSG_DEBUG("sonatina_init()");
 
 	sonatina.mpdsource = NULL;
+	sonatina.profile = NULL;
 	sonatina_settings_load(&sonatina);
 
+	format = sonatina_settings_get_string("main", "title");
+	sonatina.title = song_format_compile(format);
+	g_free(format);
+	format = sonatina_settings_get_string("main", "subtitle");
+	sonatina.subtitle = song_format_compile(format);
+	g_free(format);
+	sonatina.fmtbuf = g_string_new(NULL);
+
+	sonatina.art = art_cache_new();
+	sonatina.art_key = NULL;
+	sonatina.tags = 0;
+	/* until the window is mapped */
+	sonatina.hidden = TRUE;
+	sonatina.volume = -1;
+	sonatina.state = MPD_STATE_UNKNOWN;
+	sonatina.repeat = FALSE;
+	sonatina.random = FALSE;
+	sonatina.single = FALSE;
+	sonatina.consume = FALSE;
+	sonatina.status_pending = FALSE;
+	sonatina.song = NULL;
+	sonatina.song_pending = FALSE;
+	sonatina.next = NULL;
+	sonatina.next_title = NULL;
+	sonatina.next_subtitle = NULL;
+	sonatina.next_id = -1;
+	sonatina.next_source = 0;
+	sonatina.song_id = -1;
+	sonatina.duration_id = -1;
+	sonatina.duration_ms = 0;
+	sonatina.volume_ctl.cmd = MPD_CMD_SETVOL;
+	sonatina.volume_ctl.busy = FALSE;
+	sonatina.volume_ctl.pending = FALSE;
+	sonatina.seek_ctl.cmd = MPD_CMD_SEEKCUR;
+	sonatina.seek_ctl.busy = FALSE;
+	sonatina.seek_ctl.pending = FALSE;
+
 	sonatina_profiles_load();
 
 	sonatina.elapsed_ms = 0;
 	sonatina.total = 0;
 	sonatina.counter = g_timer_new();
 	g_timer_stop(sonatina.counter);
-	g_timeout_add(200, counter_cb, NULL);
+	sonatina.counter_source = 0;
+	sonatina.shown_sec = -1;
+	sonatina.shown_total = -1;
 
 	sonatina.cur = -1;
 
 	sonatina.tabs = NULL;
+	g_signal_connect_after(gtk_builder_get_object(sonatina.gui, "notebook"), "switch-page",
+			G_CALLBACK(sonatina_page_switched_cb), NULL);
 
-	tab = sonatina_tab_new("playlist", _("Playlist"), sizeof(struct pl_tab), pl_tab_init, pl_tab_set_source, pl_tab_destroy);
+	tab = sonatina_tab_new("playlist", _("Playlist"), sizeof(struct pl_tab), pl_tab_init, pl_tab_set_source, pl_tab_destroy, pl_tab_refresh);
 	sonatina_append_tab(tab);
 
-	tab = sonatina_tab_new("library", _("Library"), sizeof(struct library_tab), library_tab_init, library_tab_set_source, library_tab_destroy);
+	tab = sonatina_tab_new("library", _("Library"), sizeof(struct library_tab), library_tab_init, library_tab_set_source, library_tab_destroy, library_tab_refresh);
 	sonatina_append_tab(tab);
 }
 
@@ -51,6 +94,39 @@ void sonatina_destroy()
 
 	sonatina_settings_save();
 	sonatina_profiles_save();
+
+	song_format_free(sonatina.title);
+	song_format_free(sonatina.subtitle);
+	g_string_free(sonatina.fmtbuf, TRUE);
+	art_cache_free(sonatina.art);
+	g_free(sonatina.art_key);
+	if (sonatina.song) {
+		mpd_song_free(sonatina.song);
+	}
+	if (sonatina.counter_source) {
+		g_source_remove(sonatina.counter_source);
+		sonatina.counter_source = 0;
+	}
+}
+
+/**
+  @brief Drop the prepared next song and its timeout.
+  */
+static void sonatina_forget_next(void)
+{
+	if (sonatina.next_source) {
+		g_source_remove(sonatina.next_source);
+		sonatina.next_source = 0;
+	}
+	if (sonatina.next) {
+		mpd_song_free(sonatina.next);
+		sonatina.next = NULL;
+	}
+	g_free(sonatina.next_title);
+	sonatina.next_title = NULL;
+	g_free(sonatina.next_subtitle);
+	sonatina.next_subtitle = NULL;
+	sonatina.next_id = -1;
 }
 
 gboolean sonatina_connect(const char *host, int port)
@@ -70,16 +146,30 @@ gboolean sonatina_connect(const char *host, int port)
 	sonatina.mpdsource = mpd_source_new(mpdfd);
 	g_source_attach(sonatina.mpdsource, context);
 
+	/* before any songs are requested */
+	sonatina_update_tagtypes(TRUE);
+
 	for (cur = sonatina.tabs; cur; cur = cur->next) {
 		tab = cur->data;
+		/* tabs load everything again on a new connection */
+		tab->stale = FALSE;
 		tab->set_mpdsource(tab, sonatina.mpdsource);
 	}
 
+	art_cache_set_source(sonatina.art, sonatina.mpdsource, sonatina.profile);
+
 	mpd_source_register(sonatina.mpdsource, MPD_CMD_STATUS, sonatina_update_status, NULL);
 	mpd_source_register(sonatina.mpdsource, MPD_CMD_CURRENTSONG, sonatina_update_song, NULL);
-
+	mpd_source_register(sonatina.mpdsource, MPD_CMD_PLID, sonatina_next_song_cb, NULL);
+	sonatina.volume_ctl.busy = sonatina.volume_ctl.pending = FALSE;
+	sonatina.seek_ctl.busy = sonatina.seek_ctl.pending = FALSE;
+	mpd_source_register(sonatina.mpdsource, MPD_CMD_SETVOL, sonatina_control_cb, &sonatina.volume_ctl);
+	mpd_source_register_error(sonatina.mpdsource, sonatina_control_cb, &sonatina.volume_ctl);
+	mpd_source_register(sonatina.mpdsource, MPD_CMD_SEEKCUR, sonatina_control_cb, &sonatina.seek_ctl);
+	mpd_source_register_error(sonatina.mpdsource, sonatina_control_cb, &sonatina.seek_ctl);
+
+	/* playlist tab decides how to sync the queue from the status answer */
 	mpd_send(sonatina.mpdsource, MPD_CMD_STATUS, NULL);
-	mpd_send(sonatina.mpdsource, MPD_CMD_PLINFO, NULL);
 	mpd_send(sonatina.mpdsource, MPD_CMD_CURRENTSONG, NULL);
 
 	return TRUE;
@@ -102,14 +192,26 @@ void sonatina_disconnect()
 		return;
 	}
 
+	art_cache_set_source(sonatina.art, NULL, NULL);
 	mpd_send(sonatina.mpdsource, MPD_CMD_CLOSE, NULL);
 	mpd_source_close(sonatina.mpdsource);
 
 	sonatina.mpdsource = NULL;
+	g_free(sonatina.profile);
+	sonatina.profile = NULL;
 	sonatina.cur = -1;
 	g_timer_stop(sonatina.counter);
+	sonatina_update_counter();
 
+	sonatina.status_pending = FALSE;
+	sonatina.song_pending = FALSE;
+	if (sonatina.song) {
+		mpd_song_free(sonatina.song);
+		sonatina.song = NULL;
+	}
+	sonatina_forget_next();
 	sonatina_set_labels(_("Sonatina"), _("Disconnected"));
+	sonatina_show_art(NULL);
 	remove_connected_entries();
 }
 
@@ -126,9 +228,13 @@ gboolean sonatina_change_profile(const struct sonatina_profile *profile)
 	}
 
 	MSG_INFO("changing profile to %s", profile->name);
+	sonatina.profile = g_strdup(profile->name);
 	if (sonatina_connect(profile->host, profile->port)) {
 		val.string = profile->name;
 		sonatina_settings_set("main", "active_profile", val);
+	} else {
+		g_free(sonatina.profile);
+		sonatina.profile = NULL;
 	}
 
 	add_connected_entries();
@@ -154,96 +260,304 @@ gboolean sonatina_change_profile_by_name(const char *new)
 	return sonatina_change_profile(profile);
 }
 
-void sonatina_update_song(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+void sonatina_title_format_changed(union settings_value value, void *data)
 {
-	const struct mpd_song *song = answer->song;
-	gchar *format;
-	gchar *str;
-	int pos;
+	const struct settings_entry *entry = (const struct settings_entry *) data;
 
-	if (song) {
-		format = sonatina_settings_get_string("main", "title");
-		str = song_attr_format(format, song);
-		if (str) {
-			sonatina_set_labels(str, NULL);
+	if (!g_strcmp0(entry->name, "title")) {
+		song_format_free(sonatina.title);
+		sonatina.title = song_format_compile(value.string);
+	} else {
+		song_format_free(sonatina.subtitle);
+		sonatina.subtitle = song_format_compile(value.string);
+	}
+
+	sonatina_update_tagtypes(FALSE);
+	/* prepared with the old format, requested again with the next status */
+	sonatina_forget_next();
+	if (sonatina.mpdsource) {
+		mpd_send(sonatina.mpdsource, MPD_CMD_CURRENTSONG, NULL);
+	}
+}
+
+void sonatina_update_tagtypes(gboolean force)
+{
+	struct pl_tab *pl;
+	struct library_tab *lib;
+	const char *argv[MPD_TAG_COUNT + 2];
+	guint64 tags;
+	size_t i, n;
+
+	if (!sonatina.mpdsource) {
+		return;
+	}
+
+	tags = SONATINA_REQUIRED_TAGS | sonatina.title->tags | sonatina.subtitle->tags;
+
+	pl = (struct pl_tab *) sonatina_get_tab("playlist");
+	if (pl) {
+		for (i = 0; i < pl->n_columns; i++) {
+			tags |= pl->formats[i]->tags;
 		}
-		g_free(format);
-		g_free(str);
+	}
+	lib = (struct library_tab *) sonatina_get_tab("library");
+	if (lib) {
+		tags |= lib->format->tags;
+	}
 
-		format = sonatina_settings_get_string("main", "subtitle");
-		str = song_attr_format(format, song);
-		if (str) {
-			sonatina_set_labels(NULL, str);
+	if (!force && tags == sonatina.tags) {
+		return;
+	}
+	sonatina.tags = tags;
+
+	/* commands are executed in order, later answers carry only these */
+	mpd_send(sonatina.mpdsource, MPD_CMD_TAGTYPES, "clear", NULL);
+	n = 0;
+	argv[n++] = "enable";
+	for (i = 0; i < MPD_TAG_COUNT; i++) {
+		if (tags & (guint64) 1 << i) {
+			argv[n++] = mpd_tag_name(i);
 		}
-		 
-		g_free(format);
-		g_free(str);
+	}
+	argv[n] = NULL;
+	/* one command for all tags */
+	mpd_send_argv(sonatina.mpdsource, MPD_CMD_TAGTYPES, argv);
+}
 
-		pos = mpd_song_get_pos(song);
-		sonatina.cur = pos;
+/**
+  @brief Show a song in the header.
+  @param song Current song or NULL if stopped.
+  */
+static void sonatina_show_song(const struct mpd_song *song)
+{
+	if (song) {
+		sonatina_set_labels(song_format_run(sonatina.title, song, sonatina.fmtbuf), NULL);
+		sonatina_set_labels(NULL, song_format_run(sonatina.subtitle, song, sonatina.fmtbuf));
 	} else {
 		sonatina_set_labels(_("Sonatina"), _("Stopped"));
 	}
+
+	sonatina_show_art(song);
 }
 
-void sonatina_update_status(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+/**
+  @brief Get elapsed time of the current song.
+  */
+static int sonatina_elapsed_ms(void)
 {
-	const struct mpd_status *status = answer->status;
-	GObject *w;
-	int vol;
-	enum mpd_state state;
-	const char *mpd_err;
-	GApplication *app;
-	GAction *action;
+	return sonatina.elapsed_ms + g_timer_elapsed(sonatina.counter, NULL)*1000.0;
+}
 
-	if (!status) {
+/**
+  @brief Timeout callback showing the next song when the current one ends,
+  before the server reports it.
+  */
+static gboolean sonatina_next_cb(gpointer data)
+{
+	sonatina.next_source = 0;
+
+	if (!sonatina.next || sonatina.hidden) {
+		return FALSE;
+	}
+
+	MSG_DEBUG("current song ended, showing song %d", sonatina.next_id);
+	sonatina_set_labels(sonatina.next_title, sonatina.next_subtitle);
+	sonatina_show_art(sonatina.next);
+	sonatina.cur = mpd_song_get_pos(sonatina.next);
+	sonatina.elapsed_ms = 0;
+	sonatina.total = mpd_song_get_duration(sonatina.next);
+	sonatina.song_id = sonatina.duration_id = mpd_song_get_id(sonatina.next);
+	sonatina.duration_ms = mpd_song_get_duration_ms(sonatina.next);
+	g_timer_start(sonatina.counter);
+	sonatina_update_counter();
+
+	/* the status of the new song prepares the one after it */
+	sonatina_forget_next();
+
+	return FALSE;
+}
+
+/**
+  @brief Schedule showing the next song when the current one ends. Its
+  duration in whole seconds from the status could be almost a second off, so
+  nothing is scheduled until the current song with its exact duration is
+  received.
+  */
+static void sonatina_schedule_next(void)
+{
+	int remaining_ms;
+
+	if (sonatina.next_source) {
+		g_source_remove(sonatina.next_source);
+		sonatina.next_source = 0;
+	}
+
+	if (sonatina.state != MPD_STATE_PLAY || sonatina.next_id < 0 ||
+	    sonatina.duration_id != sonatina.song_id || sonatina.duration_ms <= 0) {
 		return;
 	}
 
-	sonatina.cur = mpd_status_get_song_pos(status);
+	remaining_ms = sonatina.duration_ms - sonatina_elapsed_ms();
+	if (remaining_ms > 0) {
+		sonatina.next_source = g_timeout_add(remaining_ms, sonatina_next_cb, NULL);
+	}
+}
+
+/**
+  @brief Schedule showing the next song from a status. The next song is
+  requested when it changed.
+  */
+static void sonatina_predict_next(const struct mpd_status *status)
+{
+	char buf[INT_BUF_SIZE];
+	gint id;
+
+	id = mpd_status_get_next_song_id(status);
+	if (sonatina.state != MPD_STATE_PLAY || sonatina.single || id < 0) {
+		/* playback stops or repeats the song, nothing to predict */
+		sonatina_forget_next();
+		return;
+	}
+
+	if (id != sonatina.next_id) {
+		sonatina_forget_next();
+		sonatina.next_id = id;
+		snprintf(buf, sizeof(buf), "%d", id);
+		mpd_send(sonatina.mpdsource, MPD_CMD_PLID, buf, NULL);
+	}
+
+	sonatina_schedule_next();
+}
+
+void sonatina_update_song(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	const struct mpd_song *song = answer->song;
+
+	if (song) {
+		sonatina.cur = mpd_song_get_pos(song);
+		sonatina.duration_id = mpd_song_get_id(song);
+		sonatina.duration_ms = mpd_song_get_duration_ms(song);
+	} else {
+		sonatina.duration_id = -1;
+		sonatina.duration_ms = 0;
+	}
+	sonatina_schedule_next();
+
+	if (sonatina.hidden) {
+		/* only the last song is shown when the window is */
+		if (sonatina.song) {
+			mpd_song_free(sonatina.song);
+		}
+		sonatina.song = song ? mpd_song_dup(song) : NULL;
+		sonatina.song_pending = TRUE;
+		return;
+	}
+
+	sonatina_show_song(song);
+}
+
+void sonatina_next_song_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	const struct mpd_song *song;
+
+	if (!answer->plinfo.list) {
+		return;
+	}
+
+	song = (const struct mpd_song *) answer->plinfo.list->data;
+	if ((gint) mpd_song_get_id(song) != sonatina.next_id) {
+		/* the next song changed meanwhile */
+		return;
+	}
+
+	if (sonatina.next) {
+		mpd_song_free(sonatina.next);
+		g_free(sonatina.next_title);
+		g_free(sonatina.next_subtitle);
+	}
+	sonatina.next = mpd_song_dup(song);
+	sonatina.next_title = g_strdup(song_format_run(sonatina.title, song, sonatina.fmtbuf));
+	sonatina.next_subtitle = g_strdup(song_format_run(sonatina.subtitle, song, sonatina.fmtbuf));
+}
+
+static void sonatina_art_cb(const gchar *key, GdkPixbuf *pixbuf, gpointer data)
+{
+	/* the song may have changed meanwhile */
+	if (!g_strcmp0(key, sonatina.art_key)) {
+		sonatina_set_art(pixbuf);
+	}
+}
+
+void sonatina_show_art(const struct mpd_song *song)
+{
+	GdkPixbuf *pixbuf;
+	gchar *key;
+
+	if (!song) {
+		g_free(sonatina.art_key);
+		sonatina.art_key = NULL;
+		sonatina_set_art(NULL);
+		return;
+	}
+
+	key = art_song_key(song);
+	if (!g_strcmp0(key, sonatina.art_key)) {
+		g_free(key);
+		return;
+	}
+	g_free(sonatina.art_key);
+	sonatina.art_key = key;
+
+	if (art_cache_lookup(sonatina.art, key, mpd_song_get_uri(song), &pixbuf)) {
+		sonatina_set_art(pixbuf);
+	} else {
+		sonatina_set_art(NULL);
+		art_cache_request(sonatina.art, key, mpd_song_get_uri(song), sonatina_art_cb, NULL);
+	}
+}
+
+/**
+  @brief Show the last status in the header and in option actions.
+  */
+static void sonatina_show_status(void)
+{
+	GObject *w;
+	GObject *play;
+	GObject *pause;
+	GApplication *app;
+	GAction *action;
 
 	/* volume */
-	vol = mpd_status_get_volume(status);
 	w = gtk_builder_get_object(sonatina.gui, "volbutton");
-	if (vol >= 0) {
+	if (sonatina.volume >= 0) {
 		gtk_widget_set_sensitive(GTK_WIDGET(w), TRUE);
-		gtk_scale_button_set_value(GTK_SCALE_BUTTON(w), vol/100.0);
+		/* don't pull the button back while the user moves it */
+		if (!sonatina.volume_ctl.busy) {
+			/* showing the volume of the server doesn't set it */
+			g_signal_handlers_block_by_func(w, volume_cb, NULL);
+			gtk_scale_button_set_value(GTK_SCALE_BUTTON(w), sonatina.volume/100.0);
+			g_signal_handlers_unblock_by_func(w, volume_cb, NULL);
+		}
 	} else {
 		gtk_widget_set_sensitive(GTK_WIDGET(w), FALSE);
 	}
 
-	/* elapsed time */
-	sonatina.elapsed_ms = mpd_status_get_elapsed_ms(status);
-	sonatina.total = mpd_status_get_total_time(status);
-	g_timer_start(sonatina.counter);
-	g_timer_stop(sonatina.counter);
-
 	/* state */
-	GObject *play;
-	GObject *pause;
-	state = mpd_status_get_state(status);
 	play = gtk_builder_get_object(sonatina.gui, "play_button");
 	pause = gtk_builder_get_object(sonatina.gui, "pause_button");
-	switch (state) {
+	switch (sonatina.state) {
 	case MPD_STATE_UNKNOWN:
 	case MPD_STATE_STOP:
 	case MPD_STATE_PAUSE:
 		gtk_widget_hide(GTK_WIDGET(pause));
 		gtk_widget_show(GTK_WIDGET(play));
-		g_timer_stop(sonatina.counter);
 		break;
 	case MPD_STATE_PLAY:
 		gtk_widget_hide(GTK_WIDGET(play));
 		gtk_widget_show(GTK_WIDGET(pause));
-		g_timer_start(sonatina.counter);
 		break;
 	}
 
-	mpd_err = mpd_status_get_error(status);
-	if (mpd_err) {
-		MSG_ERROR("MPD: %s", mpd_err);
-	}
-
 	app = g_application_get_default();
 
 	if (!app) {
@@ -252,33 +566,86 @@ void sonatina_update_status(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_an
 
 	action = g_action_map_lookup_action(G_ACTION_MAP(app), "repeat");
 	if (action) {
-		g_action_change_state(action, g_variant_new("b", mpd_status_get_repeat(status)));
+		g_action_change_state(action, g_variant_new("b", sonatina.repeat));
 	}
 
 	action = g_action_map_lookup_action(G_ACTION_MAP(app), "random");
 	if (action) {
-		g_action_change_state(action, g_variant_new("b", mpd_status_get_random(status)));
+		g_action_change_state(action, g_variant_new("b", sonatina.random));
 	}
 
 	action = g_action_map_lookup_action(G_ACTION_MAP(app), "single");
 	if (action) {
-		g_action_change_state(action, g_variant_new("b", mpd_status_get_single(status)));
+		g_action_change_state(action, g_variant_new("b", sonatina.single));
 	}
 
 	action = g_action_map_lookup_action(G_ACTION_MAP(app), "consume");
 	if (action) {
-		g_action_change_state(action, g_variant_new("b", mpd_status_get_consume(status)));
+		g_action_change_state(action, g_variant_new("b", sonatina.consume));
 	}
 }
 
-gboolean counter_cb(gpointer data)
+void sonatina_update_status(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	const struct mpd_status *status = answer->status;
+	const char *mpd_err;
+
+	if (!status) {
+		return;
+	}
+
+	sonatina.cur = mpd_status_get_song_pos(status);
+	sonatina.song_id = mpd_status_get_song_id(status);
+	sonatina.volume = mpd_status_get_volume(status);
+	sonatina.repeat = mpd_status_get_repeat(status);
+	sonatina.random = mpd_status_get_random(status);
+	sonatina.single = mpd_status_get_single(status);
+	sonatina.consume = mpd_status_get_consume(status);
+
+	/* elapsed time */
+	sonatina.elapsed_ms = mpd_status_get_elapsed_ms(status);
+	sonatina.total = mpd_status_get_total_time(status);
+	g_timer_start(sonatina.counter);
+	g_timer_stop(sonatina.counter);
+
+	/* state */
+	sonatina.state = mpd_status_get_state(status);
+	if (sonatina.state == MPD_STATE_PLAY) {
+		g_timer_start(sonatina.counter);
+	}
+
+	mpd_err = mpd_status_get_error(status);
+	if (mpd_err) {
+		MSG_ERROR("MPD: %s", mpd_err);
+	}
+
+	sonatina_update_counter();
+	sonatina_predict_next(status);
+
+	if (sonatina.hidden) {
+		sonatina.status_pending = TRUE;
+		return;
+	}
+
+	sonatina_show_status();
+}
+
+/**
+  @brief Update the timeline if the shown second or total time changed.
+  */
+static void sonatina_draw_counter(int elapsed_ms)
 {
 	GObject *w;
 	gchar *str;
 	gdouble fraction;
-	int elapsed_ms;
+	int sec;
 
-	elapsed_ms = sonatina.elapsed_ms + g_timer_elapsed(sonatina.counter, NULL)*1000.0;
+	sec = MAX(elapsed_ms, 0) / 1000;
+	if (sec == sonatina.shown_sec && sonatina.total == sonatina.shown_total) {
+		return;
+	}
+	sonatina.shown_sec = sec;
+	sonatina.shown_total = sonatina.total;
 
 	if (sonatina.total <= 0 || elapsed_ms < 0) {
 		fraction = 0.0;
@@ -286,12 +653,41 @@ gboolean counter_cb(gpointer data)
 		fraction = elapsed_ms / (((double) sonatina.total) * 1000.0);
 	}
 	w = gtk_builder_get_object(sonatina.gui, "timeline");
-	str = g_strdup_printf("%d:%.2d / %d:%.2d", (elapsed_ms/1000)/60, (elapsed_ms/1000)%60, sonatina.total/60, sonatina.total%60);
+	str = g_strdup_printf("%d:%.2d / %d:%.2d", sec/60, sec%60, sonatina.total/60, sonatina.total%60);
 	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(w), fraction);
 	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(w), str);
 	g_free(str);
+}
 
-	return TRUE;
+gboolean counter_cb(gpointer data)
+{
+	sonatina.counter_source = 0;
+	sonatina_update_counter();
+
+	return FALSE;
+}
+
+void sonatina_update_counter(void)
+{
+	int elapsed_ms;
+
+	if (sonatina.counter_source) {
+		g_source_remove(sonatina.counter_source);
+		sonatina.counter_source = 0;
+	}
+
+	if (sonatina.hidden) {
+		/* the time is computed from the timer when the window is shown */
+		return;
+	}
+
+	elapsed_ms = sonatina_elapsed_ms();
+	sonatina_draw_counter(elapsed_ms);
+
+	if (sonatina.state == MPD_STATE_PLAY && sonatina.mpdsource) {
+		/* nothing changes on screen before the next second */
+		sonatina.counter_source = g_timeout_add(1000 - MAX(elapsed_ms, 0) % 1000, counter_cb, NULL);
+	}
 }
 
 void sonatina_play(int pos)
@@ -306,24 +702,51 @@ void sonatina_play(int pos)
 	}
 }
 
-void sonatina_seek(int time)
+/**
+  @brief Send a value of a control now or after the command in flight is
+  answered.
+  */
+static void sonatina_control_set(struct sonatina_control *ctl, int value)
 {
 	char buf[INT_BUF_SIZE];
 
-	snprintf(buf, sizeof(buf), "%d", time);
-	mpd_send(sonatina.mpdsource, MPD_CMD_SEEKCUR, buf, NULL);
+	if (ctl->busy) {
+		ctl->value = value;
+		ctl->pending = TRUE;
+		return;
+	}
+
+	snprintf(buf, sizeof(buf), "%d", value);
+	ctl->busy = mpd_send(sonatina.mpdsource, ctl->cmd, buf, NULL);
 }
 
-void sonatina_setvol(double vol)
+void sonatina_control_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
 {
-	char buf[INT_BUF_SIZE];
+	struct sonatina_control *ctl = (struct sonatina_control *) data;
 
-	snprintf(buf, sizeof(buf), "%d", (int) (vol * 100.0));
-	mpd_send(sonatina.mpdsource, MPD_CMD_SETVOL, buf, NULL);
+	if (cmd != ctl->cmd || !ctl->busy) {
+		return;
+	}
+
+	ctl->busy = FALSE;
+	if (ctl->pending) {
+		ctl->pending = FALSE;
+		sonatina_control_set(ctl, ctl->value);
+	}
 }
 
+void sonatina_seek(int time)
+{
+	sonatina_control_set(&sonatina.seek_ctl, time);
+}
 
-struct sonatina_tab *sonatina_tab_new(const char *name, const char *label, size_t size, TabInitFunc init, TabSetSourceFunc set_source, TabDestroyFunc destroy)
+void sonatina_setvol(double vol)
+{
+	sonatina_control_set(&sonatina.volume_ctl, vol * 100.0 + 0.5);
+}
+
+
+struct sonatina_tab *sonatina_tab_new(const char *name, const char *label, size_t size, TabInitFunc init, TabSetSourceFunc set_source, TabDestroyFunc destroy, TabRefreshFunc refresh)
 {
 	struct sonatina_tab *tab;
 
@@ -333,6 +756,8 @@ struct sonatina_tab *sonatina_tab_new(const char *name, const char *label, size_
 	tab->init = init;
 	tab->set_mpdsource = set_source;
 	tab->destroy = destroy;
+	tab->refresh = refresh;
+	tab->stale = FALSE;
 
 	return tab;
 }
@@ -364,6 +789,104 @@ gboolean sonatina_append_tab(struct sonatina_tab *tab)
 	return TRUE;
 }
 
+struct sonatina_tab *sonatina_get_tab(const char *name)
+{
+	GList *cur;
+	struct sonatina_tab *tab;
+
+	for (cur = sonatina.tabs; cur; cur = cur->next) {
+		tab = (struct sonatina_tab *) cur->data;
+		if (!g_strcmp0(tab->name, name)) {
+			return tab;
+		}
+	}
+
+	return NULL;
+}
+
+gboolean sonatina_tab_visible(const struct sonatina_tab *tab)
+{
+	GtkNotebook *notebook;
+
+	notebook = GTK_NOTEBOOK(gtk_builder_get_object(sonatina.gui, "notebook"));
+
+	return !sonatina.hidden &&
+		gtk_notebook_get_nth_page(notebook, gtk_notebook_get_current_page(notebook)) == tab->widget;
+}
+
+gboolean sonatina_tab_defer(struct sonatina_tab *tab)
+{
+	if (!tab->refresh || sonatina_tab_visible(tab)) {
+		return FALSE;
+	}
+
+	if (!tab->stale) {
+		MSG_DEBUG("tab %s is hidden, refreshing it later", tab->name);
+		tab->stale = TRUE;
+	}
+
+	return TRUE;
+}
+
+/**
+  @brief Refresh the tab of a notebook page if it is stale.
+  */
+static void sonatina_refresh_page(GtkWidget *page)
+{
+	struct sonatina_tab *tab;
+	GList *cur;
+
+	for (cur = sonatina.tabs; cur; cur = cur->next) {
+		tab = (struct sonatina_tab *) cur->data;
+		if (tab->widget == page && tab->stale) {
+			MSG_INFO("refreshing stale tab %s", tab->name);
+			tab->stale = FALSE;
+			tab->refresh(tab);
+		}
+	}
+}
+
+void sonatina_page_switched_cb(GtkNotebook *notebook, GtkWidget *page, guint num, gpointer data)
+{
+	if (!sonatina.hidden) {
+		sonatina_refresh_page(page);
+	}
+}
+
+void sonatina_set_hidden(gboolean hidden)
+{
+	GtkNotebook *notebook;
+
+	if (sonatina.hidden == hidden) {
+		return;
+	}
+	sonatina.hidden = hidden;
+
+	if (hidden) {
+		MSG_DEBUG("window hidden, postponing updates");
+		sonatina_update_counter();
+		return;
+	}
+
+	MSG_DEBUG("window shown, applying postponed updates");
+	if (sonatina.status_pending) {
+		sonatina.status_pending = FALSE;
+		sonatina_show_status();
+	}
+	if (sonatina.song_pending) {
+		sonatina.song_pending = FALSE;
+		sonatina_show_song(sonatina.song);
+		if (sonatina.song) {
+			mpd_song_free(sonatina.song);
+			sonatina.song = NULL;
+		}
+	}
+	sonatina_update_counter();
+
+	notebook = GTK_NOTEBOOK(gtk_builder_get_object(sonatina.gui, "notebook"));
+	sonatina_refresh_page(gtk_notebook_get_nth_page(notebook, gtk_notebook_get_current_page(notebook)));
+}
+
 gboolean sonatina_remove_tab(const char *name)
 {
 	GList *cur;
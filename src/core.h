@@ -8,12 +8,28 @@
 
 #include "client.h"
 #include "profile.h"
+#include "songattr.h"
+#include "settings.h"
+#include "art.h"
+
+/**
+  @brief Continuous control, e.g. volume, that keeps at most one command in
+  flight. Values set meanwhile replace each other and only the latest one is
+  sent when the server answers.
+  */
+struct sonatina_control {
+	enum mpd_cmd_type cmd; /** Command setting the value */
+	gboolean busy; /** TRUE while a command waits for its answer */
+	gboolean pending; /** TRUE if value is sent after the answer */
+	int value; /** Latest value not sent yet */
+};
 
 /**
   @brief Structure holding data of a running sonatina instance.
   */
 struct sonatina_instance {
 	GSource *mpdsource; /** NULL when not connected */
+	gchar *profile; /** Name of the connected profile or NULL */
 
 	GtkBuilder *gui;
 	GList *tabs;
@@ -22,8 +38,57 @@ struct sonatina_instance {
 	int elapsed_ms;
 	int total;
 	GTimer *counter;
+	guint counter_source; /** Source ID of the timeout redrawing the timeline
+				at the next second or 0 */
+	int shown_sec; /** Elapsed second shown in the timeline or -1 */
+	int shown_total; /** Total time shown in the timeline or -1 */
+
+	struct song_format *title; /** Compiled format of the first header line */
+	struct song_format *subtitle; /** Compiled format of the second header line */
+	GString *fmtbuf; /** Buffer for formatting header lines */
+
+	struct art_cache *art; /** Album art of all tabs */
+	gchar *art_key; /** Album of the current song or NULL */
+	guint64 tags; /** Tags enabled on the connection with tagtypes; bit n
+			is set when tag n of enum mpd_tag_type is enabled */
+
+	gboolean hidden; /** TRUE while the main window is unmapped or
+			   iconified; widgets are updated when it's shown */
+	int volume; /** Volume from the last status or -1 */
+	enum mpd_state state; /** Player state from the last status */
+	gboolean repeat;
+	gboolean random;
+	gboolean single;
+	gboolean consume;
+	gboolean status_pending; /** TRUE if the header doesn't show the last
+				   status yet */
+	struct mpd_song *song; /** Current song received while hidden or NULL */
+	struct mpd_song *next; /** Next song prepared to be shown when the
+				 current one ends or NULL */
+	gchar *next_title; /** Formatted first header line of next or NULL */
+	gchar *next_subtitle; /** Formatted second header line of next or NULL */
+	gint next_id; /** Id of the next song requested or prepared or -1 */
+	guint next_source; /** Source ID of the timeout showing the next song or 0 */
+	gint song_id; /** Id of the current song from the last status or -1 */
+	int duration_ms; /** Duration of the current song in milliseconds from
+			   currentsong or 0 if unknown */
+	gint duration_id; /** Id of the song duration_ms belongs to or -1 */
+	struct sonatina_control volume_ctl; /** Volume set by the volume button */
+	struct sonatina_control seek_ctl; /** Time set by clicks on the timeline */
+	gboolean song_pending; /** TRUE if the header doesn't show the current
+				 song yet */
 };
 
+/**
+  Tags needed regardless of formats: the library groups and searches songs by
+  them and album art is keyed by them.
+  */
+#define SONATINA_REQUIRED_TAGS ((guint64) 1 << MPD_TAG_ARTIST | \
+		(guint64) 1 << MPD_TAG_ALBUM_ARTIST | \
+		(guint64) 1 << MPD_TAG_ALBUM | \
+		(guint64) 1 << MPD_TAG_TITLE | \
+		(guint64) 1 << MPD_TAG_GENRE)
+
 /**
   Structure representing one tab in sonatina's notebook widget.
   */
@@ -49,11 +114,16 @@ struct sonatina_tab {
 								   NULL means
 								   disconnect. */
 	void (*destroy)(struct sonatina_tab *); /** Cleanup function to free memory allocated by init function */
+	void (*refresh)(struct sonatina_tab *); /** Function called when a stale
+						  tab becomes visible or NULL */
+	gboolean stale; /** TRUE if changes were skipped while the tab was
+			  hidden, see @a sonatina_tab_defer() */
 };
 
 typedef gboolean (*TabInitFunc)(struct sonatina_tab *);
 typedef void (*TabSetSourceFunc)(struct sonatina_tab *, GSource *);
 typedef void (*TabDestroyFunc)(struct sonatina_tab *);
+typedef void (*TabRefreshFunc)(struct sonatina_tab *);
 
 /**
   @brief Create a new tab.
@@ -62,9 +132,11 @@ typedef void (*TabDestroyFunc)(struct sonatina_tab *);
   @param size Size of the tab structure. Must be at least sizeof(struct sonatina_tab).
   @param init Function to initialize the tab.
   @param destroy Function free memory allocated by init function.
+  @param refresh Function bringing the tab up to date when it is shown after
+  it skipped changes or NULL.
   @returns A newly allocated tab that should be freed with g_free().
   */
-struct sonatina_tab *sonatina_tab_new(const char *name, const char *label, size_t size, TabInitFunc init, TabSetSourceFunc set_source, TabDestroyFunc destroy);
+struct sonatina_tab *sonatina_tab_new(const char *name, const char *label, size_t size, TabInitFunc init, TabSetSourceFunc set_source, TabDestroyFunc destroy, TabRefreshFunc refresh);
 
 void sonatina_tab_destroy(struct sonatina_tab *tab);
 
@@ -109,6 +181,59 @@ gboolean sonatina_change_profile(const struct sonatina_profile *profile);
   */
 gboolean sonatina_change_profile_by_name(const char *name);
 
+/**
+  @brief Get a tab by its name.
+  @param name Internal name of the tab.
+  @returns Tab or NULL if there is no such tab.
+  */
+struct sonatina_tab *sonatina_get_tab(const char *name);
+
+/**
+  @brief Check whether a tab is the current notebook page.
+  @param tab Tab.
+  @returns TRUE if the tab is shown.
+  */
+gboolean sonatina_tab_visible(const struct sonatina_tab *tab);
+
+/**
+  @brief Decide whether a change should be applied to a tab now. A hidden tab
+  is marked stale instead and its refresh function is called once it is shown.
+  @param tab Tab.
+  @returns TRUE if the change should be skipped.
+  */
+gboolean sonatina_tab_defer(struct sonatina_tab *tab);
+
+/**
+  @brief Tell sonatina whether the main window can be seen. While it's hidden,
+  only the state of the server is tracked; the header and the shown tab are
+  updated once when the window is shown again.
+  @param hidden TRUE if the window is unmapped or iconified.
+  */
+void sonatina_set_hidden(gboolean hidden);
+
+/**
+  @brief Callback for switch-page signal of the notebook. Refreshes the shown
+  tab if it is stale.
+  */
+void sonatina_page_switched_cb(GtkNotebook *notebook, GtkWidget *page, guint num, gpointer data);
+
+/**
+  @brief Settings callback called when format of header lines is changed.
+  Recompiles the format and requests the current song to redraw the header.
+  @param value New format.
+  @param data Settings entry that changed.
+  */
+void sonatina_title_format_changed(union settings_value value, void *data);
+
+/**
+  @brief Limit tags sent by the server in songs to the ones used by formats
+  of the header, playlist and library and @a SONATINA_REQUIRED_TAGS. Nothing is
+  sent when the tags didn't change.
+  @param force Send the tags even when they didn't change, e.g. after all tags
+  were enabled temporarily.
+  */
+void sonatina_update_tagtypes(gboolean force);
+
 /**
   @brief Callback for MPD command currentsong. Update current song on a sonatina instance.
   @param cmd MPD command type.
@@ -118,6 +243,18 @@ gboolean sonatina_change_profile_by_name(const char *name);
   */
 void sonatina_update_song(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
 
+/**
+  @brief Callback for MPD command playlistid. Keeps the next song, so that it
+  can be shown as soon as the current one ends.
+  */
+void sonatina_next_song_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Show album art of a song in the header, loading it if needed.
+  @param song Current song or NULL.
+  */
+void sonatina_show_art(const struct mpd_song *song);
+
 /**
   @brief Callback for MPD command status. Update status on a sonatina instance.
   @param cmd MPD command type.
@@ -128,12 +265,26 @@ void sonatina_update_song(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answ
 void sonatina_update_status(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
 
 /**
-  @brief Function called every second to check elapsed time and update progressbar.
+  @brief Timeout callback updating the timeline when the elapsed time reaches
+  the next second.
   @param data Unused user data.
-  @returns TRUE
+  @returns FALSE; the next timeout is added by the callback itself.
   */
 gboolean counter_cb(gpointer data);
 
+/**
+  @brief Redraw the timeline if the shown time changed and keep it ticking
+  while a song is played and the window is visible.
+  */
+void sonatina_update_counter(void);
+
+/**
+  @brief Callback for answers and errors of commands sent by controls.
+  Sends the latest value set meanwhile.
+  @param data Pointer to struct sonatina_control.
+  */
+void sonatina_control_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
 /**
   @brief Convenience function to send mpd command 'play' with integer argument.
   @param pos Position attribute of the song to be played.
@@ -141,13 +292,15 @@ gboolean counter_cb(gpointer data);
 void sonatina_play(int pos);
 
 /**
-  @brief Convenience function to send mpd command 'seekcur' with integer argument.
+  @brief Convenience function to send mpd command 'seekcur' with integer
+  argument. Seeks are coalesced, see struct sonatina_control.
   @param time Time where to seek to.
   */
 void sonatina_seek(int time);
 
 /**
-  @brief Convenience function to send mpd command 'setvol' with integer argument.
+  @brief Convenience function to send mpd command 'setvol' with integer
+  argument. Volume changes are coalesced, see struct sonatina_control.
   @param vol Volume as a value in range between 0 and 1.
   */
 void sonatina_setvol(double vol);
@@ -0,0 +1,435 @@
+#include <string.h>
+#include <glib.h>
+
+#include "foldbuf.h"
+#include "strsearch.h"
+#include "util.h"
+
+/* garbage smaller than this is never worth compacting */
+#define FOLD_BUFFER_MIN_GARBAGE 65536
+
+void fold_buffer_init(struct fold_buffer *buf)
+{
+	buf->text = g_string_new(NULL);
+	buf->records = g_array_new(FALSE, FALSE, sizeof(struct fold_record));
+	buf->rows = g_array_new(FALSE, FALSE, sizeof(guint));
+	buf->garbage = 0;
+	buf->current = -1;
+	buf->start = 0;
+	buf->needle = NULL;
+	buf->nlen = 0;
+	buf->matches = g_byte_array_new();
+	buf->n_matches = 0;
+}
+
+void fold_buffer_free(struct fold_buffer *buf)
+{
+	g_string_free(buf->text, TRUE);
+	g_array_free(buf->records, TRUE);
+	g_array_free(buf->rows, TRUE);
+	g_byte_array_free(buf->matches, TRUE);
+	g_free(buf->needle);
+}
+
+void fold_buffer_clear(struct fold_buffer *buf)
+{
+	g_string_truncate(buf->text, 0);
+	g_array_set_size(buf->records, 0);
+	g_array_set_size(buf->rows, 0);
+	g_byte_array_set_size(buf->matches, 0);
+	buf->garbage = 0;
+	buf->current = -1;
+	buf->n_matches = 0;
+}
+
+void fold_buffer_truncate(struct fold_buffer *buf, gint n_rows)
+{
+	struct fold_record *rec;
+	guint idx;
+	guint row;
+
+	if (n_rows < 0 || (guint) n_rows >= buf->rows->len) {
+		return;
+	}
+
+	for (row = n_rows; row < buf->rows->len; row++) {
+		idx = g_array_index(buf->rows, guint, row);
+		if (idx == G_MAXUINT) {
+			continue;
+		}
+		rec = &g_array_index(buf->records, struct fold_record, idx);
+		rec->row = -1;
+		buf->garbage += rec->len + 1;
+		if (row < buf->matches->len && buf->matches->data[row]) {
+			buf->n_matches--;
+		}
+	}
+
+	g_array_set_size(buf->rows, n_rows);
+	if (buf->matches->len > (guint) n_rows) {
+		g_byte_array_set_size(buf->matches, n_rows);
+	}
+}
+
+/**
+  @brief Append case-folded text to a string. Text without any non-ASCII
+  character, which is the common case for tags, is folded in place without a
+  temporary allocation.
+  */
+static void fold_append(GString *out, const gchar *text)
+{
+	const gchar *p;
+	gchar *folded;
+
+	for (p = text; *p; p++) {
+		if (*p & 0x80) {
+			break;
+		}
+	}
+
+	if (*p) {
+		folded = g_utf8_casefold(text, -1);
+		g_string_append(out, folded);
+		g_free(folded);
+		return;
+	}
+
+	for (p = text; *p; p++) {
+		g_string_append_c(out, g_ascii_tolower(*p));
+	}
+}
+
+void fold_buffer_begin_row(struct fold_buffer *buf, gint row)
+{
+	guint none = G_MAXUINT;
+
+	while (buf->rows->len <= (guint) row) {
+		g_array_append_val(buf->rows, none);
+	}
+
+	buf->current = row;
+	buf->start = buf->text->len;
+}
+
+void fold_buffer_append(struct fold_buffer *buf, const gchar *text)
+{
+	if (buf->text->len > buf->start) {
+		g_string_append_c(buf->text, '\n');
+	}
+	fold_append(buf->text, text);
+}
+
+/**
+  @brief Rewrite the buffer so that it contains only live records in row order.
+  */
+static void fold_buffer_compact(struct fold_buffer *buf)
+{
+	GString *text;
+	GArray *records;
+	struct fold_record *old;
+	struct fold_record rec;
+	guint *idx;
+	guint row;
+
+	MSG_DEBUG("compacting fold buffer, %lu of %lu bytes are garbage",
+			(unsigned long) buf->garbage, (unsigned long) buf->text->len);
+
+	text = g_string_sized_new(buf->text->len - buf->garbage);
+	records = g_array_sized_new(FALSE, FALSE, sizeof(struct fold_record), buf->rows->len);
+
+	for (row = 0; row < buf->rows->len; row++) {
+		idx = &g_array_index(buf->rows, guint, row);
+		if (*idx == G_MAXUINT) {
+			continue;
+		}
+		old = &g_array_index(buf->records, struct fold_record, *idx);
+		rec.offset = text->len;
+		rec.len = old->len;
+		rec.row = row;
+		g_string_append_len(text, buf->text->str + old->offset, old->len + 1);
+		g_array_append_val(records, rec);
+		*idx = records->len - 1;
+	}
+
+	g_string_free(buf->text, TRUE);
+	g_array_free(buf->records, TRUE);
+	buf->text = text;
+	buf->records = records;
+	buf->garbage = 0;
+}
+
+/**
+  @brief Make room for a match flag of every row; new rows don't match.
+  */
+static void fold_buffer_grow_matches(struct fold_buffer *buf)
+{
+	guint len;
+
+	len = buf->matches->len;
+	if (len < buf->rows->len) {
+		g_byte_array_set_size(buf->matches, buf->rows->len);
+		memset(buf->matches->data + len, 0, buf->matches->len - len);
+	}
+}
+
+void fold_buffer_remove_rows(struct fold_buffer *buf, const gint *rows, guint n)
+{
+	struct fold_record *rec;
+	gint *renumber;
+	guint len, mlen;
+	guint idx;
+	guint i, j, k, kmatch;
+
+	len = buf->rows->len;
+	mlen = MIN(buf->matches->len, len);
+	if (n == 0 || len == 0) {
+		return;
+	}
+
+	/* new index of every row or -1, rows and matches are compacted in place */
+	renumber = g_malloc(len * sizeof(gint));
+	for (i = 0, j = 0, k = 0, kmatch = 0; i < len; i++) {
+		while (j < n && rows[j] < (gint) i) {
+			j++;
+		}
+		if (j < n && rows[j] == (gint) i) {
+			idx = g_array_index(buf->rows, guint, i);
+			if (idx != G_MAXUINT) {
+				rec = &g_array_index(buf->records, struct fold_record, idx);
+				rec->row = -1;
+				buf->garbage += rec->len + 1;
+			}
+			if (i < mlen && buf->matches->data[i]) {
+				buf->n_matches--;
+			}
+			renumber[i] = -1;
+		} else {
+			g_array_index(buf->rows, guint, k) = g_array_index(buf->rows, guint, i);
+			if (i < mlen) {
+				buf->matches->data[kmatch++] = buf->matches->data[i];
+			}
+			renumber[i] = k++;
+		}
+	}
+
+	for (i = 0; i < buf->records->len; i++) {
+		rec = &g_array_index(buf->records, struct fold_record, i);
+		if (rec->row >= 0 && (guint) rec->row < len) {
+			rec->row = renumber[rec->row];
+		}
+	}
+
+	g_byte_array_set_size(buf->matches, kmatch);
+	g_array_set_size(buf->rows, k);
+	g_free(renumber);
+}
+
+void fold_buffer_move(struct fold_buffer *buf, gint from, gint to)
+{
+	struct fold_record *rec;
+	guint none = G_MAXUINT;
+	guint idx;
+	guint8 *matches;
+	guint8 match;
+	guint i;
+
+	if (from < 0 || to < 0 || from == to) {
+		return;
+	}
+
+	while (buf->rows->len <= (guint) MAX(from, to)) {
+		g_array_append_val(buf->rows, none);
+	}
+	fold_buffer_grow_matches(buf);
+
+	idx = g_array_index(buf->rows, guint, from);
+	g_array_remove_index(buf->rows, from);
+	g_array_insert_val(buf->rows, to, idx);
+	matches = buf->matches->data;
+	match = matches[from];
+	if (from < to) {
+		memmove(matches + from, matches + from + 1, to - from);
+	} else {
+		memmove(matches + to + 1, matches + to, from - to);
+	}
+	matches[to] = match;
+
+	for (i = 0; i < buf->records->len; i++) {
+		rec = &g_array_index(buf->records, struct fold_record, i);
+		if (rec->row == from) {
+			rec->row = to;
+		} else if (from < to && rec->row > from && rec->row <= to) {
+			rec->row--;
+		} else if (to < from && rec->row >= to && rec->row < from) {
+			rec->row++;
+		}
+	}
+}
+
+gboolean fold_buffer_end_row(struct fold_buffer *buf)
+{
+	struct fold_record rec;
+	struct fold_record *old;
+	guint *idx;
+	gboolean match = TRUE;
+
+	g_return_val_if_fail(buf->current >= 0, FALSE);
+
+	rec.offset = buf->start;
+	rec.len = buf->text->len - buf->start;
+	rec.row = buf->current;
+	g_string_append_c(buf->text, '\0');
+
+	idx = &g_array_index(buf->rows, guint, buf->current);
+	if (*idx != G_MAXUINT) {
+		old = &g_array_index(buf->records, struct fold_record, *idx);
+		old->row = -1;
+		buf->garbage += old->len + 1;
+	}
+	g_array_append_val(buf->records, rec);
+	*idx = buf->records->len - 1;
+
+	if (buf->needle) {
+		match = strsearch_find(buf->text->str + rec.offset, rec.len, buf->needle, buf->nlen) != NULL;
+		fold_buffer_grow_matches(buf);
+		buf->n_matches += (gint) match - (gint) buf->matches->data[buf->current];
+		buf->matches->data[buf->current] = match;
+	}
+
+	buf->current = -1;
+
+	if (buf->garbage > FOLD_BUFFER_MIN_GARBAGE && buf->garbage > buf->text->len / 2) {
+		fold_buffer_compact(buf);
+	}
+
+	return match;
+}
+
+/**
+  @brief Find record containing given offset of the buffer.
+  */
+static const struct fold_record *fold_buffer_record_at(const struct fold_buffer *buf, gsize offset)
+{
+	const struct fold_record *records;
+	guint lo, hi, mid;
+
+	records = (const struct fold_record *) buf->records->data;
+	lo = 0;
+	hi = buf->records->len;
+
+	/* last record with records[i].offset <= offset */
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (records[mid].offset <= offset) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return &records[lo];
+}
+
+/**
+  @brief Test rows that matched the previous needle against the current one.
+  */
+static void fold_buffer_narrow(struct fold_buffer *buf)
+{
+	const struct fold_record *rec;
+	guint row;
+
+	for (row = 0; row < buf->matches->len; row++) {
+		if (!buf->matches->data[row]) {
+			continue;
+		}
+		rec = &g_array_index(buf->records, struct fold_record, g_array_index(buf->rows, guint, row));
+		if (!strsearch_find(buf->text->str + rec->offset, rec->len, buf->needle, buf->nlen)) {
+			buf->matches->data[row] = FALSE;
+			buf->n_matches--;
+		}
+	}
+}
+
+/**
+  @brief Scan the whole buffer for the current needle. After a hit the rest of
+  its record is skipped, so every row is reported at most once.
+  */
+static void fold_buffer_scan(struct fold_buffer *buf)
+{
+	const struct fold_record *rec;
+	const char *p;
+	const char *end;
+	const char *hit;
+
+	g_byte_array_set_size(buf->matches, buf->rows->len);
+	memset(buf->matches->data, 0, buf->matches->len);
+	buf->n_matches = 0;
+
+	p = buf->text->str;
+	end = buf->text->str + buf->text->len;
+	while ((hit = strsearch_find(p, end - p, buf->needle, buf->nlen))) {
+		rec = fold_buffer_record_at(buf, hit - buf->text->str);
+		if (rec->row >= 0) {
+			buf->matches->data[rec->row] = TRUE;
+			buf->n_matches++;
+		}
+		p = buf->text->str + rec->offset + rec->len + 1;
+	}
+}
+
+gint fold_buffer_search(struct fold_buffer *buf, const gchar *needle)
+{
+	GString *folded;
+	gboolean narrow;
+
+	if (!needle || !*needle) {
+		g_free(buf->needle);
+		buf->needle = NULL;
+		buf->nlen = 0;
+		g_byte_array_set_size(buf->matches, 0);
+		buf->n_matches = 0;
+		return buf->rows->len;
+	}
+
+	folded = g_string_new(NULL);
+	fold_append(folded, needle);
+
+	if (buf->needle && !strcmp(buf->needle, folded->str)) {
+		g_string_free(folded, TRUE);
+		return buf->n_matches;
+	}
+
+	/* rows not containing the old needle can't contain a longer one */
+	narrow = buf->needle && strstr(folded->str, buf->needle);
+
+	g_free(buf->needle);
+	buf->nlen = folded->len;
+	buf->needle = g_string_free(folded, FALSE);
+
+	if (narrow) {
+		fold_buffer_narrow(buf);
+	} else {
+		fold_buffer_scan(buf);
+	}
+	MSG_DEBUG("%s search for '%s': %d of %u rows match", narrow ? "narrowing" : "full",
+			buf->needle, buf->n_matches, buf->rows->len);
+
+	return buf->n_matches;
+}
+
+gboolean fold_buffer_searching(const struct fold_buffer *buf)
+{
+	return buf->needle != NULL;
+}
+
+gboolean fold_buffer_row_matches(const struct fold_buffer *buf, gint row)
+{
+	if (!buf->needle) {
+		return TRUE;
+	}
+	if (row < 0 || (guint) row >= buf->matches->len) {
+		return FALSE;
+	}
+
+	return buf->matches->data[row];
+}
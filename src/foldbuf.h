@@ -0,0 +1,129 @@
+#ifndef FOLDBUF_H
+#define FOLDBUF_H
+
+#include <glib.h>
+
+/**
+  Folded text of one row stored in struct fold_buffer.
+  */
+struct fold_record {
+	gsize offset; /** Offset of the text in the buffer */
+	gsize len; /** Length of the text without terminating null byte */
+	gint row; /** Row the text belongs to or -1 if it was replaced */
+};
+
+/**
+  Case-folded text of rows of a list kept in one contiguous buffer, so that a
+  substring filter can scan all rows in a single pass.
+
+  The buffer is log-structured: text of an updated row is appended to the end
+  and the old copy becomes garbage, which is reclaimed once it takes more than
+  half of the buffer. Records are therefore always sorted by offset and a match
+  found anywhere in the buffer is mapped back to its row by binary search.
+  */
+struct fold_buffer {
+	GString *text; /** Folded text of all records; every record is
+			 terminated by a null byte and user-defined columns
+			 are separated by a newline */
+	GArray *records; /** Records (struct fold_record) sorted by offset */
+	GArray *rows; /** Index of the live record of every row (guint) or
+			G_MAXUINT if the row has no text yet */
+	gsize garbage; /** Number of bytes used by replaced records */
+	gint current; /** Row being written or -1 */
+	gsize start; /** Offset where text of the current row starts */
+	gchar *needle; /** Folded needle of the active search or NULL */
+	gsize nlen; /** Length of needle */
+	GByteArray *matches; /** Non-zero for every row matching needle */
+	gint n_matches; /** Number of rows matching needle */
+};
+
+/**
+  @brief Initialize an empty fold buffer.
+  @param buf Fold buffer.
+  */
+void fold_buffer_init(struct fold_buffer *buf);
+
+/**
+  @brief Free memory allocated by fold buffer.
+  @param buf Fold buffer.
+  */
+void fold_buffer_free(struct fold_buffer *buf);
+
+/**
+  @brief Remove text of all rows. The active search is kept.
+  @param buf Fold buffer.
+  */
+void fold_buffer_clear(struct fold_buffer *buf);
+
+/**
+  @brief Remove text of rows at and after given index.
+  @param buf Fold buffer.
+  @param n_rows Number of rows to keep.
+  */
+void fold_buffer_truncate(struct fold_buffer *buf, gint n_rows);
+
+/**
+  @brief Remove text of rows; following rows move up. All rows are removed in
+  one pass over the buffer.
+  @param buf Fold buffer.
+  @param rows Indices of the rows in ascending order.
+  @param n Number of rows.
+  */
+void fold_buffer_remove_rows(struct fold_buffer *buf, const gint *rows, guint n);
+
+/**
+  @brief Move text of a row to another index; rows in between shift by one.
+  @param buf Fold buffer.
+  @param from Index of the row.
+  @param to New index of the row.
+  */
+void fold_buffer_move(struct fold_buffer *buf, gint from, gint to);
+
+/**
+  @brief Start replacing text of a row. Text is then added with @a
+  fold_buffer_append() and the row is finished with @a fold_buffer_end_row().
+  @param buf Fold buffer.
+  @param row Index of the row.
+  */
+void fold_buffer_begin_row(struct fold_buffer *buf, gint row);
+
+/**
+  @brief Case-fold text of one column and append it to the current row.
+  @param buf Fold buffer.
+  @param text UTF-8 text.
+  */
+void fold_buffer_append(struct fold_buffer *buf, const gchar *text);
+
+/**
+  @brief Finish text of the current row and test it against the active search.
+  @param buf Fold buffer.
+  @returns TRUE if the row matches the active search or there is none.
+  */
+gboolean fold_buffer_end_row(struct fold_buffer *buf);
+
+/**
+  @brief Set needle of the active search and find matching rows. When the new
+  needle contains the previous one, only rows that matched before are tested.
+  @param buf Fold buffer.
+  @param needle UTF-8 text to search for. NULL or empty string cancels the
+  search.
+  @returns Number of matching rows.
+  */
+gint fold_buffer_search(struct fold_buffer *buf, const gchar *needle);
+
+/**
+  @brief Check whether search is active.
+  @param buf Fold buffer.
+  @returns TRUE when a needle is set.
+  */
+gboolean fold_buffer_searching(const struct fold_buffer *buf);
+
+/**
+  @brief Check whether a row matches the active search.
+  @param buf Fold buffer.
+  @param row Index of the row.
+  @returns TRUE if the row matches or when no search is active.
+  */
+gboolean fold_buffer_row_matches(const struct fold_buffer *buf, gint row);
+
+#endif
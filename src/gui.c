@@ -73,6 +73,10 @@ void app_startup_cb(GtkApplication *app, gpointer user_data)
 
 	win = gtk_builder_get_object(sonatina.gui, "window");
 	g_signal_connect(win, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+	/* after the default handlers, so that the mapped flag is up to date */
+	g_signal_connect_after(win, "map-event", G_CALLBACK(window_visibility_cb), NULL);
+	g_signal_connect_after(win, "unmap-event", G_CALLBACK(window_visibility_cb), NULL);
+	g_signal_connect_after(win, "window-state-event", G_CALLBACK(window_visibility_cb), NULL);
 	gtk_application_add_window(app, GTK_WINDOW(win));
 
 	connect_signals();
@@ -211,6 +215,22 @@ gboolean timeline_clicked_cb(GtkWidget *w, GdkEvent *event, gpointer data)
 	return FALSE;
 }
 
+gboolean window_visibility_cb(GtkWidget *w, GdkEvent *event, gpointer data)
+{
+	GdkWindowState state = 0;
+
+	if (event->type == GDK_WINDOW_STATE) {
+		state = ((GdkEventWindowState *) event)->new_window_state;
+	} else if (gtk_widget_get_window(w)) {
+		state = gdk_window_get_state(gtk_widget_get_window(w));
+	}
+
+	sonatina_set_hidden(event->type == GDK_UNMAP || !gtk_widget_get_mapped(w) ||
+			(state & GDK_WINDOW_STATE_ICONIFIED));
+
+	return FALSE;
+}
+
 GtkWidget *sonatina_menu(GMenuModel *specific)
 {
 	GtkWidget *menuw;
@@ -459,14 +479,31 @@ void sonatina_set_labels(const char *title, const char *subtitle)
 {
 	GObject *label;
 
+	/* labels shown in advance are usually confirmed by the server */
 	if (title) {
 		label = gtk_builder_get_object(sonatina.gui, "title");
-		gtk_label_set_text(GTK_LABEL(label), title);
+		if (g_strcmp0(gtk_label_get_text(GTK_LABEL(label)), title)) {
+			gtk_label_set_text(GTK_LABEL(label), title);
+		}
 	}
 
 	if (subtitle) {
 		label = gtk_builder_get_object(sonatina.gui, "subtitle");
-		gtk_label_set_text(GTK_LABEL(label), subtitle);
+		if (g_strcmp0(gtk_label_get_text(GTK_LABEL(label)), subtitle)) {
+			gtk_label_set_text(GTK_LABEL(label), subtitle);
+		}
+	}
+}
+
+void sonatina_set_art(GdkPixbuf *pixbuf)
+{
+	GObject *image;
+
+	image = gtk_builder_get_object(sonatina.gui, "album_art");
+	if (pixbuf) {
+		gtk_image_set_from_pixbuf(GTK_IMAGE(image), pixbuf);
+	} else {
+		gtk_image_set_from_icon_name(GTK_IMAGE(image), "sonatina", GTK_ICON_SIZE_DIALOG);
 	}
 }
 
@@ -485,14 +522,30 @@ void settings_entry_cb(GtkEntry *w, gpointer data)
 {
 	const struct settings_entry *entry = (const struct settings_entry *) data;
 	union settings_value val;
+	gchar *old;
 
 	g_assert(entry != NULL);
 
+	old = sonatina_settings_get_string(entry->section, entry->name);
+	if (!g_strcmp0(old, gtk_entry_get_text(w))) {
+		/* e.g. focus left the entry without editing it */
+		g_free(old);
+		return;
+	}
+	g_free(old);
+
 	val.string = g_strdup(gtk_entry_get_text(w));
 	sonatina_settings_set(entry->section, entry->name, val);
 	g_free(val.string);
 }
 
+gboolean settings_entry_focus_cb(GtkWidget *w, GdkEvent *event, gpointer data)
+{
+	settings_entry_cb(GTK_ENTRY(w), data);
+
+	return FALSE;
+}
+
 gboolean append_settings_toggle(GtkGrid *grid, const char *section, const char *name)
 {
 	GtkWidget *cb;
@@ -512,7 +565,7 @@ gboolean append_settings_toggle(GtkGrid *grid, const char *section, const char *
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cb), val.boolean);
 	g_object_set(G_OBJECT(cb), "margin", WIDGET_MARGIN, NULL);
 
-	g_signal_connect(G_OBJECT(cb), "toggle", G_CALLBACK(settings_toggle_cb), (gpointer) e);
+	g_signal_connect(G_OBJECT(cb), "toggled", G_CALLBACK(settings_toggle_cb), (gpointer) e);
 
 	gtk_grid_attach_next_to(grid, cb, NULL, GTK_POS_BOTTOM, 1, 1);
 
@@ -542,7 +595,9 @@ gboolean append_settings_text(GtkGrid *grid, const char *section, const char *na
 	g_object_set(G_OBJECT(label), "margin", WIDGET_MARGIN, NULL);
 	gtk_widget_set_halign(label, GTK_ALIGN_START);
 
-	g_signal_connect(G_OBJECT(entry), "changed", G_CALLBACK(settings_entry_cb), (gpointer) e);
+	/* formats are recompiled and listings reloaded, not on every keystroke */
+	g_signal_connect(G_OBJECT(entry), "activate", G_CALLBACK(settings_entry_cb), (gpointer) e);
+	g_signal_connect(G_OBJECT(entry), "focus-out-event", G_CALLBACK(settings_entry_focus_cb), (gpointer) e);
 
 	gtk_grid_attach_next_to(grid, label, NULL, GTK_POS_BOTTOM, 1, 1);
 	gtk_grid_attach_next_to(grid, entry, label, GTK_POS_RIGHT, 1, 1);
@@ -574,6 +629,13 @@ void prepare_settings_dialog()
 	append_settings_text(GTK_GRID(grid), "main", "title");
 	append_settings_text(GTK_GRID(grid), "main", "subtitle");
 
+	/* Library frame */
+	grid = gtk_builder_get_object(settings_ui, "library_grid");
+	append_settings_toggle(GTK_GRID(grid), "library", "cache");
+	append_settings_toggle(GTK_GRID(grid), "library", "ignore_the");
+	append_settings_toggle(GTK_GRID(grid), "library", "albums_by_date");
+	append_settings_toggle(GTK_GRID(grid), "library", "album_tree");
+
 	model = gtk_builder_get_object(settings_ui, "profile_chooser_model");
 	chooser = gtk_builder_get_object(settings_ui, "profile_chooser");
 	renderer = gtk_cell_renderer_text_new();
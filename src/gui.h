@@ -17,9 +17,17 @@ void next_cb(GtkWidget *w, gpointer data);
 void play_cb(GtkWidget *w, gpointer data);
 void pause_cb(GtkWidget *w, gpointer data);
 void stop_cb(GtkWidget *w, gpointer data);
+void volume_cb(GtkWidget *w, gpointer data);
 
 gboolean timeline_clicked_cb(GtkWidget *w, GdkEvent *event, gpointer data);
 
+/**
+  @brief GTK callback for map, unmap and window-state-event signals of the
+  main window. Tells sonatina whether the window can be seen.
+  @param w Main window.
+  */
+gboolean window_visibility_cb(GtkWidget *w, GdkEvent *event, gpointer data);
+
 /**
   @brief GTK callback for 'popup' signal that dispays sonatina menu.
   @param w Widget that emitted the signal.
@@ -73,6 +81,12 @@ void toggle_action_changed(GSimpleAction *action, GVariant *state, gpointer data
   */
 void sonatina_set_labels(const char *title, const char *subtitle);
 
+/**
+  @brief Show album art in the header.
+  @param pixbuf Thumbnail or NULL to show the application icon.
+  */
+void sonatina_set_art(GdkPixbuf *pixbuf);
+
 /**
   @brief Callback for check button used in settings dialog. It sets a boolean
   type settings entry.
@@ -82,13 +96,19 @@ void sonatina_set_labels(const char *title, const char *subtitle);
 void settings_toggle_cb(GtkToggleButton *button, gpointer data);
 
 /**
-  @brief Callback for GtkEntry used in settings dialog. It sets a string
-  type settings entry.
+  @brief Callback for activation of GtkEntry used in settings dialog. It sets
+  a string type settings entry if the text differs from it.
   @param w Widget that emitted the signal.
   @param data Pointer to struct settings_entry of the corresponding setting.
   */
 void settings_entry_cb(GtkEntry *w, gpointer data);
 
+/**
+  @brief Callback for focus-out-event of GtkEntry used in settings dialog.
+  Sets the entry like @a settings_entry_cb().
+  */
+gboolean settings_entry_focus_cb(GtkWidget *w, GdkEvent *event, gpointer data);
+
 gboolean append_settings_toggle(GtkGrid *grid, const char *section, const char *name);
 gboolean append_settings_text(GtkGrid *grid, const char *section, const char *name);
 
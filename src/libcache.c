@@ -0,0 +1,967 @@
+#include <string.h>
+#include <glib.h>
+#include <mpd/client.h>
+
+#include "libcache.h"
+#include "util.h"
+
+static const char libcache_magic[8] = { 'S', 'O', 'N', 'L', 'I', 'B', 'D', 'B' };
+
+/**
+  Key and value looked up in an index array.
+  */
+struct libcache_lookup {
+	enum libcache_key key;
+	const gchar *value;
+};
+
+typedef gint (*LibcacheCmpFunc)(const struct libcache *cache, guint32 pos, gconstpointer key);
+
+static guint32 libcache_builder_intern(struct libcache_builder *builder, const gchar *str)
+{
+	gpointer offset;
+	guint32 retval;
+
+	offset = g_hash_table_lookup(builder->interned, str);
+	if (offset) {
+		/* offsets are stored incremented to tell them apart from NULL */
+		return GPOINTER_TO_UINT(offset) - 1;
+	}
+
+	retval = builder->strings->len;
+	g_string_append_len(builder->strings, str, strlen(str) + 1);
+	g_hash_table_insert(builder->interned, g_strdup(str), GUINT_TO_POINTER(retval + 1));
+
+	return retval;
+}
+
+struct libcache_builder *libcache_builder_new(void)
+{
+	struct libcache_builder *builder;
+	struct libcache_dir root;
+
+	builder = g_malloc(sizeof(struct libcache_builder));
+	builder->strings = g_string_new(NULL);
+	builder->interned = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	builder->dirs = g_array_new(FALSE, FALSE, sizeof(struct libcache_dir));
+	builder->songs = g_array_new(FALSE, FALSE, sizeof(struct libcache_song));
+	builder->tags = g_array_new(FALSE, FALSE, sizeof(struct libcache_tag));
+	builder->playlists = g_array_new(FALSE, FALSE, sizeof(struct libcache_playlist));
+	builder->current = MPD_ENTITY_TYPE_UNKNOWN;
+	builder->albumartist = FALSE;
+
+	/* offset 0 is the empty string, so zeroed fields mean "not set" */
+	libcache_builder_intern(builder, "");
+
+	/* listings don't include the root directory itself */
+	root.path = 0;
+	root.parent = 0;
+	root.mtime = 0;
+	g_array_append_val(builder->dirs, root);
+
+	return builder;
+}
+
+void libcache_builder_free(struct libcache_builder *builder)
+{
+	if (!builder) {
+		return;
+	}
+
+	g_string_free(builder->strings, TRUE);
+	g_hash_table_destroy(builder->interned);
+	g_array_free(builder->dirs, TRUE);
+	g_array_free(builder->songs, TRUE);
+	g_array_free(builder->tags, TRUE);
+	g_array_free(builder->playlists, TRUE);
+	g_free(builder);
+}
+
+gboolean libcache_builder_feed(struct libcache_builder *builder, const struct mpd_pair *pair)
+{
+	struct libcache_dir dir;
+	struct libcache_song song;
+	struct libcache_playlist pl;
+	struct libcache_song *cur;
+	struct libcache_tag tag;
+	enum mpd_tag_type type;
+
+	if (!strcmp(pair->name, "directory")) {
+		memset(&dir, 0, sizeof(dir));
+		dir.path = libcache_builder_intern(builder, pair->value);
+		g_array_append_val(builder->dirs, dir);
+		builder->current = MPD_ENTITY_TYPE_DIRECTORY;
+		return TRUE;
+	}
+	if (!strcmp(pair->name, "file")) {
+		memset(&song, 0, sizeof(song));
+		song.uri = libcache_builder_intern(builder, pair->value);
+		song.tags = builder->tags->len;
+		g_array_append_val(builder->songs, song);
+		builder->current = MPD_ENTITY_TYPE_SONG;
+		builder->albumartist = FALSE;
+		return TRUE;
+	}
+	if (!strcmp(pair->name, "playlist")) {
+		memset(&pl, 0, sizeof(pl));
+		pl.path = libcache_builder_intern(builder, pair->value);
+		g_array_append_val(builder->playlists, pl);
+		builder->current = MPD_ENTITY_TYPE_PLAYLIST;
+		return TRUE;
+	}
+
+	if (!strcmp(pair->name, "Last-Modified")) {
+		switch (builder->current) {
+		case MPD_ENTITY_TYPE_DIRECTORY:
+			g_array_index(builder->dirs, struct libcache_dir, builder->dirs->len - 1).mtime =
+				libcache_builder_intern(builder, pair->value);
+			break;
+		case MPD_ENTITY_TYPE_SONG:
+			g_array_index(builder->songs, struct libcache_song, builder->songs->len - 1).mtime =
+				libcache_builder_intern(builder, pair->value);
+			break;
+		case MPD_ENTITY_TYPE_PLAYLIST:
+			g_array_index(builder->playlists, struct libcache_playlist, builder->playlists->len - 1).mtime =
+				libcache_builder_intern(builder, pair->value);
+			break;
+		default:
+			break;
+		}
+		return TRUE;
+	}
+
+	if (builder->current != MPD_ENTITY_TYPE_SONG) {
+		return TRUE;
+	}
+
+	cur = &g_array_index(builder->songs, struct libcache_song, builder->songs->len - 1);
+
+	if (!strcmp(pair->name, "Time")) {
+		cur->time = libcache_builder_intern(builder, pair->value);
+		return TRUE;
+	}
+	if (!strcmp(pair->name, "duration")) {
+		cur->duration = libcache_builder_intern(builder, pair->value);
+		return TRUE;
+	}
+
+	type = mpd_tag_name_parse(pair->name);
+	if (type == MPD_TAG_UNKNOWN) {
+		return TRUE;
+	}
+
+	tag.type = type;
+	tag.value = libcache_builder_intern(builder, pair->value);
+	g_array_append_val(builder->tags, tag);
+	cur->n_tags++;
+
+	switch (type) {
+	case MPD_TAG_GENRE:
+		if (!cur->genre) {
+			cur->genre = tag.value;
+		}
+		break;
+	case MPD_TAG_ALBUM_ARTIST:
+		if (!builder->albumartist) {
+			cur->artist = tag.value;
+			builder->albumartist = TRUE;
+		}
+		break;
+	case MPD_TAG_ARTIST:
+		if (!builder->albumartist && !cur->artist) {
+			cur->artist = tag.value;
+		}
+		break;
+	case MPD_TAG_ALBUM:
+		if (!cur->album) {
+			cur->album = tag.value;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return TRUE;
+}
+
+static guint32 libcache_song_key(const struct libcache_song *song, enum libcache_key key)
+{
+	switch (key) {
+	case LIBCACHE_GENRE:
+		return song->genre;
+	case LIBCACHE_ARTIST:
+		return song->artist;
+	case LIBCACHE_ALBUM:
+		return song->album;
+	default:
+		return 0;
+	}
+}
+
+/**
+  @brief Append every value of a key of a song to an array of string offsets,
+  or the empty string if the song has none. Like MPD, artists stand in for a
+  missing album artist.
+  @param tags Tag table.
+  @param song Song.
+  @param key Key.
+  @param values Array of guint32.
+  */
+static void libcache_song_values(const struct libcache_tag *tags, const struct libcache_song *song,
+		enum libcache_key key, GArray *values)
+{
+	enum mpd_tag_type type;
+	guint32 empty = 0;
+	guint len;
+	guint32 i;
+
+	switch (key) {
+	case LIBCACHE_GENRE:
+		type = MPD_TAG_GENRE;
+		break;
+	case LIBCACHE_ARTIST:
+		type = MPD_TAG_ARTIST;
+		for (i = song->tags; i < song->tags + song->n_tags; i++) {
+			if (tags[i].type == MPD_TAG_ALBUM_ARTIST) {
+				type = MPD_TAG_ALBUM_ARTIST;
+				break;
+			}
+		}
+		break;
+	case LIBCACHE_ALBUM:
+		type = MPD_TAG_ALBUM;
+		break;
+	default:
+		return;
+	}
+
+	len = values->len;
+	for (i = song->tags; i < song->tags + song->n_tags; i++) {
+		if ((enum mpd_tag_type) tags[i].type == type) {
+			g_array_append_val(values, tags[i].value);
+		}
+	}
+	if (values->len == len) {
+		g_array_append_val(values, empty);
+	}
+}
+
+/*
+ * Comparison functions used while sorting; user data is the builder.
+ */
+
+static gint libcache_sort_dirs(gconstpointer a, gconstpointer b, gpointer data)
+{
+	const struct libcache_builder *builder = (const struct libcache_builder *) data;
+	const struct libcache_dir *x = (const struct libcache_dir *) a;
+	const struct libcache_dir *y = (const struct libcache_dir *) b;
+
+	return strcmp(builder->strings->str + x->path, builder->strings->str + y->path);
+}
+
+static gint libcache_sort_children(gconstpointer a, gconstpointer b, gpointer data)
+{
+	const struct libcache_builder *builder = (const struct libcache_builder *) data;
+	const struct libcache_dir *x = &g_array_index(builder->dirs, struct libcache_dir, *(const guint32 *) a);
+	const struct libcache_dir *y = &g_array_index(builder->dirs, struct libcache_dir, *(const guint32 *) b);
+
+	if (x->parent != y->parent) {
+		return x->parent < y->parent ? -1 : 1;
+	}
+
+	return strcmp(builder->strings->str + x->path, builder->strings->str + y->path);
+}
+
+static gint libcache_sort_playlists(gconstpointer a, gconstpointer b, gpointer data)
+{
+	const struct libcache_builder *builder = (const struct libcache_builder *) data;
+	const struct libcache_playlist *x = (const struct libcache_playlist *) a;
+	const struct libcache_playlist *y = (const struct libcache_playlist *) b;
+
+	if (x->dir != y->dir) {
+		return x->dir < y->dir ? -1 : 1;
+	}
+
+	return strcmp(builder->strings->str + x->path, builder->strings->str + y->path);
+}
+
+/**
+  @brief Compare two songs by a list of keys, then by URI.
+  */
+static gint libcache_sort_songs_by(const struct libcache_builder *builder, guint32 a, guint32 b, const enum libcache_key *keys)
+{
+	const struct libcache_song *x = &g_array_index(builder->songs, struct libcache_song, a);
+	const struct libcache_song *y = &g_array_index(builder->songs, struct libcache_song, b);
+	guint32 kx, ky;
+	gint cmp;
+
+	for (; *keys != LIBCACHE_NONE; keys++) {
+		kx = libcache_song_key(x, *keys);
+		ky = libcache_song_key(y, *keys);
+		if (kx != ky) {
+			cmp = strcmp(builder->strings->str + kx, builder->strings->str + ky);
+			if (cmp) {
+				return cmp;
+			}
+		}
+	}
+
+	return strcmp(builder->strings->str + x->uri, builder->strings->str + y->uri);
+}
+
+/**
+  @brief Compare two index entries by value, then their songs by a list of
+  keys and URI.
+  */
+static gint libcache_sort_entries_by(const struct libcache_builder *builder, gconstpointer a, gconstpointer b,
+		const enum libcache_key *keys)
+{
+	const struct libcache_entry *x = (const struct libcache_entry *) a;
+	const struct libcache_entry *y = (const struct libcache_entry *) b;
+	gint cmp;
+
+	if (x->value != y->value) {
+		cmp = strcmp(builder->strings->str + x->value, builder->strings->str + y->value);
+		if (cmp) {
+			return cmp;
+		}
+	}
+
+	return libcache_sort_songs_by(builder, x->song, y->song, keys);
+}
+
+static gint libcache_sort_by_genre(gconstpointer a, gconstpointer b, gpointer data)
+{
+	static const enum libcache_key keys[] = { LIBCACHE_ARTIST, LIBCACHE_ALBUM, LIBCACHE_NONE };
+
+	return libcache_sort_entries_by(data, a, b, keys);
+}
+
+static gint libcache_sort_by_artist(gconstpointer a, gconstpointer b, gpointer data)
+{
+	static const enum libcache_key keys[] = { LIBCACHE_ALBUM, LIBCACHE_NONE };
+
+	return libcache_sort_entries_by(data, a, b, keys);
+}
+
+static gint libcache_sort_by_album(gconstpointer a, gconstpointer b, gpointer data)
+{
+	static const enum libcache_key keys[] = { LIBCACHE_ARTIST, LIBCACHE_NONE };
+
+	return libcache_sort_entries_by(data, a, b, keys);
+}
+
+static gint libcache_sort_by_dir(gconstpointer a, gconstpointer b, gpointer data)
+{
+	const struct libcache_builder *builder = (const struct libcache_builder *) data;
+	const struct libcache_song *x = &g_array_index(builder->songs, struct libcache_song, *(const guint32 *) a);
+	const struct libcache_song *y = &g_array_index(builder->songs, struct libcache_song, *(const guint32 *) b);
+
+	if (x->dir != y->dir) {
+		return x->dir < y->dir ? -1 : 1;
+	}
+
+	return strcmp(builder->strings->str + x->uri, builder->strings->str + y->uri);
+}
+
+/**
+  @brief Find index of the directory containing given path.
+  @param builder Cache builder with sorted directories.
+  @param dir_index Maps path offsets to directory indices incremented by one.
+  @param path Offset of the path.
+  */
+static guint32 libcache_builder_parent(struct libcache_builder *builder, GHashTable *dir_index, guint32 path)
+{
+	const gchar *str;
+	const gchar *slash;
+	gchar *parent;
+	gpointer offset;
+	gpointer idx;
+
+	str = builder->strings->str + path;
+	slash = strrchr(str, '/');
+	if (!slash) {
+		/* root directory sorts first */
+		return 0;
+	}
+
+	parent = g_strndup(str, slash - str);
+	offset = g_hash_table_lookup(builder->interned, parent);
+	g_free(parent);
+	if (!offset) {
+		return 0;
+	}
+
+	idx = g_hash_table_lookup(dir_index, GUINT_TO_POINTER(GPOINTER_TO_UINT(offset) - 1));
+
+	return idx ? GPOINTER_TO_UINT(idx) - 1 : 0;
+}
+
+static guint32 *libcache_song_index(struct libcache_builder *builder, GCompareDataFunc func)
+{
+	guint32 *idx;
+	guint32 i;
+
+	idx = g_malloc(builder->songs->len * sizeof(guint32));
+	for (i = 0; i < builder->songs->len; i++) {
+		idx[i] = i;
+	}
+	g_qsort_with_data(idx, builder->songs->len, sizeof(guint32), func, builder);
+
+	return idx;
+}
+
+/**
+  @brief Build a sorted index with an entry for every value of a key.
+  @returns Array of struct libcache_entry.
+  */
+static GArray *libcache_entry_index(struct libcache_builder *builder, enum libcache_key key, GCompareDataFunc func)
+{
+	const struct libcache_tag *tags = (const struct libcache_tag *) builder->tags->data;
+	struct libcache_entry *entries;
+	struct libcache_entry entry;
+	GArray *values;
+	GArray *idx;
+	guint32 i, j, n;
+
+	values = g_array_new(FALSE, FALSE, sizeof(guint32));
+	idx = g_array_new(FALSE, FALSE, sizeof(struct libcache_entry));
+	for (i = 0; i < builder->songs->len; i++) {
+		g_array_set_size(values, 0);
+		libcache_song_values(tags, &g_array_index(builder->songs, struct libcache_song, i), key, values);
+		entry.song = i;
+		for (j = 0; j < values->len; j++) {
+			entry.value = g_array_index(values, guint32, j);
+			g_array_append_val(idx, entry);
+		}
+	}
+	g_array_free(values, TRUE);
+	g_array_sort_with_data(idx, func, builder);
+
+	/* a value repeated in one song sorts next to itself, list the song once */
+	entries = (struct libcache_entry *) idx->data;
+	n = 0;
+	for (i = 0; i < idx->len; i++) {
+		if (n > 0 && entries[i].value == entries[n - 1].value && entries[i].song == entries[n - 1].song) {
+			continue;
+		}
+		entries[n++] = entries[i];
+	}
+	g_array_set_size(idx, n);
+
+	return idx;
+}
+
+static guint32 libcache_append(GByteArray *buf, gconstpointer data, gsize len)
+{
+	static const guint8 zero[4] = { 0, 0, 0, 0 };
+	guint32 offset;
+
+	offset = buf->len;
+	g_byte_array_append(buf, data, len);
+	/* keep following sections aligned */
+	g_byte_array_append(buf, zero, (4 - len % 4) % 4);
+
+	return offset;
+}
+
+gboolean libcache_builder_write(struct libcache_builder *builder, const char *path, guint64 db_update)
+{
+	struct libcache_header header;
+	struct libcache_dir *dir;
+	struct libcache_song *song;
+	struct libcache_playlist *pl;
+	GHashTable *dir_index;
+	GByteArray *buf;
+	GArray *entries;
+	guint32 *children;
+	guint32 *idx;
+	guint32 i;
+	gchar *dirname;
+	gboolean success;
+	GError *err = NULL;
+	gint64 t;
+
+	t = g_get_monotonic_time();
+
+	g_qsort_with_data(builder->dirs->data, builder->dirs->len, sizeof(struct libcache_dir), libcache_sort_dirs, builder);
+	dir_index = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < builder->dirs->len; i++) {
+		dir = &g_array_index(builder->dirs, struct libcache_dir, i);
+		g_hash_table_insert(dir_index, GUINT_TO_POINTER(dir->path), GUINT_TO_POINTER(i + 1));
+	}
+	for (i = 1; i < builder->dirs->len; i++) {
+		dir = &g_array_index(builder->dirs, struct libcache_dir, i);
+		dir->parent = libcache_builder_parent(builder, dir_index, dir->path);
+	}
+	for (i = 0; i < builder->songs->len; i++) {
+		song = &g_array_index(builder->songs, struct libcache_song, i);
+		song->dir = libcache_builder_parent(builder, dir_index, song->uri);
+	}
+	for (i = 0; i < builder->playlists->len; i++) {
+		pl = &g_array_index(builder->playlists, struct libcache_playlist, i);
+		pl->dir = libcache_builder_parent(builder, dir_index, pl->path);
+	}
+	g_hash_table_destroy(dir_index);
+
+	g_qsort_with_data(builder->playlists->data, builder->playlists->len, sizeof(struct libcache_playlist),
+			libcache_sort_playlists, builder);
+
+	children = g_malloc(builder->dirs->len * sizeof(guint32));
+	for (i = 0; i < builder->dirs->len; i++) {
+		children[i] = i;
+	}
+	/* root is not a child of anything */
+	g_qsort_with_data(children + 1, builder->dirs->len - 1, sizeof(guint32), libcache_sort_children, builder);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, libcache_magic, sizeof(libcache_magic));
+	header.db_update = db_update;
+	header.version = LIBCACHE_FILE_VERSION;
+	header.strings_len = builder->strings->len;
+	header.n_dirs = builder->dirs->len;
+	header.n_songs = builder->songs->len;
+	header.n_tags = builder->tags->len;
+	header.n_playlists = builder->playlists->len;
+
+	buf = g_byte_array_new();
+	libcache_append(buf, &header, sizeof(header));
+	header.off_strings = libcache_append(buf, builder->strings->str, builder->strings->len);
+	header.off_dirs = libcache_append(buf, builder->dirs->data, builder->dirs->len * sizeof(struct libcache_dir));
+	header.off_dir_children = libcache_append(buf, children + 1, (builder->dirs->len - 1) * sizeof(guint32));
+	header.off_songs = libcache_append(buf, builder->songs->data, builder->songs->len * sizeof(struct libcache_song));
+	header.off_tags = libcache_append(buf, builder->tags->data, builder->tags->len * sizeof(struct libcache_tag));
+	header.off_playlists = libcache_append(buf, builder->playlists->data,
+			builder->playlists->len * sizeof(struct libcache_playlist));
+	g_free(children);
+
+	entries = libcache_entry_index(builder, LIBCACHE_GENRE, libcache_sort_by_genre);
+	header.n_by_genre = entries->len;
+	header.off_by_genre = libcache_append(buf, entries->data, entries->len * sizeof(struct libcache_entry));
+	g_array_free(entries, TRUE);
+	entries = libcache_entry_index(builder, LIBCACHE_ARTIST, libcache_sort_by_artist);
+	header.n_by_artist = entries->len;
+	header.off_by_artist = libcache_append(buf, entries->data, entries->len * sizeof(struct libcache_entry));
+	g_array_free(entries, TRUE);
+	entries = libcache_entry_index(builder, LIBCACHE_ALBUM, libcache_sort_by_album);
+	header.n_by_album = entries->len;
+	header.off_by_album = libcache_append(buf, entries->data, entries->len * sizeof(struct libcache_entry));
+	g_array_free(entries, TRUE);
+	idx = libcache_song_index(builder, libcache_sort_by_dir);
+	header.off_by_dir = libcache_append(buf, idx, builder->songs->len * sizeof(guint32));
+	g_free(idx);
+
+	memcpy(buf->data, &header, sizeof(header));
+
+	dirname = g_path_get_dirname(path);
+	g_mkdir_with_parents(dirname, 0700);
+	g_free(dirname);
+
+	success = g_file_set_contents(path, (const gchar *) buf->data, buf->len, &err);
+	if (success) {
+		MSG_INFO("library cache with %u songs written in %ld ms", builder->songs->len,
+				(long) ((g_get_monotonic_time() - t) / 1000));
+	} else {
+		MSG_WARNING("couldn't write library cache: %s", err->message);
+		g_error_free(err);
+	}
+
+	g_byte_array_free(buf, TRUE);
+
+	return success;
+}
+
+/**
+  @brief Check that a section of given size lies within the file.
+  */
+static gboolean libcache_section_valid(gsize len, guint32 offset, guint32 n, gsize size)
+{
+	return offset % 4 == 0 && offset <= len && (len - offset) / size >= n;
+}
+
+/**
+  @brief Get index array of a key.
+  @param cache Opened cache.
+  @param key Key.
+  @param n Return location for the number of entries.
+  */
+static const struct libcache_entry *libcache_index(const struct libcache *cache, enum libcache_key key, guint32 *n)
+{
+	switch (key) {
+	case LIBCACHE_GENRE:
+		*n = cache->header->n_by_genre;
+		return cache->by_genre;
+	case LIBCACHE_ARTIST:
+		*n = cache->header->n_by_artist;
+		return cache->by_artist;
+	case LIBCACHE_ALBUM:
+		*n = cache->header->n_by_album;
+		return cache->by_album;
+	default:
+		*n = 0;
+		return NULL;
+	}
+}
+
+/**
+  @brief Check that all offsets and indices stored in the cache point inside
+  their tables, so a damaged file can't make lookups read out of bounds.
+  */
+static gboolean libcache_validate(const struct libcache *cache)
+{
+	const struct libcache_header *h = cache->header;
+	const struct libcache_song *song;
+	const struct libcache_entry *entries;
+	enum libcache_key key;
+	guint32 n;
+	guint32 i;
+
+	if (h->strings_len == 0 || cache->strings[h->strings_len - 1] != '\0') {
+		return FALSE;
+	}
+	for (i = 0; i < h->n_dirs; i++) {
+		if (cache->dirs[i].path >= h->strings_len || cache->dirs[i].mtime >= h->strings_len ||
+		    cache->dirs[i].parent >= h->n_dirs) {
+			return FALSE;
+		}
+	}
+	for (i = 0; i + 1 < h->n_dirs; i++) {
+		if (cache->dir_children[i] >= h->n_dirs) {
+			return FALSE;
+		}
+	}
+	for (i = 0; i < h->n_songs; i++) {
+		song = &cache->songs[i];
+		if (song->uri >= h->strings_len || song->genre >= h->strings_len ||
+		    song->artist >= h->strings_len || song->album >= h->strings_len ||
+		    song->time >= h->strings_len || song->duration >= h->strings_len ||
+		    song->mtime >= h->strings_len || song->dir >= h->n_dirs ||
+		    song->tags > h->n_tags || h->n_tags - song->tags < song->n_tags) {
+			return FALSE;
+		}
+		if (cache->by_dir[i] >= h->n_songs) {
+			return FALSE;
+		}
+	}
+	for (key = LIBCACHE_GENRE; key <= LIBCACHE_ALBUM; key++) {
+		entries = libcache_index(cache, key, &n);
+		for (i = 0; i < n; i++) {
+			if (entries[i].value >= h->strings_len || entries[i].song >= h->n_songs) {
+				return FALSE;
+			}
+		}
+	}
+	for (i = 0; i < h->n_tags; i++) {
+		if (cache->tags[i].type >= MPD_TAG_COUNT || cache->tags[i].value >= h->strings_len) {
+			return FALSE;
+		}
+	}
+	for (i = 0; i < h->n_playlists; i++) {
+		if (cache->playlists[i].path >= h->strings_len || cache->playlists[i].mtime >= h->strings_len ||
+		    cache->playlists[i].dir >= h->n_dirs) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+struct libcache *libcache_open(const char *path)
+{
+	struct libcache *cache;
+	GMappedFile *file;
+	const gchar *data;
+	const struct libcache_header *h;
+	gsize len;
+
+	file = g_mapped_file_new(path, FALSE, NULL);
+	if (!file) {
+		return NULL;
+	}
+
+	data = g_mapped_file_get_contents(file);
+	len = g_mapped_file_get_length(file);
+	h = (const struct libcache_header *) data;
+
+	if (len < sizeof(struct libcache_header) || memcmp(h->magic, libcache_magic, sizeof(libcache_magic)) ||
+	    h->version != LIBCACHE_FILE_VERSION ||
+	    !libcache_section_valid(len, h->off_strings, h->strings_len, 1) ||
+	    !libcache_section_valid(len, h->off_dirs, h->n_dirs, sizeof(struct libcache_dir)) ||
+	    h->n_dirs == 0 ||
+	    !libcache_section_valid(len, h->off_dir_children, h->n_dirs - 1, sizeof(guint32)) ||
+	    !libcache_section_valid(len, h->off_songs, h->n_songs, sizeof(struct libcache_song)) ||
+	    !libcache_section_valid(len, h->off_tags, h->n_tags, sizeof(struct libcache_tag)) ||
+	    !libcache_section_valid(len, h->off_playlists, h->n_playlists, sizeof(struct libcache_playlist)) ||
+	    !libcache_section_valid(len, h->off_by_genre, h->n_by_genre, sizeof(struct libcache_entry)) ||
+	    !libcache_section_valid(len, h->off_by_artist, h->n_by_artist, sizeof(struct libcache_entry)) ||
+	    !libcache_section_valid(len, h->off_by_album, h->n_by_album, sizeof(struct libcache_entry)) ||
+	    !libcache_section_valid(len, h->off_by_dir, h->n_songs, sizeof(guint32))) {
+		MSG_WARNING("library cache %s is invalid", path);
+		g_mapped_file_unref(file);
+		return NULL;
+	}
+
+	cache = g_malloc(sizeof(struct libcache));
+	cache->file = file;
+	cache->header = h;
+	cache->strings = data + h->off_strings;
+	cache->dirs = (const struct libcache_dir *) (data + h->off_dirs);
+	cache->dir_children = (const guint32 *) (data + h->off_dir_children);
+	cache->songs = (const struct libcache_song *) (data + h->off_songs);
+	cache->tags = (const struct libcache_tag *) (data + h->off_tags);
+	cache->playlists = (const struct libcache_playlist *) (data + h->off_playlists);
+	cache->by_genre = (const struct libcache_entry *) (data + h->off_by_genre);
+	cache->by_artist = (const struct libcache_entry *) (data + h->off_by_artist);
+	cache->by_album = (const struct libcache_entry *) (data + h->off_by_album);
+	cache->by_dir = (const guint32 *) (data + h->off_by_dir);
+
+	if (!libcache_validate(cache)) {
+		MSG_WARNING("library cache %s is damaged", path);
+		libcache_close(cache);
+		return NULL;
+	}
+
+	MSG_INFO("opened library cache with %u songs", h->n_songs);
+
+	return cache;
+}
+
+void libcache_close(struct libcache *cache)
+{
+	if (!cache) {
+		return;
+	}
+
+	g_mapped_file_unref(cache->file);
+	g_free(cache);
+}
+
+guint64 libcache_db_update(const struct libcache *cache)
+{
+	return cache->header->db_update;
+}
+
+const gchar *libcache_str(const struct libcache *cache, guint32 offset)
+{
+	return cache->strings + offset;
+}
+
+/**
+  @brief Find positions [begin, end) of an array sorted by @a cmp where @a cmp
+  returns 0.
+  */
+static void libcache_equal_range(const struct libcache *cache, guint32 n, LibcacheCmpFunc cmp, gconstpointer key,
+		guint32 *begin, guint32 *end)
+{
+	guint32 lo, hi, mid;
+
+	lo = 0;
+	hi = n;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (cmp(cache, mid, key) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*begin = lo;
+
+	hi = n;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (cmp(cache, mid, key) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*end = lo;
+}
+
+static gint libcache_cmp_key(const struct libcache *cache, guint32 pos, gconstpointer data)
+{
+	const struct libcache_lookup *lookup = (const struct libcache_lookup *) data;
+	guint32 n;
+
+	return strcmp(cache->strings + libcache_index(cache, lookup->key, &n)[pos].value, lookup->value);
+}
+
+static gint libcache_cmp_dir_path(const struct libcache *cache, guint32 pos, gconstpointer data)
+{
+	return strcmp(cache->strings + cache->dirs[pos].path, (const gchar *) data);
+}
+
+static gint libcache_cmp_child(const struct libcache *cache, guint32 pos, gconstpointer data)
+{
+	guint32 parent = cache->dirs[cache->dir_children[pos]].parent;
+	guint32 dir = *(const guint32 *) data;
+
+	return parent == dir ? 0 : (parent < dir ? -1 : 1);
+}
+
+static gint libcache_cmp_song_dir(const struct libcache *cache, guint32 pos, gconstpointer data)
+{
+	guint32 song_dir = cache->songs[cache->by_dir[pos]].dir;
+	guint32 dir = *(const guint32 *) data;
+
+	return song_dir == dir ? 0 : (song_dir < dir ? -1 : 1);
+}
+
+static gint libcache_cmp_playlist_dir(const struct libcache *cache, guint32 pos, gconstpointer data)
+{
+	guint32 pl_dir = cache->playlists[pos].dir;
+	guint32 dir = *(const guint32 *) data;
+
+	return pl_dir == dir ? 0 : (pl_dir < dir ? -1 : 1);
+}
+
+static gint libcache_sort_names(gconstpointer a, gconstpointer b, gpointer data)
+{
+	const gchar *strings = (const gchar *) data;
+
+	return strcmp(strings + *(const guint32 *) a, strings + *(const guint32 *) b);
+}
+
+void libcache_list(const struct libcache *cache, enum libcache_key key, enum libcache_key filter, const gchar *value,
+		LibcacheNameFunc func, gpointer data)
+{
+	struct libcache_lookup lookup;
+	const struct libcache_entry *idx;
+	GHashTable *seen;
+	GArray *values;
+	GArray *names;
+	guint32 begin, end;
+	guint32 name;
+	guint32 prev = 0;
+	guint32 i, j, n;
+
+	if (filter == LIBCACHE_NONE) {
+		/* the index is sorted by the key, equal names are adjacent */
+		idx = libcache_index(cache, key, &n);
+		for (i = 0; i < n; i++) {
+			name = idx[i].value;
+			if (i == 0 || name != prev) {
+				func(cache->strings + name, data);
+			}
+			prev = name;
+		}
+		return;
+	}
+
+	lookup.key = filter;
+	lookup.value = value;
+	idx = libcache_index(cache, filter, &n);
+	libcache_equal_range(cache, n, libcache_cmp_key, &lookup, &begin, &end);
+
+	seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	values = g_array_new(FALSE, FALSE, sizeof(guint32));
+	names = g_array_new(FALSE, FALSE, sizeof(guint32));
+	for (i = begin; i < end; i++) {
+		g_array_set_size(values, 0);
+		libcache_song_values(cache->tags, &cache->songs[idx[i].song], key, values);
+		for (j = 0; j < values->len; j++) {
+			name = g_array_index(values, guint32, j);
+			if (!g_hash_table_contains(seen, GUINT_TO_POINTER(name + 1))) {
+				g_hash_table_add(seen, GUINT_TO_POINTER(name + 1));
+				g_array_append_val(names, name);
+			}
+		}
+	}
+	g_array_free(values, TRUE);
+	g_array_sort_with_data(names, libcache_sort_names, (gpointer) cache->strings);
+
+	for (i = 0; i < names->len; i++) {
+		func(cache->strings + g_array_index(names, guint32, i), data);
+	}
+
+	g_array_free(names, TRUE);
+	g_hash_table_destroy(seen);
+}
+
+void libcache_find(const struct libcache *cache, enum libcache_key key, const gchar *value,
+		LibcacheSongFunc func, gpointer data)
+{
+	struct libcache_lookup lookup;
+	const struct libcache_entry *idx;
+	guint32 begin, end;
+	guint32 i, n;
+
+	lookup.key = key;
+	lookup.value = value;
+	idx = libcache_index(cache, key, &n);
+	libcache_equal_range(cache, n, libcache_cmp_key, &lookup, &begin, &end);
+
+	for (i = begin; i < end; i++) {
+		func(cache, &cache->songs[idx[i].song], data);
+	}
+}
+
+gboolean libcache_lsinfo(const struct libcache *cache, const gchar *uri, LibcacheNameFunc dir_func,
+		LibcacheSongFunc song_func, LibcacheNameFunc pl_func, gpointer data)
+{
+	guint32 begin, end;
+	guint32 dir;
+	guint32 i;
+
+	libcache_equal_range(cache, cache->header->n_dirs, libcache_cmp_dir_path, uri ? uri : "", &begin, &end);
+	if (begin == end) {
+		return FALSE;
+	}
+	dir = begin;
+
+	libcache_equal_range(cache, cache->header->n_dirs - 1, libcache_cmp_child, &dir, &begin, &end);
+	for (i = begin; i < end; i++) {
+		dir_func(cache->strings + cache->dirs[cache->dir_children[i]].path, data);
+	}
+
+	libcache_equal_range(cache, cache->header->n_songs, libcache_cmp_song_dir, &dir, &begin, &end);
+	for (i = begin; i < end; i++) {
+		song_func(cache, &cache->songs[cache->by_dir[i]], data);
+	}
+
+	libcache_equal_range(cache, cache->header->n_playlists, libcache_cmp_playlist_dir, &dir, &begin, &end);
+	for (i = begin; i < end; i++) {
+		pl_func(cache->strings + cache->playlists[i].path, data);
+	}
+
+	return TRUE;
+}
+
+struct mpd_song *libcache_song_new(const struct libcache *cache, const struct libcache_song *song)
+{
+	struct mpd_song *retval;
+	struct mpd_pair pair;
+	guint32 i;
+
+	pair.name = "file";
+	pair.value = cache->strings + song->uri;
+	retval = mpd_song_begin(&pair);
+	if (!retval) {
+		return NULL;
+	}
+
+	for (i = song->tags; i < song->tags + song->n_tags; i++) {
+		pair.name = mpd_tag_name(cache->tags[i].type);
+		pair.value = cache->strings + cache->tags[i].value;
+		mpd_song_feed(retval, &pair);
+	}
+
+	if (song->time) {
+		pair.name = "Time";
+		pair.value = cache->strings + song->time;
+		mpd_song_feed(retval, &pair);
+	}
+	if (song->duration) {
+		pair.name = "duration";
+		pair.value = cache->strings + song->duration;
+		mpd_song_feed(retval, &pair);
+	}
+	if (song->mtime) {
+		pair.name = "Last-Modified";
+		pair.value = cache->strings + song->mtime;
+		mpd_song_feed(retval, &pair);
+	}
+
+	return retval;
+}
@@ -0,0 +1,237 @@
+#ifndef LIBCACHE_H
+#define LIBCACHE_H
+
+#include <glib.h>
+#include <mpd/client.h>
+
+/*
+ * Local copy of the MPD database built from lsinfo answers of all directories
+ * and stored in a file that is memory-mapped when used. All strings are stored once in a
+ * string table and referenced by offset, so two strings are equal exactly when
+ * their offsets are equal. Songs are reachable through index arrays sorted by
+ * genre, artist and album, which hold an entry for every value of the tag, and
+ * by directory.
+ */
+
+#define LIBCACHE_FILE_VERSION 2
+
+/**
+  Header of the cache file. Offsets are relative to the beginning of the file.
+  */
+struct libcache_header {
+	char magic[8];
+	guint64 db_update; /** Database update time reported by stats */
+	guint32 version; /** LIBCACHE_FILE_VERSION */
+	guint32 strings_len; /** Size of the string table */
+	guint32 n_dirs;
+	guint32 n_songs;
+	guint32 n_tags;
+	guint32 n_playlists;
+	guint32 n_by_genre;
+	guint32 n_by_artist;
+	guint32 n_by_album;
+	guint32 off_strings; /** String table */
+	guint32 off_dirs; /** Directories sorted by path */
+	guint32 off_dir_children; /** Directory indices sorted by parent and path */
+	guint32 off_songs; /** Songs in the order received from MPD */
+	guint32 off_tags; /** Tags of songs */
+	guint32 off_playlists; /** Playlists sorted by directory and path */
+	guint32 off_by_genre; /** Genre entries sorted by genre, artist, album */
+	guint32 off_by_artist; /** Artist entries sorted by artist, album */
+	guint32 off_by_album; /** Album entries sorted by album, artist */
+	guint32 off_by_dir; /** Song indices sorted by directory and URI */
+};
+
+struct libcache_dir {
+	guint32 path; /** Path without leading slash; root is an empty string */
+	guint32 parent; /** Index of the parent directory */
+	guint32 mtime; /** Last-Modified value */
+};
+
+struct libcache_song {
+	guint32 uri;
+	guint32 dir; /** Index of the directory containing the song */
+	guint32 genre; /** First genre, orders songs within an index */
+	guint32 artist; /** First album artist or first artist if there is no
+			  album artist, orders songs within an index */
+	guint32 album; /** First album, orders songs within an index */
+	guint32 time; /** Time value */
+	guint32 duration; /** duration value */
+	guint32 mtime; /** Last-Modified value */
+	guint32 tags; /** Index of the first tag of the song */
+	guint32 n_tags; /** Number of tags of the song */
+};
+
+struct libcache_tag {
+	guint32 type; /** enum mpd_tag_type */
+	guint32 value;
+};
+
+/**
+  Entry of an index array. A song has one entry for every value of the key and
+  one with an empty value if it has none.
+  */
+struct libcache_entry {
+	guint32 value;
+	guint32 song; /** Index of the song */
+};
+
+struct libcache_playlist {
+	guint32 path;
+	guint32 dir; /** Index of the directory containing the playlist */
+	guint32 mtime; /** Last-Modified value */
+};
+
+/**
+  Keys songs can be looked up by.
+  */
+enum libcache_key {
+	LIBCACHE_NONE,
+	LIBCACHE_GENRE,
+	LIBCACHE_ARTIST,
+	LIBCACHE_ALBUM
+};
+
+/**
+  Opened cache file.
+  */
+struct libcache {
+	GMappedFile *file;
+	const struct libcache_header *header;
+	const gchar *strings;
+	const struct libcache_dir *dirs;
+	const guint32 *dir_children;
+	const struct libcache_song *songs;
+	const struct libcache_tag *tags;
+	const struct libcache_playlist *playlists;
+	const struct libcache_entry *by_genre;
+	const struct libcache_entry *by_artist;
+	const struct libcache_entry *by_album;
+	const guint32 *by_dir;
+};
+
+/**
+  Cache file being built from pairs of lsinfo answers.
+  */
+struct libcache_builder {
+	GString *strings; /** String table */
+	GHashTable *interned; /** Maps strings to their offsets */
+	GArray *dirs; /** struct libcache_dir */
+	GArray *songs; /** struct libcache_song */
+	GArray *tags; /** struct libcache_tag */
+	GArray *playlists; /** struct libcache_playlist */
+	enum mpd_entity_type current; /** Type of the entity being received */
+	gboolean albumartist; /** TRUE if the current song has album artist */
+};
+
+typedef void (*LibcacheNameFunc)(const gchar *name, gpointer data);
+typedef void (*LibcacheSongFunc)(const struct libcache *cache, const struct libcache_song *song, gpointer data);
+
+/**
+  @brief Create an empty cache builder.
+  @returns Newly allocated builder that should be freed with @a
+  libcache_builder_free().
+  */
+struct libcache_builder *libcache_builder_new(void);
+
+/**
+  @brief Free cache builder.
+  @param builder Cache builder.
+  */
+void libcache_builder_free(struct libcache_builder *builder);
+
+/**
+  @brief Add a pair of lsinfo answer.
+  @param builder Cache builder.
+  @param pair Received pair.
+  @returns TRUE.
+  */
+gboolean libcache_builder_feed(struct libcache_builder *builder, const struct mpd_pair *pair);
+
+/**
+  @brief Sort received entities and write cache file.
+  @param builder Cache builder.
+  @param path Path of the file.
+  @param db_update Database update time the answer corresponds to.
+  @returns TRUE on success, FALSE otherwise.
+  */
+gboolean libcache_builder_write(struct libcache_builder *builder, const char *path, guint64 db_update);
+
+/**
+  @brief Map and validate a cache file.
+  @param path Path of the file.
+  @returns Opened cache that should be closed with @a libcache_close() or NULL
+  if the file doesn't exist or is invalid.
+  */
+struct libcache *libcache_open(const char *path);
+
+/**
+  @brief Unmap cache file.
+  @param cache Opened cache or NULL.
+  */
+void libcache_close(struct libcache *cache);
+
+/**
+  @brief Get database update time the cache corresponds to.
+  @param cache Opened cache.
+  @returns Database update time.
+  */
+guint64 libcache_db_update(const struct libcache *cache);
+
+/**
+  @brief Get string from the string table.
+  @param cache Opened cache.
+  @param offset Offset of the string.
+  @returns String owned by the cache.
+  */
+const gchar *libcache_str(const struct libcache *cache, guint32 offset);
+
+/**
+  @brief Call a function for every distinct value of a key in alphabetical
+  order, optionally only for songs with given value of another key. This is a
+  local equivalent of MPD's list command.
+  @param cache Opened cache.
+  @param key Listed key.
+  @param filter Filtering key or LIBCACHE_NONE.
+  @param value Value of filtering key.
+  @param func Function called for every value.
+  @param data User data passed to @a func.
+  */
+void libcache_list(const struct libcache *cache, enum libcache_key key, enum libcache_key filter, const gchar *value,
+		LibcacheNameFunc func, gpointer data);
+
+/**
+  @brief Call a function for every song with given value of a key. This is a
+  local equivalent of MPD's find command.
+  @param cache Opened cache.
+  @param key Key.
+  @param value Value of the key.
+  @param func Function called for every song.
+  @param data User data passed to @a func.
+  */
+void libcache_find(const struct libcache *cache, enum libcache_key key, const gchar *value,
+		LibcacheSongFunc func, gpointer data);
+
+/**
+  @brief Call functions for contents of a directory. This is a local
+  equivalent of MPD's lsinfo command.
+  @param cache Opened cache.
+  @param uri Path of the directory.
+  @param dir_func Function called with path of every subdirectory.
+  @param song_func Function called for every song.
+  @param pl_func Function called with path of every playlist.
+  @param data User data passed to the functions.
+  @returns FALSE if the directory doesn't exist.
+  */
+gboolean libcache_lsinfo(const struct libcache *cache, const gchar *uri, LibcacheNameFunc dir_func,
+		LibcacheSongFunc song_func, LibcacheNameFunc pl_func, gpointer data);
+
+/**
+  @brief Create libmpdclient song object from a cached song.
+  @param cache Opened cache.
+  @param song Cached song.
+  @returns Newly allocated song that should be freed with mpd_song_free().
+  */
+struct mpd_song *libcache_song_new(const struct libcache *cache, const struct libcache_song *song);
+
+#endif
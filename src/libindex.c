@@ -0,0 +1,479 @@
+#include <string.h>
+#include <glib.h>
+#include <mpd/client.h>
+
+#include "libindex.h"
+#include "util.h"
+
+typedef void (*LibIndexWordFunc)(const gchar *word, gpointer data);
+
+/**
+  Song field being indexed.
+  */
+struct lib_index_posting {
+	struct lib_index *index;
+	guint32 song;
+	enum lib_index_field field;
+};
+
+/**
+  @brief Split text into case folded words made of letters and digits and call
+  a function for every word.
+  */
+static void lib_index_split(GString *buf, const gchar *text, LibIndexWordFunc func, gpointer data)
+{
+	const gchar *p;
+	gunichar c;
+
+	g_string_truncate(buf, 0);
+
+	for (p = text; *p; p = g_utf8_next_char(p)) {
+		if (!(*p & 0x80)) {
+			/* ASCII needs no Unicode tables */
+			if (g_ascii_isalnum(*p)) {
+				g_string_append_c(buf, g_ascii_tolower(*p));
+				continue;
+			}
+		} else {
+			c = g_utf8_get_char(p);
+			if (g_unichar_isalnum(c)) {
+				g_string_append_unichar(buf, g_unichar_tolower(c));
+				continue;
+			}
+		}
+
+		if (buf->len > 0) {
+			func(buf->str, data);
+			g_string_truncate(buf, 0);
+		}
+	}
+
+	if (buf->len > 0) {
+		func(buf->str, data);
+		g_string_truncate(buf, 0);
+	}
+}
+
+static void lib_index_word_free(gpointer data)
+{
+	struct lib_index_word *word = (struct lib_index_word *) data;
+
+	g_array_free(word->postings, TRUE);
+	g_free(word);
+}
+
+static void lib_index_add(const gchar *str, gpointer data)
+{
+	struct lib_index_posting *posting = (struct lib_index_posting *) data;
+	struct lib_index_word *word;
+	guint32 *last;
+	guint32 val;
+
+	word = g_hash_table_lookup(posting->index->table, str);
+	if (!word) {
+		word = g_malloc(sizeof(struct lib_index_word));
+		word->word = g_string_chunk_insert(posting->index->chunk, str);
+		word->postings = g_array_new(FALSE, FALSE, sizeof(guint32));
+		g_hash_table_insert(posting->index->table, (gpointer) word->word, word);
+	}
+
+	/* songs are indexed in order, so a repeated word ends the list */
+	if (word->postings->len > 0) {
+		last = &g_array_index(word->postings, guint32, word->postings->len - 1);
+		if (*last >> LIB_INDEX_FIELD_BITS == posting->song) {
+			*last |= posting->field;
+			return;
+		}
+	}
+
+	val = posting->song << LIB_INDEX_FIELD_BITS | posting->field;
+	g_array_append_val(word->postings, val);
+}
+
+struct lib_index *lib_index_new(const struct libcache *cache)
+{
+	struct lib_index *index;
+
+	index = g_malloc(sizeof(struct lib_index));
+	index->cache = cache;
+	index->chunk = g_string_chunk_new(64 * 1024);
+	index->table = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, lib_index_word_free);
+	index->words = NULL;
+	index->next = 0;
+	index->built = FALSE;
+	index->buf = g_string_new(NULL);
+
+	return index;
+}
+
+void lib_index_free(struct lib_index *index)
+{
+	if (!index) {
+		return;
+	}
+
+	if (index->words) {
+		g_ptr_array_free(index->words, TRUE);
+	}
+	g_hash_table_destroy(index->table);
+	g_string_chunk_free(index->chunk);
+	g_string_free(index->buf, TRUE);
+	g_free(index);
+}
+
+static gint lib_index_word_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct lib_index_word *x = *(const struct lib_index_word * const *) a;
+	const struct lib_index_word *y = *(const struct lib_index_word * const *) b;
+
+	return strcmp(x->word, y->word);
+}
+
+gboolean lib_index_step(struct lib_index *index, guint n)
+{
+	const struct libcache *cache = index->cache;
+	const struct libcache_song *song;
+	const struct libcache_tag *tag;
+	struct lib_index_posting posting;
+	GHashTableIter iter;
+	gpointer word;
+	guint32 end;
+	guint32 i;
+
+	if (index->built) {
+		return TRUE;
+	}
+
+	posting.index = index;
+	end = MIN(cache->header->n_songs, index->next + n);
+
+	for (; index->next < end; index->next++) {
+		song = &cache->songs[index->next];
+		posting.song = index->next;
+
+		for (i = song->tags; i < song->tags + song->n_tags; i++) {
+			tag = &cache->tags[i];
+			switch (tag->type) {
+			case MPD_TAG_TITLE:
+				posting.field = LIB_INDEX_TITLE;
+				break;
+			case MPD_TAG_ARTIST:
+			case MPD_TAG_ALBUM_ARTIST:
+				posting.field = LIB_INDEX_ARTIST;
+				break;
+			case MPD_TAG_ALBUM:
+				posting.field = LIB_INDEX_ALBUM;
+				break;
+			case MPD_TAG_GENRE:
+				posting.field = LIB_INDEX_GENRE;
+				break;
+			default:
+				continue;
+			}
+			lib_index_split(index->buf, libcache_str(cache, tag->value), lib_index_add, &posting);
+		}
+
+		posting.field = LIB_INDEX_PATH;
+		lib_index_split(index->buf, libcache_str(cache, song->uri), lib_index_add, &posting);
+	}
+
+	if (index->next < cache->header->n_songs) {
+		return FALSE;
+	}
+
+	/* the table keeps owning the words */
+	index->words = g_ptr_array_sized_new(g_hash_table_size(index->table));
+	g_hash_table_iter_init(&iter, index->table);
+	while (g_hash_table_iter_next(&iter, NULL, &word)) {
+		g_ptr_array_add(index->words, word);
+	}
+	g_ptr_array_sort(index->words, lib_index_word_cmp);
+	index->built = TRUE;
+
+	MSG_INFO("library index with %u words built", index->words->len);
+
+	return TRUE;
+}
+
+/**
+  @brief Get relevance of a word occurrence.
+  */
+static guint32 lib_index_weight(guint32 fields, gboolean exact)
+{
+	guint32 weight = 0;
+
+	if (fields & LIB_INDEX_TITLE) {
+		weight += 8;
+	}
+	if (fields & LIB_INDEX_ARTIST) {
+		weight += 6;
+	}
+	if (fields & LIB_INDEX_ALBUM) {
+		weight += 4;
+	}
+	if (fields & LIB_INDEX_GENRE) {
+		weight += 2;
+	}
+	if (fields & LIB_INDEX_PATH) {
+		weight += 1;
+	}
+
+	/* whole words are better than prefixes */
+	return exact ? 2 * weight : weight;
+}
+
+static gint lib_index_hit_song_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct lib_index_hit *x = (const struct lib_index_hit *) a;
+	const struct lib_index_hit *y = (const struct lib_index_hit *) b;
+
+	return x->song == y->song ? 0 : (x->song < y->song ? -1 : 1);
+}
+
+static gint lib_index_hit_score_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct lib_index_hit *x = (const struct lib_index_hit *) a;
+	const struct lib_index_hit *y = (const struct lib_index_hit *) b;
+
+	if (x->score != y->score) {
+		return x->score > y->score ? -1 : 1;
+	}
+
+	return lib_index_hit_song_cmp(a, b);
+}
+
+/**
+  @brief Append occurrences of a word to an array of hits.
+  @param divisor Penalty of inexact matches, 1 for none.
+  */
+static void lib_index_append_word(GArray *hits, const struct lib_index_word *word, gboolean exact, guint32 divisor)
+{
+	struct lib_index_hit hit;
+	guint32 posting;
+	guint i;
+
+	for (i = 0; i < word->postings->len; i++) {
+		posting = g_array_index(word->postings, guint32, i);
+		hit.song = posting >> LIB_INDEX_FIELD_BITS;
+		hit.score = MAX(1, lib_index_weight(posting & ((1 << LIB_INDEX_FIELD_BITS) - 1), exact) / divisor);
+		g_array_append_val(hits, hit);
+	}
+}
+
+/**
+  @brief Get the number of typos tolerated in a query word.
+  */
+static guint lib_index_max_typos(gsize len)
+{
+	if (len < LIB_INDEX_FUZZY_MIN_LEN) {
+		return 0;
+	} else if (len < 2 * LIB_INDEX_FUZZY_MIN_LEN) {
+		return 1;
+	}
+
+	return 2;
+}
+
+/**
+  @brief Find words within a small edit distance of a query word or of its
+  prefixes. Uses Myers' bit-parallel algorithm with the top row of the
+  dynamic programming matrix counting up, so that the distance is measured
+  against the whole query and the score after every column is the distance
+  to the prefix of the word read so far. Words are compared byte by byte, so
+  a typo in a non-ASCII letter may count twice.
+  @param hits Array the occurrences of matching words are appended to.
+  */
+static void lib_index_fuzzy(const struct lib_index *index, const gchar *query, GArray *hits)
+{
+	const struct lib_index_word *word;
+	const guchar *p;
+	guint64 peq[256];
+	guint64 pv, mv, ph, mh, xv, xh, eq, last;
+	gsize m, n;
+	guint k;
+	guint score, best;
+	guint i;
+
+	m = strlen(query);
+	k = lib_index_max_typos(m);
+	if (k == 0 || m > 64) {
+		return;
+	}
+
+	memset(peq, 0, sizeof(peq));
+	for (i = 0; i < m; i++) {
+		peq[(guchar) query[i]] |= G_GUINT64_CONSTANT(1) << i;
+	}
+	last = G_GUINT64_CONSTANT(1) << (m - 1);
+
+	for (i = 0; i < index->words->len; i++) {
+		word = g_ptr_array_index(index->words, i);
+		p = (const guchar *) word->word;
+
+		pv = ~G_GUINT64_CONSTANT(0);
+		mv = 0;
+		score = best = m;
+		/* prefixes longer than m + k are more than k edits away */
+		for (n = 0; p[n] && n < m + k; n++) {
+			eq = peq[p[n]];
+			xv = eq | mv;
+			xh = (((eq & pv) + pv) ^ pv) | eq;
+			ph = mv | ~(xh | pv);
+			mh = pv & xh;
+			if (ph & last) {
+				score++;
+			} else if (mh & last) {
+				score--;
+			}
+			ph = (ph << 1) | 1;
+			mh <<= 1;
+			pv = mh | ~(xv | ph);
+			mv = ph & xv;
+			best = MIN(best, score);
+		}
+
+		if (best <= k) {
+			lib_index_append_word(hits, word, FALSE, 1 + best);
+		}
+	}
+}
+
+/**
+  @brief Find songs containing a word starting with given prefix or, when
+  there is no such word, a word similar to it. Prefixes shorter than
+  LIB_INDEX_PREFIX_MIN_LEN only find the word equal to them.
+  @returns Array of struct lib_index_hit sorted by song with the best score of
+  every song.
+  */
+static GArray *lib_index_lookup(const struct lib_index *index, const gchar *prefix)
+{
+	const struct lib_index_word *word;
+	struct lib_index_hit *out;
+	GArray *hits;
+	gsize len;
+	guint lo, hi, mid;
+	guint i, k;
+
+	len = strlen(prefix);
+
+	lo = 0;
+	hi = index->words->len;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		word = g_ptr_array_index(index->words, mid);
+		if (strcmp(word->word, prefix) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	hits = g_array_new(FALSE, FALSE, sizeof(struct lib_index_hit));
+	for (i = lo; i < index->words->len; i++) {
+		word = g_ptr_array_index(index->words, i);
+		if (strncmp(word->word, prefix, len)) {
+			break;
+		}
+		if (len < LIB_INDEX_PREFIX_MIN_LEN && word->word[len] != '\0') {
+			/* words are sorted, the equal one comes first */
+			break;
+		}
+		lib_index_append_word(hits, word, word->word[len] == '\0', 1);
+	}
+
+	if (hits->len == 0) {
+		/* probably misspelled */
+		lib_index_fuzzy(index, prefix, hits);
+	}
+
+	if (hits->len == 0) {
+		return hits;
+	}
+
+	/* merge occurrences of different words in the same song */
+	g_array_sort(hits, lib_index_hit_song_cmp);
+	out = (struct lib_index_hit *) hits->data;
+	for (i = 1, k = 0; i < hits->len; i++) {
+		if (out[i].song == out[k].song) {
+			out[k].score = MAX(out[k].score, out[i].score);
+		} else {
+			out[++k] = out[i];
+		}
+	}
+	g_array_set_size(hits, k + 1);
+
+	return hits;
+}
+
+/**
+  @brief Keep songs present in both arrays sorted by song and add up their
+  scores.
+  */
+static void lib_index_intersect(GArray *hits, const GArray *other)
+{
+	struct lib_index_hit *a = (struct lib_index_hit *) hits->data;
+	const struct lib_index_hit *b = (const struct lib_index_hit *) other->data;
+	guint i = 0, j = 0, k = 0;
+
+	while (i < hits->len && j < other->len) {
+		if (a[i].song < b[j].song) {
+			i++;
+		} else if (a[i].song > b[j].song) {
+			j++;
+		} else {
+			a[k].song = a[i].song;
+			a[k].score = a[i].score + b[j].score;
+			i++;
+			j++;
+			k++;
+		}
+	}
+
+	g_array_set_size(hits, k);
+}
+
+static void lib_index_query_word(const gchar *word, gpointer data)
+{
+	g_ptr_array_add((GPtrArray *) data, g_strdup(word));
+}
+
+GArray *lib_index_search(const struct lib_index *index, const gchar *query, guint max)
+{
+	GPtrArray *words;
+	GArray *hits = NULL;
+	GArray *other;
+	GString *buf;
+	guint i;
+
+	g_assert(index->built);
+
+	words = g_ptr_array_new_with_free_func(g_free);
+	buf = g_string_new(NULL);
+	lib_index_split(buf, query, lib_index_query_word, words);
+	g_string_free(buf, TRUE);
+
+	for (i = 0; i < words->len; i++) {
+		other = lib_index_lookup(index, g_ptr_array_index(words, i));
+		if (!hits) {
+			hits = other;
+		} else {
+			lib_index_intersect(hits, other);
+			g_array_free(other, TRUE);
+		}
+		if (hits->len == 0) {
+			break;
+		}
+	}
+	g_ptr_array_free(words, TRUE);
+
+	if (!hits) {
+		return g_array_new(FALSE, FALSE, sizeof(struct lib_index_hit));
+	}
+
+	g_array_sort(hits, lib_index_hit_score_cmp);
+	if (hits->len > max) {
+		g_array_set_size(hits, max);
+	}
+
+	return hits;
+}
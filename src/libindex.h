@@ -0,0 +1,102 @@
+#ifndef LIBINDEX_H
+#define LIBINDEX_H
+
+#include <glib.h>
+
+#include "libcache.h"
+
+/*
+ * Inverted index over words of song tags and paths in the local copy of the
+ * database. Every word maps to a posting list of songs it occurs in together
+ * with the fields it occurs in. Words are kept sorted, so a prefix query is a
+ * binary search followed by a walk over the matching words. Misspelled words
+ * are found by computing edit distance to every indexed word, which is cheap
+ * as every word is visited only once per query and the bit-parallel kernel
+ * stops after the length of the query.
+ */
+
+/**
+  Fields a word can occur in; posting entries keep them in low bits.
+  */
+enum lib_index_field {
+	LIB_INDEX_TITLE = 1 << 0,
+	LIB_INDEX_ARTIST = 1 << 1,
+	LIB_INDEX_ALBUM = 1 << 2,
+	LIB_INDEX_GENRE = 1 << 3,
+	LIB_INDEX_PATH = 1 << 4
+};
+
+#define LIB_INDEX_FIELD_BITS 5
+#define LIB_INDEX_FUZZY_MIN_LEN 4 /** Shorter query words must be spelled
+				    correctly */
+#define LIB_INDEX_PREFIX_MIN_LEN 3 /** Shorter query words match whole words
+				     only, their prefix would match most of
+				     the index */
+
+/**
+  Indexed word.
+  */
+struct lib_index_word {
+	const gchar *word; /** Case folded word */
+	GArray *postings; /** Song index shifted by LIB_INDEX_FIELD_BITS ored
+			    with enum lib_index_field mask (guint32), in song
+			    order */
+};
+
+/**
+  Search result.
+  */
+struct lib_index_hit {
+	guint32 song; /** Index of the song in the cache */
+	guint32 score; /** Relevance, higher is better */
+};
+
+struct lib_index {
+	const struct libcache *cache; /** Indexed cache */
+	GStringChunk *chunk; /** Storage of words */
+	GHashTable *table; /** Maps words to struct lib_index_word */
+	GPtrArray *words; /** struct lib_index_word sorted by word; valid when
+			    built */
+	guint32 next; /** Index of the next song to be indexed */
+	gboolean built; /** TRUE when all songs are indexed */
+	GString *buf; /** Buffer for words being extracted */
+};
+
+/**
+  @brief Create an empty index of a cache. Songs are indexed by @a
+  lib_index_step().
+  @param cache Opened cache that must stay open while the index exists.
+  @returns Newly allocated index that should be freed with @a
+  lib_index_free().
+  */
+struct lib_index *lib_index_new(const struct libcache *cache);
+
+/**
+  @brief Free index.
+  @param index Index or NULL.
+  */
+void lib_index_free(struct lib_index *index);
+
+/**
+  @brief Index next songs. Meant to be called repeatedly from an idle handler
+  so that building the index doesn't block the UI.
+  @param index Index being built.
+  @param n Number of songs to index.
+  @returns TRUE when the index is complete.
+  */
+gboolean lib_index_step(struct lib_index *index, guint n);
+
+/**
+  @brief Find songs containing all words of a query, each word as a prefix of
+  an indexed word. Query words shorter than LIB_INDEX_PREFIX_MIN_LEN must match
+  a whole word. Query words that don't start any indexed word are matched to
+  words with at most one or two typos instead.
+  @param index Built index.
+  @param query Query text.
+  @param max Maximum number of results.
+  @returns Newly allocated array of struct lib_index_hit with the most
+  relevant songs first.
+  */
+GArray *lib_index_search(const struct lib_index *index, const gchar *query, guint max);
+
+#endif
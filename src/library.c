@@ -12,6 +12,11 @@
 #include "gui.h"
 #include "settings.h"
 #include "gettext.h"
+#include "cellrenderer.h"
+#include "libcache.h"
+#include "profile.h"
+#include "listcache.h"
+#include "libindex.h"
 
 const char *listing_icons[] = {
 	[LIBRARY_PLAYLISTSONG] = "audio-x-generic",
@@ -64,27 +69,86 @@ gboolean library_tab_init(struct sonatina_tab *tab)
 	GObject *tw;
 	GObject *header;
 	GObject *selector;
+	GObject *search;
+	GObject *sw;
 	GObject *menu;
 	GtkTreeSelection *selection;
+	GtkTreeViewColumn *column;
+	GList *cells;
+	gchar *format;
 
 	libtab->ui = load_tab_ui(tab->name);
 	if (!libtab->ui) {
 		return FALSE;
 	}
 
+	libtab->mpdsource = NULL;
+	libtab->cache = NULL;
+	libtab->cache_valid = FALSE;
+	libtab->db_update = 0;
+	libtab->builder = NULL;
+	g_queue_init(&libtab->build_dirs);
+	libtab->build_serial = 0;
+	libtab->build_source = 0;
+	listing_cache_init(&libtab->listings, LIBRARY_LISTING_CACHE_SIZE);
+	libtab->revalidating = FALSE;
+	libtab->fingerprint = 0;
+	libtab->prefetch.cmd = MPD_CMD_NONE;
+	libtab->prefetch.args = NULL;
+	libtab->prefetch.key = NULL;
+	libtab->prefetch.open = FALSE;
+	libtab->prefetch_row = NULL;
+	libtab->prefetch_timer = 0;
+	libtab->prefetch_bytes = 0;
+	libtab->index = NULL;
+	libtab->index_source = 0;
+	libtab->searching = FALSE;
+	libtab->query = NULL;
+	libtab->search_timer = 0;
+	libtab->search_expr = NULL;
+	libtab->search_loaded = 0;
+	libtab->search_more = FALSE;
+	libtab->search_pending = FALSE;
+	tag_sort_init(&libtab->pending, 0);
+	libtab->windowed = FALSE;
+	libtab->windows = g_array_new(FALSE, TRUE, sizeof(gboolean));
+	libtab->counts = NULL;
+	libtab->counts_requested = FALSE;
+	g_queue_init(&libtab->count_keys);
 	libtab->root = NULL;
 	libtab->path = NULL;
 
+	format = sonatina_settings_get_string("library", "format");
+	libtab->format = song_format_compile(format);
+	g_free(format);
+	libtab->fmtbuf = g_string_new(NULL);
+
 	libtab->store = gtk_list_store_new(LIB_COL_COUNT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_ICON, G_TYPE_STRING, G_TYPE_INT);
 	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(libtab->store), LIB_COL_DISPLAY_NAME, GTK_SORT_ASCENDING);
 
 	tw = gtk_builder_get_object(libtab->ui, "tw");
 	library_tw_set_columns(GTK_TREE_VIEW(tw));
+	column = gtk_tree_view_get_column(GTK_TREE_VIEW(tw), 0);
+	cells = gtk_cell_layout_get_cells(GTK_CELL_LAYOUT(column));
+	gtk_tree_view_column_set_cell_data_func(column, cells->data, library_icon_data_func, libtab, NULL);
+	g_list_free(cells);
+	column = gtk_tree_view_get_column(GTK_TREE_VIEW(tw), 2);
+	cells = gtk_cell_layout_get_cells(GTK_CELL_LAYOUT(column));
+	gtk_tree_view_column_set_cell_data_func(column, cells->data, library_info_data_func, libtab, NULL);
+	g_list_free(cells);
 	gtk_tree_view_set_model(GTK_TREE_VIEW(tw), GTK_TREE_MODEL(libtab->store));
 	g_signal_connect(G_OBJECT(tw), "row-activated", G_CALLBACK(library_clicked_cb), libtab);
+	g_signal_connect(G_OBJECT(tw), "motion-notify-event", G_CALLBACK(library_motion_cb), libtab);
 
 	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(tw));
 	gtk_tree_selection_set_mode(selection, GTK_SELECTION_MULTIPLE);
+	sel_tracker_init(&libtab->selection, selection);
+	libtab->selected_actions = g_simple_action_group_new();
+	g_action_map_add_action_entries(G_ACTION_MAP(libtab->selected_actions), library_selected_actions, G_N_ELEMENTS(library_selected_actions), libtab);
+	libtab->selected_fs_actions = g_simple_action_group_new();
+	g_action_map_add_action_entries(G_ACTION_MAP(libtab->selected_fs_actions), library_selected_fs_actions, G_N_ELEMENTS(library_selected_fs_actions), libtab);
+	libtab->selected_pl_actions = g_simple_action_group_new();
+	g_action_map_add_action_entries(G_ACTION_MAP(libtab->selected_pl_actions), library_selected_pl_actions, G_N_ELEMENTS(library_selected_pl_actions), libtab);
 	g_signal_connect(G_OBJECT(selection), "changed", G_CALLBACK(library_selection_changed), libtab);
 
 	header = gtk_builder_get_object(libtab->ui, "header");
@@ -92,6 +156,14 @@ gboolean library_tab_init(struct sonatina_tab *tab)
 	g_signal_connect(G_OBJECT(libtab->pathbar), "changed", G_CALLBACK(library_pathbar_changed), libtab);
 	gtk_box_pack_start(GTK_BOX(header), GTK_WIDGET(libtab->pathbar), FALSE, FALSE, 0);
 
+	search = gtk_builder_get_object(libtab->ui, "search");
+	g_signal_connect(search, "search-changed", G_CALLBACK(library_search_changed), libtab);
+	sw = gtk_builder_get_object(libtab->ui, "sw");
+	g_signal_connect(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(sw)), "value-changed",
+			G_CALLBACK(library_search_scrolled), libtab);
+	g_signal_connect(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(sw)), "value-changed",
+			G_CALLBACK(library_window_scrolled), libtab);
+
 	selector = gtk_builder_get_object(libtab->ui, "selector");
 	gtk_menu_button_set_popup(GTK_MENU_BUTTON(selector), library_selector_menu(libtab));
 	library_set_listing(libtab, LIBRARY_ARTIST);
@@ -116,8 +188,15 @@ void library_tw_set_columns(GtkTreeView *tw)
 	column = gtk_tree_view_column_new_with_attributes("Icon", renderer, "gicon", LIB_COL_ICON, NULL);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tw), column);
 
-	renderer = gtk_cell_renderer_text_new();
+	renderer = sonatina_cell_renderer_text_new();
 	column = gtk_tree_view_column_new_with_attributes("Name", renderer, "text", LIB_COL_DISPLAY_NAME, NULL);
+	gtk_tree_view_column_set_expand(column, TRUE);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(tw), column);
+
+	/* filled by library_info_data_func() */
+	renderer = gtk_cell_renderer_text_new();
+	g_object_set(G_OBJECT(renderer), "xalign", 1.0, NULL);
+	column = gtk_tree_view_column_new_with_attributes("Info", renderer, NULL);
 	gtk_tree_view_append_column(GTK_TREE_VIEW(tw), column);
 }
 
@@ -125,8 +204,10 @@ void library_tab_set_source(struct sonatina_tab *tab, GSource *source)
 {
 	struct library_tab *libtab = (struct library_tab *) tab;
 	GObject *selector;
+	GObject *search;
 
 	selector = gtk_builder_get_object(libtab->ui, "selector");
+	search = gtk_builder_get_object(libtab->ui, "search");
 
 	libtab->mpdsource = source;
 	if (source) {
@@ -136,855 +217,2828 @@ void library_tab_set_source(struct sonatina_tab *tab, GSource *source)
 		mpd_source_register(source, MPD_CMD_LISTPLINFO, library_lsinfo_cb, tab);
 		mpd_source_register(source, MPD_CMD_LISTPLS, library_lsinfo_cb, tab);
 		mpd_source_register(source, MPD_CMD_IDLE, library_idle_cb, tab);
+		mpd_source_register(source, MPD_CMD_STATS, library_stats_cb, tab);
+		mpd_source_register(source, MPD_CMD_LSINFO_RAW, library_lsinfo_raw_cb, tab);
+		mpd_source_register(source, MPD_CMD_SEARCH, library_search_cb, tab);
+		mpd_source_register(source, MPD_CMD_COUNTSONGS, library_count_cb, tab);
+		mpd_source_register_error(source, library_error_cb, tab);
+		if (sonatina_settings_get_bool("library", "cache")) {
+			library_cache_open(libtab);
+		}
 		library_load(libtab);
 		gtk_widget_set_sensitive(GTK_WIDGET(selector), TRUE);
 		gtk_widget_set_sensitive(GTK_WIDGET(libtab->pathbar), TRUE);
+		gtk_widget_set_sensitive(GTK_WIDGET(search), TRUE);
 	} else {
 		gtk_widget_set_sensitive(GTK_WIDGET(selector), FALSE);
 		gtk_widget_set_sensitive(GTK_WIDGET(libtab->pathbar), FALSE);
+		gtk_widget_set_sensitive(GTK_WIDGET(search), FALSE);
 		gtk_list_store_clear(libtab->store);
+		if (libtab->searching) {
+			library_search_leave(libtab);
+		}
+		library_cache_close(libtab);
+		/* listings of the next server would be mixed with these */
+		listing_cache_clear(&libtab->listings);
+		library_prefetch_cancel(libtab);
+		/* requested counts are never answered */
+		g_queue_free_full(&libtab->count_keys, g_free);
+		g_queue_init(&libtab->count_keys);
 	}
 }
 
-void library_list_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+static gboolean library_is_tag_listing(enum listing_type type)
 {
-	struct library_tab *tab = (struct library_tab *) data;
-	GList *cur;
-	enum listing_type type;
-	GtkTreeIter iter;
-	const gchar *name;
+	return type == LIBRARY_GENRE || type == LIBRARY_ARTIST || type == LIBRARY_ALBUM;
+}
 
-	if (!args) {
-		MSG_WARNING("irrelevant list answer received");
-		return;
-	}
+/**
+  @brief Get TAG_SORT_* flags for a listing from the settings.
+  */
+static guint library_tag_sort_flags(enum listing_type type)
+{
+	guint flags = 0;
 
-	if (!g_strcmp0(args->data, "genre")) {
-		type = LIBRARY_GENRE;
-	} else if (!g_strcmp0(args->data, "artist") || !g_strcmp0(args->data, "albumartist")) {
-		type = LIBRARY_ARTIST;
-	} else if (!g_strcmp0(args->data, "album")) {
-		type = LIBRARY_ALBUM;
-	} else {
-		MSG_WARNING("invalid list answer received: %s", args->data);
-		type = LIBRARY_FS;
+	if (sonatina_settings_get_bool("library", "ignore_the")) {
+		flags |= TAG_SORT_IGNORE_THE;
 	}
-
-	gtk_list_store_clear(tab->store);
-
-	for (cur = answer->list.list; cur; cur = cur->next) {
-		switch (type) {
-		case LIBRARY_GENRE:
-			name = ((struct mpd_tag_entity *) cur->data)->genre;
-			break;
-		case LIBRARY_ARTIST:
-			name = ((struct mpd_tag_entity *) cur->data)->artist;
-			break;
-		case LIBRARY_ALBUM:
-			name = ((struct mpd_tag_entity *) cur->data)->album;
-			break;
-		default:
-			name = NULL;
-			break;
-		}
-		iter = library_model_append(tab->store, type, name, NULL, MPD_ENTITY_TYPE_UNKNOWN);
-		if (!g_strcmp0(tab->path->selected, name)) {
-			library_select(tab, &iter);
-		}
+	if (type == LIBRARY_ALBUM && sonatina_settings_get_bool("library", "albums_by_date")) {
+		flags |= TAG_SORT_BY_DATE;
 	}
 
-	library_tab_set_scroll(tab);
-	library_set_busy(tab, FALSE);
+	return flags;
 }
 
-void library_lsinfo_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+/**
+  @brief Clear the list before it is filled with a new listing.
+  */
+static void library_show_begin(struct library_tab *tab)
 {
-	struct library_tab *tab = (struct library_tab *) data;
-	const char *uri_arg;
-	gchar *uri;
-	GList *cur;
-	GtkTreeIter iter;
-
-	if (!tab->root) {
-		return;
+	if (tab->revalidating) {
+		/* keep the position the user scrolled to in the remembered listing */
+		library_tab_save_scroll(tab);
 	}
-
-	if (!tab->path) {
-		return;
+	gtk_list_store_clear(tab->store);
+	tab->windowed = FALSE;
+	tab->fingerprint = 0;
+	if (tab->counts) {
+		g_hash_table_unref(tab->counts);
+		tab->counts = NULL;
 	}
+	tab->counts_requested = FALSE;
 
-	if (tab->path->type == LIBRARY_FS) {
-		if (cmd != MPD_CMD_LSINFO) {
-			MSG_WARNING("irrelevant answer received for LIBRARY_FS list");
-			return;
-		}
-		uri_arg = g_list_nth_data(args, 0);
-		if (!uri_arg) {
-			uri_arg = "";
-		}
-        
-		uri = library_path_get_uri(tab->root, tab->path);
-        
-		MSG_DEBUG("received uri: %s; opened uri: %s", uri_arg, uri);
-		if (g_strcmp0(uri, uri_arg)) {
-			MSG_WARNING("irrelevant lsinfo answer received");
-			g_free(uri);
-			return;
-		}
-		g_free(uri);
-	} else if (tab->path->type == LIBRARY_SONG) {
-		if (cmd != MPD_CMD_FIND) {
-			MSG_WARNING("irrelevant answer received for LIBRARY_SONG list");
-			return;
-		}
-		if (g_strcmp0(g_list_nth_data(args, 1), tab->path->name)) {
-			MSG_WARNING("received answer for irrelevant album");
-			return;
-		}
-	} else if (tab->path->type == LIBRARY_PLAYLIST) {
-		if (cmd != MPD_CMD_LISTPLS) {
-			MSG_WARNING("irrelevant answer received while expecting listplaylists");
-			return;
-		}
-	} else if (tab->path->type == LIBRARY_PLAYLISTSONG) {
-		if (cmd != MPD_CMD_LISTPL && cmd != MPD_CMD_LISTPLINFO) {
-			MSG_WARNING("irrelevant answer received while expecting listplaylist");
-			return;
-		}
-		uri_arg = g_list_nth_data(args, 0);
-		uri = library_path_get_uri(tab->root, tab->path);
-		if (g_strcmp0(uri_arg, uri)) {
-			MSG_WARNING("irrelevant playlistinfo answer received");
-			g_free(uri);
-			return;
-		}
-		g_free(uri);
+	if (library_is_tag_listing(tab->path->type)) {
+		/* tags are sorted by library_show_end(), remembered ones already are */
+		gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(tab->store),
+				GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
+		tag_sort_clear(&tab->pending, library_tag_sort_flags(tab->path->type));
 	} else {
-		MSG_WARNING("irrelevant lsinfo answer received");
-		return;
-	}
-
-	gtk_list_store_clear(tab->store);
-	
-	for (cur = answer->lsinfo.list; cur; cur = cur->next) {
-		iter = library_model_append_entity(tab->store, cur->data);
-		if (!g_strcmp0(tab->path->selected, cur->data)) {
-			library_select(tab, &iter);
-		}
+		gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(tab->store), LIB_COL_DISPLAY_NAME, GTK_SORT_ASCENDING);
 	}
+}
 
-	library_tab_set_scroll(tab);
-	library_set_busy(tab, FALSE);
+/**
+  @brief Queue a genre, artist or album to be shown by @a library_show_end().
+  */
+static void library_show_tag(struct library_tab *tab, const gchar *name, const gchar *date)
+{
+	tag_sort_append(&tab->pending, name, date);
 }
 
-void library_idle_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+/**
+  @brief Append queued tags in sorted order and select the one that was
+  selected before.
+  */
+static void library_show_tags(struct library_tab *tab)
 {
-	struct library_tab *tab = (struct library_tab *) data;
+	const struct tag_sort_row *row;
+	GtkTreeIter iter;
+	guint i;
 
-	if (answer->idle & MPD_CHANGED_DB)
-	{
-		MSG_INFO("library changed");
-		library_load(tab);
+	tag_sort_run(&tab->pending);
+
+	for (i = 0; i < tab->pending.rows->len; i++) {
+		row = &g_array_index(tab->pending.rows, struct tag_sort_row, i);
+		iter = library_model_append(tab->store, tab->path->type, row->name, NULL, MPD_ENTITY_TYPE_UNKNOWN);
+		if (!g_strcmp0(tab->path->selected, row->name)) {
+			library_select(tab, &iter);
+		}
 	}
+
+	tag_sort_clear(&tab->pending, 0);
 }
 
-void library_pathbar_changed(SonatinaPathBar *pathbar, gint selected, gpointer data)
+/**
+  @brief Finish filling the list.
+  */
+static void library_show_end(struct library_tab *tab)
 {
-	MSG_DEBUG("pathbar changed");
-	library_tab_open_pos((struct library_tab *) data, selected);
+	if (library_is_tag_listing(tab->path->type)) {
+		library_show_tags(tab);
+	}
+	library_tab_set_scroll(tab);
+	library_set_busy(tab, FALSE);
+	tab->revalidating = FALSE;
 }
 
-void library_set_listing(struct library_tab *tab, enum listing_type listing)
+/**
+  @brief Get the tag an entity of a list answer was listed by.
+  */
+static const gchar *library_tag_entity_name(const struct mpd_tag_entity *entity, enum listing_type type)
 {
-	const char *title;
-
-	library_path_free_all(tab->root);
-
-	tab->root = library_path_root(listing);
-	tab->path = tab->root;
-
-	if (listing == LIBRARY_FS) {
-		title = _("Filesystem");
-	} else if (listing == LIBRARY_PLAYLIST) {
-		title = _("Playlists");
-	} else {
-		title = tab->root->name;
+	switch (type) {
+	case LIBRARY_GENRE:
+		return entity->genre;
+	case LIBRARY_ARTIST:
+		return entity->artist;
+	case LIBRARY_ALBUM:
+		return entity->album;
+	default:
+		return NULL;
 	}
-	sonatina_path_bar_open_root(tab->pathbar, title, listing_icons[listing]);
 }
 
-GtkTreeIter library_model_append_entity(GtkListStore *model, const struct mpd_entity *entity)
+/**
+  @brief Append a row described by an entity of lsinfo-like answer to a
+  listing cache entry. Mirrors @a library_model_append_entity().
+  */
+static void library_entry_append_entity(struct library_tab *tab, struct listing_entry *entry,
+		const struct mpd_entity *entity)
 {
-	const struct mpd_directory *dir;
 	const struct mpd_song *song;
-	const struct mpd_playlist *pl;
+	const char *uri;
 	gchar *name;
-	gchar *format;
-	const char *uri = NULL;
-	enum mpd_entity_type mpdtype;
-	enum listing_type type;
-	GtkTreeIter iter;
-
-	mpdtype = mpd_entity_get_type(entity);
 
-	switch (mpdtype) {
+	switch (mpd_entity_get_type(entity)) {
 	case MPD_ENTITY_TYPE_DIRECTORY:
-		type = LIBRARY_FS;
-		dir = mpd_entity_get_directory(entity);
-		uri = mpd_directory_get_path(dir);
+		uri = mpd_directory_get_path(mpd_entity_get_directory(entity));
 		name = g_path_get_basename(uri);
+		listing_entry_append(entry, name, uri, MPD_ENTITY_TYPE_DIRECTORY);
+		g_free(name);
 		break;
 	case MPD_ENTITY_TYPE_SONG:
-		type = LIBRARY_SONG;
 		song = mpd_entity_get_song(entity);
-		format = sonatina_settings_get_string("library", "format");
-		name = song_attr_format(format, song);
-		uri = mpd_song_get_uri(song);
-		MSG_DEBUG("library_model_append_entity(): format '%s', name '%s', uri: %s", format, name, uri);
-		g_free(format);
+		listing_entry_append(entry, song_format_run(tab->format, song, tab->fmtbuf),
+				mpd_song_get_uri(song), MPD_ENTITY_TYPE_SONG);
 		break;
 	case MPD_ENTITY_TYPE_PLAYLIST:
-		type = LIBRARY_PLAYLIST;
-		pl = mpd_entity_get_playlist(entity);
-		uri = mpd_playlist_get_path(pl);
+		uri = mpd_playlist_get_path(mpd_entity_get_playlist(entity));
 		name = g_path_get_basename(uri);
+		listing_entry_append(entry, name, uri, MPD_ENTITY_TYPE_PLAYLIST);
+		g_free(name);
 		break;
 	default:
-		type = LIBRARY_FS;
-		name = g_strdup(_("unknown"));
 		break;
 	}
+}
 
-	iter = library_model_append(model, type, name, uri, mpdtype);
-	g_free(name);
+/**
+  @brief Append tags of a list answer to a listing cache entry in the order
+  they are shown.
+  */
+static void library_entry_append_tags(struct listing_entry *entry, GList *list, enum listing_type type)
+{
+	const struct mpd_tag_entity *entity;
+	const struct tag_sort_row *row;
+	struct tag_sort sort;
+	GList *cur;
+	guint i;
 
-	return iter;
+	/* remembered tag listings are shown in the order they are stored */
+	tag_sort_init(&sort, library_tag_sort_flags(type));
+	for (cur = list; cur; cur = cur->next) {
+		entity = cur->data;
+		tag_sort_append(&sort, library_tag_entity_name(entity, type), entity->date);
+	}
+	tag_sort_run(&sort);
+	for (i = 0; i < sort.rows->len; i++) {
+		row = &g_array_index(sort.rows, struct tag_sort_row, i);
+		listing_entry_append(entry, row->name, NULL, MPD_ENTITY_TYPE_UNKNOWN);
+	}
+	tag_sort_free(&sort);
 }
 
-GtkTreeIter library_model_append(GtkListStore *model, enum listing_type type, const char *name, const char *uri, enum mpd_entity_type mpdtype)
+/**
+  @brief Get type of a row of the shown listing.
+  */
+static enum listing_type library_row_type(const struct library_tab *tab, gint mpdtype)
+{
+	switch (mpdtype) {
+	case MPD_ENTITY_TYPE_DIRECTORY:
+		return LIBRARY_FS;
+	case MPD_ENTITY_TYPE_SONG:
+		return LIBRARY_SONG;
+	case MPD_ENTITY_TYPE_PLAYLIST:
+		return LIBRARY_PLAYLIST;
+	default:
+		/* genre, artist or album list */
+		return tab->path->type;
+	}
+}
+
+/**
+  @brief Bring the shown list in line with a fresh listing by removing,
+  updating and inserting only rows that differ. Rows are identified by URI or,
+  in tag listings, by name.
+  */
+static void library_listing_patch(struct library_tab *tab, const struct listing_entry *entry)
 {
+	GtkTreeModel *model = GTK_TREE_MODEL(tab->store);
+	const struct listing_row *row;
+	GHashTable *fresh;
 	GtkTreeIter iter;
-	GIcon *icon;
-	const char *display;
+	gboolean valid;
+	gpointer index;
+	gchar *display;
+	gchar *name;
+	gchar *uri;
+	gint mpdtype;
+	gboolean *seen;
+	guint removed = 0, updated = 0, inserted = 0;
+	guint i;
+
+	fresh = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i = 0; i < entry->rows->len; i++) {
+		row = &g_array_index(entry->rows, struct listing_row, i);
+		g_hash_table_insert(fresh, row->uri ? row->uri : row->name ? row->name : "", GUINT_TO_POINTER(i + 1));
+	}
+	seen = g_malloc0(entry->rows->len * sizeof(gboolean));
+
+	valid = gtk_tree_model_get_iter_first(model, &iter);
+	while (valid) {
+		gtk_tree_model_get(model, &iter,
+				LIB_COL_DISPLAY_NAME, &display,
+				LIB_COL_NAME, &name,
+				LIB_COL_URI, &uri,
+				LIB_COL_TYPE, &mpdtype, -1);
+		/* name is only set when it differs from the displayed one */
+		if (!name) {
+			name = display;
+			display = NULL;
+		}
 
-	if (!name || strlen(name) == 0) {
-		switch (type) {
-		case LIBRARY_GENRE:
-			display = _("Unknown genre");
-			break;
-		case LIBRARY_ARTIST:
-			display = _("Unknown artist");
-			break;
-		case LIBRARY_ALBUM:
-			display = _("Unknown album");
-			break;
-		default:
-			display = _("Unknown");
-			break;
+		index = g_hash_table_lookup(fresh, uri ? uri : name);
+		if (!index || seen[GPOINTER_TO_UINT(index) - 1]) {
+			valid = gtk_list_store_remove(tab->store, &iter);
+			removed++;
+		} else {
+			i = GPOINTER_TO_UINT(index) - 1;
+			seen[i] = TRUE;
+			row = &g_array_index(entry->rows, struct listing_row, i);
+			if (g_strcmp0(row->name, name) || row->mpdtype != mpdtype) {
+				library_model_set(tab->store, &iter, library_row_type(tab, row->mpdtype),
+						row->name, row->uri, row->mpdtype);
+				updated++;
+			}
+			valid = gtk_tree_model_iter_next(model, &iter);
 		}
-	} else {
-		display = name;
-		name = NULL;
+
+		g_free(display);
+		g_free(name);
+		g_free(uri);
 	}
 
-	icon = g_icon_new_for_string(listing_icons[type], NULL);
-	gtk_list_store_append(model, &iter);
-	gtk_list_store_set(model, &iter,
-			LIB_COL_ICON, icon,
-			LIB_COL_DISPLAY_NAME, display,
-			LIB_COL_NAME, name,
-			LIB_COL_URI, uri,
-			LIB_COL_TYPE, mpdtype, -1);
-	g_object_unref(icon);
+	/* kept rows are in order, new ones go between them (sorted stores sort them anyway) */
+	for (i = 0; i < entry->rows->len; i++) {
+		if (seen[i]) {
+			continue;
+		}
+		row = &g_array_index(entry->rows, struct listing_row, i);
+		gtk_list_store_insert(tab->store, &iter, i);
+		library_model_set(tab->store, &iter, library_row_type(tab, row->mpdtype), row->name, row->uri, row->mpdtype);
+		inserted++;
+	}
 
-	return iter;
+	MSG_DEBUG("listing patched: %u rows removed, %u updated, %u inserted", removed, updated, inserted);
+	g_free(seen);
+	g_hash_table_destroy(fresh);
 }
 
-void library_tab_destroy(struct sonatina_tab *tab)
+/**
+  @brief Finish revalidation of the shown listing with a fresh listing.
+  @param entry Fresh listing; it's remembered in place of the stale one.
+  */
+static void library_listing_revalidated(struct library_tab *tab, struct listing_entry *entry)
 {
-	struct library_tab *libtab = (struct library_tab *) tab;
-	struct library_path *path;
+	if (entry->fingerprint == tab->fingerprint) {
+		MSG_DEBUG("shown listing didn't change");
+	} else {
+		library_listing_patch(tab, entry);
+		tab->fingerprint = entry->fingerprint;
+	}
 
-	gtk_widget_destroy(tab->widget);
+	tab->revalidating = FALSE;
+	listing_cache_insert(&tab->listings, entry);
+	library_set_busy(tab, FALSE);
+}
 
-	g_object_unref(libtab->ui);
-	g_object_unref(libtab->store);
-	g_object_unref(libtab->pathbar);
+/**
+  @brief Check whether a command is the pending prefetch.
+  */
+static gboolean library_prefetch_matches(const struct library_tab *tab, enum mpd_cmd_type cmd, GList *args)
+{
+	GList *a, *b;
 
-	for (path = libtab->root; path; path = path->next) {
-		library_path_free(path);
+	if (tab->prefetch.cmd == MPD_CMD_NONE || tab->prefetch.cmd != cmd) {
+		return FALSE;
+	}
+
+	for (a = tab->prefetch.args, b = args; a && b; a = a->next, b = b->next) {
+		if (g_strcmp0(a->data, b->data)) {
+			return FALSE;
+		}
 	}
+
+	return !a && !b;
 }
 
-struct library_path *library_path_root(enum listing_type listing)
+static void library_prefetch_clear(struct library_tab *tab)
 {
-	struct library_path *path;
+	tab->prefetch.cmd = MPD_CMD_NONE;
+	g_list_free_full(tab->prefetch.args, g_free);
+	tab->prefetch.args = NULL;
+	g_free(tab->prefetch.key);
+	tab->prefetch.key = NULL;
+	tab->prefetch.open = FALSE;
+}
 
-	path = g_malloc(sizeof(struct library_path));
+/**
+  @brief Remember an answer to the pending prefetch.
+  @returns TRUE if the answer belongs to the prefetch and shouldn't be shown,
+  FALSE if it should be handled as usual.
+  */
+static gboolean library_prefetch_answer(struct library_tab *tab, enum mpd_cmd_type cmd, GList *args,
+		union mpd_cmd_answer *answer)
+{
+	struct listing_entry *entry;
+	GList *cur;
 
-	path->type = listing;
-	path->parent = NULL;
-	path->next = NULL;
-	path->name = NULL;
-	path->selected = NULL;
-	path->pos = NULL;
-
-	switch (listing) {
-	case LIBRARY_FS:
-		path->name = g_strdup("");
-		break;
-	case LIBRARY_PLAYLIST:
-		path->name = g_strdup(_("Playlists"));
-		break;
-	case LIBRARY_GENRE:
-		path->name = g_strdup(_("Genre"));
-		break;
-	case LIBRARY_ARTIST:
-		path->name = g_strdup(_("Artist"));
-		break;
-	case LIBRARY_ALBUM:
-		path->name = g_strdup(_("Album"));
-		break;
-	default:
-		break;
+	if (!library_prefetch_matches(tab, cmd, args)) {
+		return FALSE;
 	}
 
-	return path;
-}
-
-void library_path_free(struct library_path *path)
-{
-	if (!path) {
-		return;
+	if (tab->prefetch.open) {
+		/* the user is waiting for it, it's shown and remembered as usual */
+		library_prefetch_clear(tab);
+		return FALSE;
 	}
 
-	if (path->name) {
-		g_free(path->name);
+	if (cmd == MPD_CMD_FIND && g_list_length(answer->lsinfo.list) == LIBRARY_LISTING_WINDOW) {
+		/* only the first window, it's loaded when it's opened */
+		MSG_DEBUG("prefetched listing is too long to be remembered");
+		library_prefetch_clear(tab);
+		return TRUE;
 	}
 
-	if (path->selected) {
-		g_free(path->selected);
+	entry = listing_entry_new(tab->prefetch.key);
+	if (cmd == MPD_CMD_LIST) {
+		library_entry_append_tags(entry, answer->list.list, tab->prefetch.type);
+	} else {
+		for (cur = answer->lsinfo.list; cur; cur = cur->next) {
+			library_entry_append_entity(tab, entry, cur->data);
+		}
 	}
+	MSG_DEBUG("prefetched %u rows", entry->rows->len);
+	tab->prefetch_bytes += entry->size;
+	listing_cache_insert(&tab->listings, entry);
 
-	g_free(path);
+	library_prefetch_clear(tab);
+
+	return TRUE;
 }
 
-void library_path_free_all(struct library_path *root)
+static void library_tag_sort_destroy(gpointer data)
 {
-	struct library_path *path;
+	tag_sort_free((struct tag_sort *) data);
+	g_free(data);
+}
 
-	if (!root) {
+/**
+  @brief Remember album listings of all artists from a list answer grouped by
+  album artist and show the artist listing. Opening an artist is then answered
+  from the listing cache.
+  */
+static void library_list_tree(struct library_tab *tab, GList *list)
+{
+	const struct tag_sort_row *row;
+	const struct mpd_tag_entity *entity;
+	struct listing_entry *entry;
+	struct library_path child;
+	struct tag_sort *sort;
+	GHashTable *albums;
+	GHashTableIter iter;
+	gpointer artist;
+	GList *cur;
+	gchar *key;
+	guint i;
+
+	if (!tab->root || tab->root->type != LIBRARY_ARTIST) {
+		/* listing was switched in the meantime */
 		return;
 	}
 
-	for (path = root->next; path; path = path->next) {
-		library_path_free(path->parent);
+	albums = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, library_tag_sort_destroy);
+	for (cur = list; cur; cur = cur->next) {
+		entity = cur->data;
+		artist = entity->artist ? entity->artist : "";
+		sort = g_hash_table_lookup(albums, artist);
+		if (!sort) {
+			sort = g_malloc(sizeof(struct tag_sort));
+			tag_sort_init(sort, library_tag_sort_flags(LIBRARY_ALBUM));
+			g_hash_table_insert(albums, g_strdup(artist), sort);
+		}
+		tag_sort_append(sort, entity->album, entity->date);
+	}
+	MSG_DEBUG("albums of %u artists received", g_hash_table_size(albums));
+
+	/* only the fields used by library_listing_key() */
+	child.type = LIBRARY_ALBUM;
+	child.parent = tab->root;
+
+	g_hash_table_iter_init(&iter, albums);
+	while (g_hash_table_iter_next(&iter, &artist, (gpointer *) &sort)) {
+		child.name = artist;
+		key = library_listing_key(&child);
+		entry = listing_entry_new(key);
+		g_free(key);
+
+		tag_sort_run(sort);
+		for (i = 0; i < sort->rows->len; i++) {
+			row = &g_array_index(sort->rows, struct tag_sort_row, i);
+			listing_entry_append(entry, row->name, NULL, MPD_ENTITY_TYPE_UNKNOWN);
+		}
+		listing_cache_insert(&tab->listings, entry);
+	}
+
+	if (tab->path == tab->root) {
+		library_show_begin(tab);
+		g_hash_table_iter_init(&iter, albums);
+		while (g_hash_table_iter_next(&iter, &artist, NULL)) {
+			library_show_tag(tab, artist, NULL);
+		}
+		library_show_end(tab);
+		library_listing_remember(tab);
 	}
+
+	g_hash_table_destroy(albums);
 }
 
-gboolean library_load(struct library_tab *tab)
+/**
+  @brief Get MPD command that lists contents of a path node.
+  @param path Path node.
+  @param uri URI of the node for filesystem and playlist listings.
+  @param args Filled with NULL terminated list of at most
+  LIBRARY_LISTING_MAX_ARGS arguments.
+  @returns Command type or MPD_CMD_NONE if the node can't be listed.
+  */
+static enum mpd_cmd_type library_listing_command(const struct library_path *path, const gchar *uri, const gchar **args)
 {
-	gchar *uri;
-	gboolean retval = FALSE;
-
-	library_set_busy(tab, TRUE);
+	enum mpd_cmd_type cmd;
+	gint n = 0;
 
-	switch (tab->path->type) {
+	switch (path->type) {
 	case LIBRARY_FS:
-		uri = library_path_get_uri(tab->root, tab->path);
-		MSG_DEBUG("sending lsinfo %s", uri);
-		retval = mpd_send(tab->mpdsource, MPD_CMD_LSINFO, uri, NULL);
-		g_free(uri);
+		cmd = MPD_CMD_LSINFO;
+		args[n++] = uri;
 		break;
 	case LIBRARY_PLAYLIST:
-		MSG_INFO("opening stored playlists list");
-		retval = mpd_send(tab->mpdsource, MPD_CMD_LISTPLS, NULL);
+		cmd = MPD_CMD_LISTPLS;
 		break;
 	case LIBRARY_PLAYLISTSONG:
-		uri = library_path_get_uri(tab->root, tab->path);
-		MSG_INFO("opening playlist '%s'", uri);
-		retval = mpd_send(tab->mpdsource, MPD_CMD_LISTPLINFO, uri, NULL);
-		g_free(uri);
+		cmd = MPD_CMD_LISTPLINFO;
+		args[n++] = uri;
 		break;
 	case LIBRARY_GENRE:
-		MSG_INFO("opening genre list");
-		retval = mpd_send(tab->mpdsource, MPD_CMD_LIST, "genre", NULL);
+		cmd = MPD_CMD_LIST;
+		args[n++] = "genre";
 		break;
 	case LIBRARY_ARTIST:
-		MSG_INFO("opening artist list");
-		if (tab->path->parent && tab->path->parent->type == LIBRARY_GENRE) {
-			retval = mpd_send(tab->mpdsource, MPD_CMD_LIST, "albumartist",
-					"genre", tab->path->name, NULL);
-		} else {
-			retval = mpd_send(tab->mpdsource, MPD_CMD_LIST, "albumartist", NULL);
+		cmd = MPD_CMD_LIST;
+		if (!path->parent && sonatina_settings_get_bool("library", "album_tree")) {
+			/* albums of every artist, see library_list_tree() */
+			args[n++] = "album";
+			args[n++] = "group";
+			args[n++] = "albumartist";
+			if (library_tag_sort_flags(LIBRARY_ALBUM) & TAG_SORT_BY_DATE) {
+				args[n++] = "group";
+				args[n++] = "date";
+			}
+			break;
+		}
+		args[n++] = "albumartist";
+		if (path->parent && path->parent->type == LIBRARY_GENRE) {
+			args[n++] = "genre";
+			args[n++] = path->name;
 		}
 		break;
 	case LIBRARY_ALBUM:
-		MSG_INFO("opening album list");
-		if (tab->path->parent && tab->path->parent->type == LIBRARY_ARTIST) {
-			if (tab->path->parent && tab->path->parent->type == LIBRARY_GENRE) {
-				retval = mpd_send(tab->mpdsource, MPD_CMD_LIST, "album",
-						"albumartist", tab->path->name,
-						"genre", tab->path->parent->name, NULL);
-			} else {
-				MSG_DEBUG("listing albums for artist %s", tab->path->name);
-				retval = mpd_send(tab->mpdsource, MPD_CMD_LIST, "album",
-						"albumartist", tab->path->name, NULL);
-			}
-		} else {
-			retval = mpd_send(tab->mpdsource, MPD_CMD_LIST, "album", NULL);
+		cmd = MPD_CMD_LIST;
+		args[n++] = "album";
+		if (path->parent && path->parent->type == LIBRARY_ARTIST) {
+			args[n++] = "albumartist";
+			args[n++] = path->name;
+		}
+		if (library_tag_sort_flags(LIBRARY_ALBUM) & TAG_SORT_BY_DATE) {
+			args[n++] = "group";
+			args[n++] = "date";
 		}
 		break;
 	case LIBRARY_SONG:
-		MSG_INFO("opening song list");
-		retval = mpd_send(tab->mpdsource, MPD_CMD_FIND, "album", tab->path->name, NULL);
+		cmd = MPD_CMD_FIND;
+		args[n++] = "album";
+		args[n++] = path->name;
+		/* long listings are loaded as they are scrolled */
+		args[n++] = "window";
+		args[n++] = "0:" G_STRINGIFY(LIBRARY_LISTING_WINDOW);
 		break;
 	default:
-		retval = FALSE;
+		cmd = MPD_CMD_NONE;
 		break;
 	}
+	args[n] = NULL;
 
-	return retval;
+	return cmd;
 }
 
-gboolean library_add(struct library_tab *tab, GtkTreeIter iter)
+/**
+  @brief Check whether a list answer belongs to the shown path.
+  @param args Arguments of the list command.
+  */
+static gboolean library_list_matches(const struct library_tab *tab, GList *args)
 {
-	gchar *display_name;
-	gchar *name;
-	gchar *uri;
-	enum mpd_entity_type type;
-	gboolean retval = FALSE;
-
-	gtk_tree_model_get(GTK_TREE_MODEL(tab->store), &iter,
-			LIB_COL_DISPLAY_NAME, &display_name,
-			LIB_COL_NAME, &name,
-			LIB_COL_URI, &uri,
-			LIB_COL_TYPE, &type, -1);
+	const gchar *expected[LIBRARY_LISTING_MAX_ARGS + 1];
+	gint i;
 
-	if (!name) {
-		name = display_name;
-		display_name = NULL;
+	if (!tab->path || library_listing_command(tab->path, NULL, expected) != MPD_CMD_LIST) {
+		return FALSE;
 	}
 
-	switch (tab->path->type) {
-	case LIBRARY_FS:
-		MSG_DEBUG("sending add %s", uri);
-		if (type == MPD_ENTITY_TYPE_PLAYLIST) {
-			retval = mpd_send(tab->mpdsource, MPD_CMD_LOAD, uri, NULL);
-		} else {
-			retval = mpd_send(tab->mpdsource, MPD_CMD_ADD, uri, NULL);
-		}
-		break;
-	case LIBRARY_PLAYLIST:
-		MSG_INFO("adding playlist %s", name);
-		retval = mpd_send(tab->mpdsource, MPD_CMD_LOAD, name, NULL);
-		break;
-	case LIBRARY_GENRE:
-		MSG_INFO("adding genre %s", name);
-		retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "genre", name, NULL);
-		break;
-	case LIBRARY_ARTIST:
-		MSG_INFO("adding artist %s", name);
-		if (tab->path->parent && tab->path->parent->type == LIBRARY_GENRE) {
-			retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "albumartist", name,
-					"genre", tab->path->name, NULL);
-		} else {
-			retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "albumartist", name, NULL);
-		}
-		break;
-	case LIBRARY_ALBUM:
-		MSG_INFO("adding album %s", name);
-		if (tab->path->parent && tab->path->parent->type == LIBRARY_ARTIST) {
-			if (tab->path->parent && tab->path->parent->type == LIBRARY_GENRE) {
-				retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "album", name,
-						"albumartist", tab->path->name,
-						"genre", tab->path->parent->name, NULL);
-			} else {
-				MSG_DEBUG("adding album %s from artist %s", name, tab->path->name);
-				retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "album", name,
-						"albumartist", tab->path->name, NULL);
-			}
-		} else {
-			retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "album", name, NULL);
+	for (i = 0; expected[i]; i++, args = args->next) {
+		if (!args || g_strcmp0(args->data, expected[i])) {
+			return FALSE;
 		}
-		break;
-	case LIBRARY_SONG:
-	case LIBRARY_PLAYLISTSONG:
-		MSG_INFO("adding song %s", name);
-		retval = mpd_send(tab->mpdsource, MPD_CMD_ADD, uri, NULL);
-		break;
-	default:
-		retval = FALSE;
-		break;
 	}
 
-	g_free(name);
-	g_free(display_name);
-	g_free(uri);
-
-	return retval;
+	return args == NULL;
 }
 
-void library_tab_save_scroll(struct library_tab *tab)
+void library_list_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
 {
-	GObject *tw;
+	struct library_tab *tab = (struct library_tab *) data;
+	const struct mpd_tag_entity *entity;
+	struct listing_entry *entry;
+	GList *cur;
+	gchar *key;
+	enum listing_type type;
 
-	g_assert(tab != NULL);
-	g_assert(tab->path != NULL);
+	if (library_prefetch_answer(tab, cmd, args, answer) || tab->searching) {
+		return;
+	}
 
-	tw = gtk_builder_get_object(tab->ui, "tw");
+	if (!library_list_matches(tab, args)) {
+		/* e.g. answer to a listing the user already left */
+		MSG_WARNING("irrelevant list answer received");
+		return;
+	}
 
-	if (tab->path->pos) {
-		gtk_tree_path_free(tab->path->pos);
+	if (!g_strcmp0(g_list_nth_data(args, 1), "group") && !g_strcmp0(g_list_nth_data(args, 2), "albumartist")) {
+		library_list_tree(tab, answer->list.list);
+		return;
 	}
-	gtk_tree_view_get_visible_range(GTK_TREE_VIEW(tw), &tab->path->pos, NULL);
+
+	if (!g_strcmp0(args->data, "genre")) {
+		type = LIBRARY_GENRE;
+	} else if (!g_strcmp0(args->data, "artist") || !g_strcmp0(args->data, "albumartist")) {
+		type = LIBRARY_ARTIST;
+	} else if (!g_strcmp0(args->data, "album")) {
+		type = LIBRARY_ALBUM;
+	} else {
+		MSG_WARNING("invalid list answer received: %s", args->data);
+		type = LIBRARY_FS;
+	}
+
+	if (tab->revalidating && tab->fingerprint) {
+		key = library_listing_key(tab->path);
+		entry = listing_entry_new(key);
+		g_free(key);
+		library_entry_append_tags(entry, answer->list.list, type);
+		library_listing_revalidated(tab, entry);
+		return;
+	}
+
+	library_show_begin(tab);
+
+	for (cur = answer->list.list; cur; cur = cur->next) {
+		entity = cur->data;
+		library_show_tag(tab, library_tag_entity_name(entity, type), entity->date);
+	}
+
+	library_show_end(tab);
+	library_listing_remember(tab);
 }
 
-void library_tab_set_scroll(struct library_tab *tab)
+/**
+  @brief Request a window of the opened song listing.
+  @param tab Library tab.
+  @param n Index of the window.
+  */
+static void library_window_request(struct library_tab *tab, guint n)
 {
-	GObject *tw;
+	gchar window[32];
 
-	g_assert(tab != NULL);
-	g_assert(tab->path != NULL);
+	g_array_index(tab->windows, gboolean, n) = TRUE;
+	g_snprintf(window, sizeof(window), "%u:%u", n * LIBRARY_LISTING_WINDOW, (n + 1) * LIBRARY_LISTING_WINDOW);
+	MSG_DEBUG("requesting songs %s of %s", window, tab->path->name);
+	mpd_send(tab->mpdsource, MPD_CMD_FIND, "album", tab->path->name, "window", window, NULL);
+}
 
-	if (!tab->path->pos) {
+/**
+  @brief Request windows of the rows that are visible or a page away.
+  */
+static void library_window_request_visible(struct library_tab *tab)
+{
+	GtkTreePath *start;
+	GtkTreePath *end;
+	GObject *tw;
+	guint first, last, page, n;
+
+	if (!tab->windowed || tab->searching) {
 		return;
 	}
 
 	tw = gtk_builder_get_object(tab->ui, "tw");
-	gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(tw), tab->path->pos, NULL, TRUE, 0.0, 0.0);
+	if (!gtk_tree_view_get_visible_range(GTK_TREE_VIEW(tw), &start, &end)) {
+		return;
+	}
+	first = gtk_tree_path_get_indices(start)[0];
+	last = gtk_tree_path_get_indices(end)[0];
+	gtk_tree_path_free(start);
+	gtk_tree_path_free(end);
+
+	/* load the neighbouring pages before they are scrolled to */
+	page = last - first + 1;
+	first = first > page ? first - page : 0;
+	last += page;
+
+	for (n = first / LIBRARY_LISTING_WINDOW; n <= last / LIBRARY_LISTING_WINDOW && n < tab->windows->len; n++) {
+		if (!g_array_index(tab->windows, gboolean, n)) {
+			library_window_request(tab, n);
+		}
+	}
 }
 
-void library_tab_open_dir(struct library_tab *tab, GtkTreeIter iter)
+/**
+  @brief Show the first window of a song listing that is too long to be loaded
+  at once. The rest is counted and shown as placeholders. Unlike short song
+  listings, which are sorted by display name, windowed ones keep the order of
+  the database as windows can only be placed by their position in it.
+  */
+static void library_window_begin(struct library_tab *tab, GList *list)
 {
-	struct library_path *path;
-	const char *icon;
-	gchar *name;
-	gchar *display_name;
-	enum mpd_entity_type type;
+	gboolean requested = TRUE;
+	GList *cur;
 
-	library_tab_save_scroll(tab);
+	library_show_begin(tab);
+	/* rows are kept in the order of windows */
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(tab->store),
+			GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
 
-	gtk_tree_model_get(GTK_TREE_MODEL(tab->store), &iter,
-			LIB_COL_NAME, &name,
-			LIB_COL_DISPLAY_NAME, &display_name,
-			LIB_COL_TYPE, &type, -1);
+	for (cur = list; cur; cur = cur->next) {
+		library_model_append_entity(tab, cur->data);
+	}
 
-	if (!name) {
-		name = g_strdup(display_name);
+	tab->windowed = TRUE;
+	g_array_set_size(tab->windows, 0);
+	g_array_append_val(tab->windows, requested);
+	mpd_send(tab->mpdsource, MPD_CMD_COUNTSONGS, "album", tab->path->name, NULL);
+
+	/* not remembered, the listing cache holds whole listings */
+	library_show_end(tab);
+}
+
+/**
+  @brief Replace placeholders with songs of a received window.
+  */
+static void library_window_fill(struct library_tab *tab, guint start, GList *list)
+{
+	const struct mpd_song *song;
+	GtkTreeIter iter;
+	GList *cur;
+	gboolean valid;
+
+	if (!tab->windowed) {
+		return;
 	}
 
-	if (tab->path->selected) {
-		g_free(tab->path->selected);
+	valid = gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(tab->store), &iter, NULL, start);
+	for (cur = list; cur && valid; cur = cur->next) {
+		if (mpd_entity_get_type(cur->data) != MPD_ENTITY_TYPE_SONG) {
+			continue;
+		}
+		song = mpd_entity_get_song(cur->data);
+		library_model_set(tab->store, &iter, LIBRARY_SONG, song_format_run(tab->format, song, tab->fmtbuf),
+				mpd_song_get_uri(song), MPD_ENTITY_TYPE_SONG);
+		valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(tab->store), &iter);
 	}
+}
 
-	tab->path->selected = name;
+/**
+  @brief Check whether a count command counts songs by groups.
+  */
+static gboolean library_count_grouped(GList *args)
+{
+	GList *cur;
 
-	path = library_path_open(tab->path, name, type);
+	for (cur = args; cur; cur = cur->next) {
+		if (!g_strcmp0(cur->data, "group")) {
+			return TRUE;
+		}
+	}
 
-	if (!path) {
+	return FALSE;
+}
+
+/**
+  @brief Remember song counts of rows of a tag listing and show them if the
+  listing is still shown.
+  */
+static void library_counts_received(struct library_tab *tab, GList *groups)
+{
+	const struct mpd_count_group *group;
+	struct listing_count *count;
+	struct listing_entry *entry;
+	GHashTable *counts;
+	GObject *tw;
+	GList *cur;
+	gchar *key;
+	gchar *shown;
+
+	key = g_queue_pop_head(&tab->count_keys);
+	if (!key) {
 		return;
 	}
 
-	tab->path = path;
+	counts = listing_counts_new();
+	for (cur = groups; cur; cur = cur->next) {
+		group = cur->data;
+		count = g_malloc(sizeof(struct listing_count));
+		count->songs = group->songs;
+		count->playtime = group->playtime;
+		g_hash_table_insert(counts, g_strdup(group->name), count);
+	}
 
-	if (path->parent) {
-		icon = listing_icons[path->parent->type];
-	} else {
-		icon = listing_icons[path->type];
+	entry = listing_cache_lookup(&tab->listings, key);
+	if (entry) {
+		listing_cache_set_counts(&tab->listings, entry, counts);
+	}
+
+	shown = tab->path && !tab->searching ? library_listing_key(tab->path) : NULL;
+	if (!g_strcmp0(shown, key)) {
+		if (tab->counts) {
+			g_hash_table_unref(tab->counts);
+		}
+		tab->counts = g_hash_table_ref(counts);
+		tw = gtk_builder_get_object(tab->ui, "tw");
+		gtk_widget_queue_draw(GTK_WIDGET(tw));
+	}
+
+	g_hash_table_unref(counts);
+	g_free(shown);
+	g_free(key);
+}
+
+void library_count_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	GtkTreePath *top = NULL;
+	GObject *tw;
+	guint rows;
+
+	if (library_count_grouped(args)) {
+		library_counts_received(tab, answer->count.groups);
+		return;
+	}
+
+	if (!tab->windowed || tab->searching || !tab->path || tab->path->type != LIBRARY_SONG ||
+			g_strcmp0(g_list_nth_data(args, 1), tab->path->name)) {
+		return;
+	}
+
+	rows = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(tab->store), NULL);
+	MSG_DEBUG("%u songs in windowed listing", answer->count.songs);
+
+	/* the view would handle every inserted row, long albums have thousands */
+	tw = gtk_builder_get_object(tab->ui, "tw");
+	gtk_tree_view_get_visible_range(GTK_TREE_VIEW(tw), &top, NULL);
+	g_object_ref(tab->store);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(tw), NULL);
+	for (; rows < answer->count.songs; rows++) {
+		library_model_append(tab->store, LIBRARY_SONG, _("Loading…"), NULL, MPD_ENTITY_TYPE_UNKNOWN);
+	}
+	gtk_tree_view_set_model(GTK_TREE_VIEW(tw), GTK_TREE_MODEL(tab->store));
+	g_object_unref(tab->store);
+	if (top) {
+		gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(tw), top, NULL, TRUE, 0.0, 0.0);
+		gtk_tree_path_free(top);
+	}
+	g_array_set_size(tab->windows, (rows + LIBRARY_LISTING_WINDOW - 1) / LIBRARY_LISTING_WINDOW);
+
+	library_window_request_visible(tab);
+}
+
+void library_window_scrolled(GtkAdjustment *adjustment, gpointer data)
+{
+	library_window_request_visible((struct library_tab *) data);
+}
+
+void library_lsinfo_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	const char *uri_arg;
+	gchar *uri;
+	GList *cur;
+	GtkTreeIter iter;
+	struct listing_entry *entry;
+	const char *window;
+	guint start;
+
+	if (library_prefetch_answer(tab, cmd, args, answer) || tab->searching) {
+		return;
+	}
+
+	if (!tab->root) {
+		return;
+	}
+
+	if (!tab->path) {
+		return;
+	}
+
+	if (tab->path->type == LIBRARY_FS) {
+		if (cmd != MPD_CMD_LSINFO) {
+			MSG_WARNING("irrelevant answer received for LIBRARY_FS list");
+			return;
+		}
+		uri_arg = g_list_nth_data(args, 0);
+		if (!uri_arg) {
+			uri_arg = "";
+		}
+        
+		uri = library_path_get_uri(tab->root, tab->path);
+        
+		MSG_DEBUG("received uri: %s; opened uri: %s", uri_arg, uri);
+		if (g_strcmp0(uri, uri_arg)) {
+			MSG_WARNING("irrelevant lsinfo answer received");
+			g_free(uri);
+			return;
+		}
+		g_free(uri);
+	} else if (tab->path->type == LIBRARY_SONG) {
+		if (cmd != MPD_CMD_FIND) {
+			MSG_WARNING("irrelevant answer received for LIBRARY_SONG list");
+			return;
+		}
+		if (g_strcmp0(g_list_nth_data(args, 1), tab->path->name)) {
+			MSG_WARNING("received answer for irrelevant album");
+			return;
+		}
+		window = g_list_nth_data(args, 3);
+		start = window ? g_ascii_strtoull(window, NULL, 10) : 0;
+		if (start > 0) {
+			library_window_fill(tab, start, answer->lsinfo.list);
+			return;
+		}
+		if (g_list_length(answer->lsinfo.list) == LIBRARY_LISTING_WINDOW) {
+			library_window_begin(tab, answer->lsinfo.list);
+			return;
+		}
+	} else if (tab->path->type == LIBRARY_PLAYLIST) {
+		if (cmd != MPD_CMD_LISTPLS) {
+			MSG_WARNING("irrelevant answer received while expecting listplaylists");
+			return;
+		}
+	} else if (tab->path->type == LIBRARY_PLAYLISTSONG) {
+		if (cmd != MPD_CMD_LISTPL && cmd != MPD_CMD_LISTPLINFO) {
+			MSG_WARNING("irrelevant answer received while expecting listplaylist");
+			return;
+		}
+		uri_arg = g_list_nth_data(args, 0);
+		uri = library_path_get_uri(tab->root, tab->path);
+		if (g_strcmp0(uri_arg, uri)) {
+			MSG_WARNING("irrelevant playlistinfo answer received");
+			g_free(uri);
+			return;
+		}
+		g_free(uri);
+	} else {
+		MSG_WARNING("irrelevant lsinfo answer received");
+		return;
+	}
+
+	if (tab->revalidating && tab->fingerprint) {
+		uri = library_listing_key(tab->path);
+		entry = listing_entry_new(uri);
+		g_free(uri);
+		for (cur = answer->lsinfo.list; cur; cur = cur->next) {
+			library_entry_append_entity(tab, entry, cur->data);
+		}
+		library_listing_revalidated(tab, entry);
+		return;
+	}
+
+	library_show_begin(tab);
+	
+	for (cur = answer->lsinfo.list; cur; cur = cur->next) {
+		iter = library_model_append_entity(tab, cur->data);
+		if (!g_strcmp0(tab->path->selected, cur->data)) {
+			library_select(tab, &iter);
+		}
+	}
+
+	library_show_end(tab);
+	library_listing_remember(tab);
+}
+
+/**
+  @brief Drop the local copy of the database being built.
+  */
+static void library_build_stop(struct library_tab *tab)
+{
+	if (tab->build_source) {
+		g_source_remove(tab->build_source);
+		tab->build_source = 0;
+	}
+	libcache_builder_free(tab->builder);
+	tab->builder = NULL;
+	g_queue_free_full(&tab->build_dirs, g_free);
+	g_queue_init(&tab->build_dirs);
+	/* a listing still on its way is ignored */
+	tab->build_serial = 0;
+}
+
+/**
+  @brief Write the local copy of the database once every directory is listed.
+  */
+static void library_build_finish(struct library_tab *tab)
+{
+	gchar *path;
+
+	path = sonatina_profile_cache_path(sonatina.profile, "library");
+	if (libcache_builder_write(tab->builder, path, tab->db_update)) {
+		/* the old file stays mapped until it is closed */
+		library_index_stop(tab);
+		libcache_close(tab->cache);
+		tab->cache = libcache_open(path);
+	}
+	g_free(path);
+	library_build_stop(tab);
+
+	tab->cache_valid = tab->cache && libcache_db_update(tab->cache) == tab->db_update;
+	if (tab->cache_valid && !tab->index) {
+		library_index_start(tab);
+	}
+}
+
+/**
+  @brief List the next directory of the database for the local copy, but
+  only when no other command waits for the connection.
+  */
+static gboolean library_build_next(gpointer data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	gchar *uri;
+
+	tab->build_source = 0;
+	if (!tab->mpdsource || !tab->builder || tab->build_serial) {
+		return G_SOURCE_REMOVE;
+	}
+
+	if (!mpd_source_is_idle(tab->mpdsource)) {
+		/* commands of the user go first */
+		tab->build_source = g_timeout_add(LIBRARY_BUILD_DELAY, library_build_next, tab);
+		return G_SOURCE_REMOVE;
+	}
+
+	uri = g_queue_pop_head(&tab->build_dirs);
+	if (!uri) {
+		library_build_finish(tab);
+		return G_SOURCE_REMOVE;
+	}
+
+	/* the local copy keeps all tags, whatever the formats need now */
+	mpd_send(tab->mpdsource, MPD_CMD_TAGTYPES, "all", NULL);
+	if (mpd_send(tab->mpdsource, MPD_CMD_LSINFO_RAW, uri, NULL)) {
+		tab->build_serial = mpd_source_last_sent(tab->mpdsource);
+	} else {
+		library_build_stop(tab);
+	}
+	sonatina_update_tagtypes(TRUE);
+	g_free(uri);
+
+	return G_SOURCE_REMOVE;
+}
+
+void library_stats_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	guint64 db_update;
+
+	if (!answer->stats || !sonatina_settings_get_bool("library", "cache")) {
+		return;
+	}
+
+	db_update = mpd_stats_get_db_update_time(answer->stats);
+	if (tab->cache && libcache_db_update(tab->cache) == db_update) {
+		if (!tab->cache_valid) {
+			MSG_INFO("library cache is up to date");
+		}
+		tab->cache_valid = TRUE;
+		if (!tab->index) {
+			library_index_start(tab);
+		}
+		return;
+	}
+
+	if (tab->builder && tab->db_update == db_update) {
+		/* already being built */
+		return;
+	}
+
+	/*
+	 * The database is listed one directory at a time, each only when the
+	 * connection is otherwise idle, so commands of the user don't wait
+	 * behind it and no answer outgrows the output buffer of the server.
+	 * Idle events arrive between the listings; a database change stops
+	 * the build and the following stats start it again.
+	 */
+	MSG_INFO("library cache is out of date, rebuilding");
+	library_build_stop(tab);
+	tab->cache_valid = FALSE;
+	tab->db_update = db_update;
+	tab->builder = libcache_builder_new();
+	g_queue_push_tail(&tab->build_dirs, g_strdup(""));
+	tab->build_source = g_idle_add(library_build_next, tab);
+}
+
+void library_lsinfo_raw_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	struct mpd_pair pair;
+	guint i;
+
+	if (!tab->build_serial || mpd_source_answered(tab->mpdsource) != tab->build_serial) {
+		return;
+	}
+	tab->build_serial = 0;
+
+	/* the root listing also carries stored playlists, as it does for the
+	 * filesystem browser */
+	for (i = 0; answer->pairs && i + 1 < answer->pairs->len; i += 2) {
+		pair.name = g_ptr_array_index(answer->pairs, i);
+		pair.value = g_ptr_array_index(answer->pairs, i + 1);
+		libcache_builder_feed(tab->builder, &pair);
+		if (!strcmp(pair.name, "directory")) {
+			g_queue_push_tail(&tab->build_dirs, g_strdup(pair.value));
+		}
+	}
+
+	if (!tab->build_source) {
+		tab->build_source = g_idle_add(library_build_next, tab);
+	}
+}
+
+void library_error_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	gboolean open;
+
+	if (cmd == MPD_CMD_LSINFO_RAW) {
+		if (tab->build_serial && mpd_source_answered(tab->mpdsource) == tab->build_serial) {
+			/* e.g. the directory was removed; the database change starts
+			 * the build again */
+			MSG_WARNING("library cache could not be built");
+			library_build_stop(tab);
+		}
+		return;
+	}
+
+	if (cmd == MPD_CMD_COUNTSONGS && library_count_grouped(args)) {
+		/* counting by groups needs MPD 0.21; rows just show no counts */
+		g_free(g_queue_pop_head(&tab->count_keys));
+		return;
+	}
+
+	if (cmd == MPD_CMD_SEARCH && tab->search_pending && args && !g_strcmp0(args->data, tab->search_expr)) {
+		/* filter expressions and windows need MPD 0.21 */
+		MSG_WARNING("server search failed");
+		tab->search_pending = FALSE;
+		tab->search_more = FALSE;
+		library_set_busy(tab, FALSE);
+		return;
+	}
+
+	if (tab->revalidating && !library_prefetch_matches(tab, cmd, args) &&
+			(cmd == MPD_CMD_LSINFO || cmd == MPD_CMD_LIST || cmd == MPD_CMD_FIND ||
+			 cmd == MPD_CMD_LISTPLS || cmd == MPD_CMD_LISTPL || cmd == MPD_CMD_LISTPLINFO)) {
+		/* e.g. the directory was removed; keep showing what we have */
+		MSG_WARNING("shown listing could not be revalidated");
+		tab->revalidating = FALSE;
+		library_set_busy(tab, FALSE);
+		return;
+	}
+
+	if (!library_prefetch_matches(tab, cmd, args)) {
+		return;
+	}
+
+	MSG_DEBUG("prefetch failed");
+	open = tab->prefetch.open;
+	library_prefetch_clear(tab);
+	if (open) {
+		library_set_busy(tab, FALSE);
+	}
+}
+
+void library_idle_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+
+	if (answer->idle & MPD_CHANGED_DB)
+	{
+		MSG_INFO("library changed");
+		listing_cache_invalidate(&tab->listings);
+		if (tab->cache) {
+			tab->cache_valid = FALSE;
+		}
+		if (tab->builder) {
+			/* listed directories may be out of date already */
+			library_build_stop(tab);
+			mpd_send(tab->mpdsource, MPD_CMD_STATS, NULL);
+		}
+		/* nobody watches a hidden tab, a scan only marks it stale */
+		if (!sonatina_tab_defer(&tab->tab)) {
+			library_tab_refresh(&tab->tab);
+		}
+	} else if (answer->idle & MPD_CHANGED_STORED_PL) {
+		listing_cache_invalidate(&tab->listings);
+	}
+}
+
+void library_tab_refresh(struct sonatina_tab *tab)
+{
+	struct library_tab *libtab = (struct library_tab *) tab;
+
+	if (!libtab->mpdsource) {
+		return;
+	}
+
+	if (libtab->cache) {
+		mpd_send(libtab->mpdsource, MPD_CMD_STATS, NULL);
+	}
+	/* search results are refreshed when the new index is built */
+	if (!libtab->searching && !library_revalidate(libtab)) {
+		library_load(libtab);
+	}
+}
+
+void library_pathbar_changed(SonatinaPathBar *pathbar, gint selected, gpointer data)
+{
+	MSG_DEBUG("pathbar changed");
+	library_tab_open_pos((struct library_tab *) data, selected);
+}
+
+void library_set_listing(struct library_tab *tab, enum listing_type listing)
+{
+	const char *title;
+
+	library_path_free_all(tab->root);
+
+	tab->root = library_path_root(listing);
+	tab->path = tab->root;
+
+	if (listing == LIBRARY_FS) {
+		title = _("Filesystem");
+	} else if (listing == LIBRARY_PLAYLIST) {
+		title = _("Playlists");
+	} else {
+		title = tab->root->name;
+	}
+	sonatina_path_bar_open_root(tab->pathbar, title, listing_icons[listing]);
+}
+
+GtkTreeIter library_model_append_entity(struct library_tab *tab, const struct mpd_entity *entity)
+{
+	const struct mpd_directory *dir;
+	const struct mpd_song *song;
+	const struct mpd_playlist *pl;
+	gchar *name = NULL;
+	const char *display;
+	const char *uri = NULL;
+	enum mpd_entity_type mpdtype;
+	enum listing_type type;
+	GtkTreeIter iter;
+
+	mpdtype = mpd_entity_get_type(entity);
+
+	switch (mpdtype) {
+	case MPD_ENTITY_TYPE_DIRECTORY:
+		type = LIBRARY_FS;
+		dir = mpd_entity_get_directory(entity);
+		uri = mpd_directory_get_path(dir);
+		name = g_path_get_basename(uri);
+		display = name;
+		break;
+	case MPD_ENTITY_TYPE_SONG:
+		song = mpd_entity_get_song(entity);
+		return library_model_append_song(tab, song);
+	case MPD_ENTITY_TYPE_PLAYLIST:
+		type = LIBRARY_PLAYLIST;
+		pl = mpd_entity_get_playlist(entity);
+		uri = mpd_playlist_get_path(pl);
+		name = g_path_get_basename(uri);
+		display = name;
+		break;
+	default:
+		type = LIBRARY_FS;
+		display = _("unknown");
+		break;
+	}
+
+	iter = library_model_append(tab->store, type, display, uri, mpdtype);
+	g_free(name);
+
+	return iter;
+}
+
+GtkTreeIter library_model_append_song(struct library_tab *tab, const struct mpd_song *song)
+{
+	return library_model_append(tab->store, LIBRARY_SONG, song_format_run(tab->format, song, tab->fmtbuf),
+			mpd_song_get_uri(song), MPD_ENTITY_TYPE_SONG);
+}
+
+GtkTreeIter library_model_append(GtkListStore *model, enum listing_type type, const char *name, const char *uri, enum mpd_entity_type mpdtype)
+{
+	GtkTreeIter iter;
+
+	gtk_list_store_append(model, &iter);
+	library_model_set(model, &iter, type, name, uri, mpdtype);
+
+	return iter;
+}
+
+void library_model_set(GtkListStore *model, GtkTreeIter *iter, enum listing_type type, const char *name, const char *uri, enum mpd_entity_type mpdtype)
+{
+	GIcon *icon;
+	const char *display;
+
+	if (!name || strlen(name) == 0) {
+		switch (type) {
+		case LIBRARY_GENRE:
+			display = _("Unknown genre");
+			break;
+		case LIBRARY_ARTIST:
+			display = _("Unknown artist");
+			break;
+		case LIBRARY_ALBUM:
+			display = _("Unknown album");
+			break;
+		default:
+			display = _("Unknown");
+			break;
+		}
+	} else {
+		display = name;
+		name = NULL;
+	}
+
+	icon = g_icon_new_for_string(listing_icons[type], NULL);
+	gtk_list_store_set(model, iter,
+			LIB_COL_ICON, icon,
+			LIB_COL_DISPLAY_NAME, display,
+			LIB_COL_NAME, name,
+			LIB_COL_URI, uri,
+			LIB_COL_TYPE, mpdtype, -1);
+	g_object_unref(icon);
+}
+
+void library_tab_destroy(struct sonatina_tab *tab)
+{
+	struct library_tab *libtab = (struct library_tab *) tab;
+	struct library_path *path;
+
+	gtk_widget_destroy(tab->widget);
+
+	/* the index refers to the cache and its entry to the UI */
+	library_index_stop(libtab);
+	art_cache_cancel(sonatina.art, libtab);
+	g_object_unref(libtab->ui);
+	g_object_unref(libtab->store);
+	g_object_unref(libtab->pathbar);
+	g_object_unref(libtab->selected_actions);
+	g_object_unref(libtab->selected_fs_actions);
+	g_object_unref(libtab->selected_pl_actions);
+	sel_tracker_free(&libtab->selection);
+	song_format_free(libtab->format);
+	g_string_free(libtab->fmtbuf, TRUE);
+	library_build_stop(libtab);
+	libcache_close(libtab->cache);
+	library_prefetch_cancel(libtab);
+	listing_cache_free(&libtab->listings);
+	g_free(libtab->query);
+	g_free(libtab->search_expr);
+	tag_sort_free(&libtab->pending);
+	g_array_free(libtab->windows, TRUE);
+	if (libtab->counts) {
+		g_hash_table_unref(libtab->counts);
+	}
+	g_queue_free_full(&libtab->count_keys, g_free);
+
+	for (path = libtab->root; path; path = path->next) {
+		library_path_free(path);
+	}
+}
+
+void library_format_changed(union settings_value value, void *data)
+{
+	struct library_tab *tab;
+
+	tab = (struct library_tab *) sonatina_get_tab("library");
+	if (!tab) {
+		return;
+	}
+
+	song_format_free(tab->format);
+	tab->format = song_format_compile(value.string);
+	sonatina_update_tagtypes(FALSE);
+	/* remembered song rows are formatted */
+	listing_cache_clear(&tab->listings);
+
+	if (tab->searching) {
+		library_search_run(tab);
+	} else if (tab->mpdsource) {
+		library_load(tab);
+	}
+}
+
+void library_cache_changed(union settings_value value, void *data)
+{
+	struct library_tab *tab;
+
+	tab = (struct library_tab *) sonatina_get_tab("library");
+	if (!tab || !tab->mpdsource) {
+		return;
+	}
+
+	if (value.boolean) {
+		library_cache_open(tab);
+	} else {
+		library_cache_close(tab);
+	}
+}
+
+void library_sort_changed(union settings_value value, void *data)
+{
+	struct library_tab *tab;
+
+	tab = (struct library_tab *) sonatina_get_tab("library");
+	if (!tab) {
+		return;
+	}
+
+	/* remembered tag listings are sorted */
+	listing_cache_clear(&tab->listings);
+	library_prefetch_cancel(tab);
+
+	if (tab->mpdsource && !tab->searching) {
+		library_load(tab);
+	}
+}
+
+void library_cache_open(struct library_tab *tab)
+{
+	gchar *path;
+
+	if (!sonatina.profile) {
+		return;
+	}
+
+	library_cache_close(tab);
+
+	path = sonatina_profile_cache_path(sonatina.profile, "library");
+	tab->cache = libcache_open(path);
+	g_free(path);
+
+	/* the cache is only used after stats confirm it is up to date */
+	mpd_send(tab->mpdsource, MPD_CMD_STATS, NULL);
+}
+
+void library_cache_close(struct library_tab *tab)
+{
+	library_build_stop(tab);
+	library_index_stop(tab);
+	libcache_close(tab->cache);
+	tab->cache = NULL;
+	tab->cache_valid = FALSE;
+}
+
+struct library_path *library_path_root(enum listing_type listing)
+{
+	struct library_path *path;
+
+	path = g_malloc(sizeof(struct library_path));
+
+	path->type = listing;
+	path->parent = NULL;
+	path->next = NULL;
+	path->name = NULL;
+	path->selected = NULL;
+	path->pos = NULL;
+
+	switch (listing) {
+	case LIBRARY_FS:
+		path->name = g_strdup("");
+		break;
+	case LIBRARY_PLAYLIST:
+		path->name = g_strdup(_("Playlists"));
+		break;
+	case LIBRARY_GENRE:
+		path->name = g_strdup(_("Genre"));
+		break;
+	case LIBRARY_ARTIST:
+		path->name = g_strdup(_("Artist"));
+		break;
+	case LIBRARY_ALBUM:
+		path->name = g_strdup(_("Album"));
+		break;
+	default:
+		break;
+	}
+
+	return path;
+}
+
+void library_path_free(struct library_path *path)
+{
+	if (!path) {
+		return;
+	}
+
+	if (path->name) {
+		g_free(path->name);
+	}
+
+	if (path->selected) {
+		g_free(path->selected);
+	}
+
+	g_free(path);
+}
+
+void library_path_free_all(struct library_path *root)
+{
+	struct library_path *path;
+
+	if (!root) {
+		return;
+	}
+
+	for (path = root->next; path; path = path->next) {
+		library_path_free(path->parent);
+	}
+}
+
+
+gboolean library_load(struct library_tab *tab)
+{
+	const gchar *args[LIBRARY_LISTING_MAX_ARGS + 1];
+	struct listing_entry *entry;
+	enum mpd_cmd_type cmd;
+	GObject *spinner;
+	gchar *key;
+	gchar *uri;
+	gboolean retval;
+
+	if (tab->searching) {
+		library_search_leave(tab);
+	}
+
+	tab->revalidating = FALSE;
+	/* rows of the previous listing are going away */
+	library_prefetch_cancel_scheduled(tab);
+	tab->prefetch.open = FALSE;
+	tab->prefetch_bytes = 0;
+
+	key = library_listing_key(tab->path);
+	entry = listing_cache_lookup(&tab->listings, key);
+
+	if (entry && !entry->stale) {
+		g_free(key);
+		library_listing_show(tab, entry);
+		return TRUE;
+	}
+
+	library_set_busy(tab, TRUE);
+
+	if (tab->cache_valid && library_load_cached(tab)) {
+		g_free(key);
+		return TRUE;
+	}
+
+	if (!g_strcmp0(tab->prefetch.key, key)) {
+		/* the answer is already on its way */
+		MSG_DEBUG("waiting for prefetched listing");
+		tab->prefetch.open = TRUE;
+		g_free(key);
+		return TRUE;
+	}
+	g_free(key);
+
+	if (entry) {
+		/* show what we have and replace it when the server answers */
+		library_listing_show(tab, entry);
+		tab->revalidating = TRUE;
+		spinner = gtk_builder_get_object(tab->ui, "spinner");
+		g_object_set(spinner, "active", TRUE, NULL);
+	}
+
+	uri = library_path_get_uri(tab->root, tab->path);
+	cmd = library_listing_command(tab->path, uri, args);
+	if (cmd == MPD_CMD_NONE) {
+		g_free(uri);
+		return FALSE;
+	}
+
+	MSG_INFO("opening listing: %s %s", mpd_cmd_to_str(cmd), args[0] ? args[0] : "");
+	retval = mpd_send(tab->mpdsource, cmd, args[0], args[1], args[2], args[3], args[4], NULL);
+	g_free(uri);
+
+	return retval;
+}
+
+gboolean library_revalidate(struct library_tab *tab)
+{
+	const gchar *args[LIBRARY_LISTING_MAX_ARGS + 1];
+	enum mpd_cmd_type cmd;
+	GObject *spinner;
+	gchar *uri;
+	gboolean retval;
+
+	if (!tab->path || !tab->fingerprint || tab->revalidating || tab->windowed) {
+		/* nothing shown that could be kept, windows are loaded again */
+		return FALSE;
+	}
+
+	uri = library_path_get_uri(tab->root, tab->path);
+	cmd = library_listing_command(tab->path, uri, args);
+	if (cmd == MPD_CMD_NONE || (cmd == MPD_CMD_LIST && tab->path->type == LIBRARY_ARTIST && !tab->path->parent &&
+			sonatina_settings_get_bool("library", "album_tree"))) {
+		/* the album tree is rebuilt as a whole */
+		g_free(uri);
+		return FALSE;
+	}
+
+	MSG_INFO("revalidating listing: %s %s", mpd_cmd_to_str(cmd), args[0] ? args[0] : "");
+	tab->revalidating = TRUE;
+	spinner = gtk_builder_get_object(tab->ui, "spinner");
+	g_object_set(spinner, "active", TRUE, NULL);
+	retval = mpd_send(tab->mpdsource, cmd, args[0], args[1], args[2], args[3], args[4], NULL);
+	g_free(uri);
+
+	return retval;
+}
+
+/**
+  Listing being filled from the local copy of the database.
+  */
+struct library_cached_listing {
+	struct library_tab *tab;
+};
+
+static void library_cached_tag(const gchar *name, gpointer data)
+{
+	struct library_cached_listing *listing = (struct library_cached_listing *) data;
+
+	library_show_tag(listing->tab, name, NULL);
+}
+
+static void library_cached_dir(const gchar *path, gpointer data)
+{
+	struct library_cached_listing *listing = (struct library_cached_listing *) data;
+	gchar *name;
+
+	name = g_path_get_basename(path);
+	library_model_append(listing->tab->store, LIBRARY_FS, name, path, MPD_ENTITY_TYPE_DIRECTORY);
+	g_free(name);
+}
+
+static void library_cached_playlist(const gchar *path, gpointer data)
+{
+	struct library_cached_listing *listing = (struct library_cached_listing *) data;
+	gchar *name;
+
+	name = g_path_get_basename(path);
+	library_model_append(listing->tab->store, LIBRARY_PLAYLIST, name, path, MPD_ENTITY_TYPE_PLAYLIST);
+	g_free(name);
+}
+
+static void library_cached_song(const struct libcache *cache, const struct libcache_song *cached, gpointer data)
+{
+	struct library_cached_listing *listing = (struct library_cached_listing *) data;
+	struct mpd_song *song;
+
+	song = libcache_song_new(cache, cached);
+	if (!song) {
+		return;
+	}
+	library_model_append_song(listing->tab, song);
+	mpd_song_free(song);
+}
+
+gboolean library_load_cached(struct library_tab *tab)
+{
+	struct library_cached_listing listing;
+	gchar *uri;
+	gboolean found;
+
+	listing.tab = tab;
+
+	/* mirrors the commands sent by library_load() */
+	switch (tab->path->type) {
+	case LIBRARY_FS:
+		uri = library_path_get_uri(tab->root, tab->path);
+		library_show_begin(tab);
+		found = libcache_lsinfo(tab->cache, uri, library_cached_dir, library_cached_song,
+				library_cached_playlist, &listing);
+		g_free(uri);
+		if (!found) {
+			return FALSE;
+		}
+		break;
+	case LIBRARY_GENRE:
+		library_show_begin(tab);
+		libcache_list(tab->cache, LIBCACHE_GENRE, LIBCACHE_NONE, NULL, library_cached_tag, &listing);
+		break;
+	case LIBRARY_ARTIST:
+		library_show_begin(tab);
+		if (tab->path->parent && tab->path->parent->type == LIBRARY_GENRE) {
+			libcache_list(tab->cache, LIBCACHE_ARTIST, LIBCACHE_GENRE, tab->path->name,
+					library_cached_tag, &listing);
+		} else {
+			libcache_list(tab->cache, LIBCACHE_ARTIST, LIBCACHE_NONE, NULL, library_cached_tag, &listing);
+		}
+		break;
+	case LIBRARY_ALBUM:
+		if (library_tag_sort_flags(LIBRARY_ALBUM) & TAG_SORT_BY_DATE) {
+			/* the local copy doesn't index dates */
+			return FALSE;
+		}
+		library_show_begin(tab);
+		if (tab->path->parent && tab->path->parent->type == LIBRARY_ARTIST) {
+			libcache_list(tab->cache, LIBCACHE_ALBUM, LIBCACHE_ARTIST, tab->path->name,
+					library_cached_tag, &listing);
+		} else {
+			libcache_list(tab->cache, LIBCACHE_ALBUM, LIBCACHE_NONE, NULL, library_cached_tag, &listing);
+		}
+		break;
+	case LIBRARY_SONG:
+		library_show_begin(tab);
+		libcache_find(tab->cache, LIBCACHE_ALBUM, tab->path->name, library_cached_song, &listing);
+		break;
+	default:
+		/* stored playlists are not part of the database */
+		return FALSE;
+	}
+
+	library_show_end(tab);
+	library_listing_remember(tab);
+
+	return TRUE;
+}
+
+gchar *library_listing_key(const struct library_path *path)
+{
+	gchar *parent;
+	gchar *key;
+
+	/* names can't contain newlines, MPD protocol is line based */
+	parent = path->parent ? library_listing_key(path->parent) : g_strdup("");
+	key = g_strdup_printf("%s%d:%s\n", parent, path->type, path->name);
+	g_free(parent);
+
+	return key;
+}
+
+void library_listing_remember(struct library_tab *tab)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(tab->store);
+	struct listing_entry *entry;
+	GtkTreeIter iter;
+	gboolean valid;
+	gchar *display;
+	gchar *name;
+	gchar *uri;
+	gchar *key;
+	gint mpdtype;
+
+	key = library_listing_key(tab->path);
+	entry = listing_entry_new(key);
+	g_free(key);
+
+	for (valid = gtk_tree_model_get_iter_first(model, &iter); valid; valid = gtk_tree_model_iter_next(model, &iter)) {
+		gtk_tree_model_get(model, &iter,
+				LIB_COL_DISPLAY_NAME, &display,
+				LIB_COL_NAME, &name,
+				LIB_COL_URI, &uri,
+				LIB_COL_TYPE, &mpdtype, -1);
+		/* name is only set when it differs from the displayed one */
+		listing_entry_append(entry, name ? name : display, uri, mpdtype);
+		g_free(display);
+		g_free(name);
+		g_free(uri);
+	}
+
+	/* before the cache takes the entry, it may drop it */
+	tab->fingerprint = entry->fingerprint;
+	listing_cache_insert(&tab->listings, entry);
+}
+
+void library_listing_show(struct library_tab *tab, const struct listing_entry *entry)
+{
+	const struct listing_row *row;
+	GtkTreeIter iter;
+	guint i;
+
+	library_show_begin(tab);
+
+	for (i = 0; i < entry->rows->len; i++) {
+		row = &g_array_index(entry->rows, struct listing_row, i);
+		iter = library_model_append(tab->store, library_row_type(tab, row->mpdtype), row->name, row->uri, row->mpdtype);
+		if (!g_strcmp0(tab->path->selected, row->name)) {
+			library_select(tab, &iter);
+		}
+	}
+
+	library_show_end(tab);
+	tab->fingerprint = entry->fingerprint;
+}
+
+gboolean library_add(struct library_tab *tab, GtkTreeIter iter)
+{
+	gchar *display_name;
+	gchar *name;
+	gchar *uri;
+	enum mpd_entity_type type;
+	enum listing_type listing;
+	gboolean retval = FALSE;
+
+	gtk_tree_model_get(GTK_TREE_MODEL(tab->store), &iter,
+			LIB_COL_DISPLAY_NAME, &display_name,
+			LIB_COL_NAME, &name,
+			LIB_COL_URI, &uri,
+			LIB_COL_TYPE, &type, -1);
+
+	if (!name) {
+		name = display_name;
+		display_name = NULL;
+	}
+
+	/* search results are songs */
+	listing = tab->searching ? LIBRARY_SONG : tab->path->type;
+
+	switch (listing) {
+	case LIBRARY_FS:
+		MSG_DEBUG("sending add %s", uri);
+		if (type == MPD_ENTITY_TYPE_PLAYLIST) {
+			retval = mpd_send(tab->mpdsource, MPD_CMD_LOAD, uri, NULL);
+		} else {
+			retval = mpd_send(tab->mpdsource, MPD_CMD_ADD, uri, NULL);
+		}
+		break;
+	case LIBRARY_PLAYLIST:
+		MSG_INFO("adding playlist %s", name);
+		retval = mpd_send(tab->mpdsource, MPD_CMD_LOAD, name, NULL);
+		break;
+	case LIBRARY_GENRE:
+		MSG_INFO("adding genre %s", name);
+		retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "genre", name, NULL);
+		break;
+	case LIBRARY_ARTIST:
+		MSG_INFO("adding artist %s", name);
+		if (tab->path->parent && tab->path->parent->type == LIBRARY_GENRE) {
+			retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "albumartist", name,
+					"genre", tab->path->name, NULL);
+		} else {
+			retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "albumartist", name, NULL);
+		}
+		break;
+	case LIBRARY_ALBUM:
+		MSG_INFO("adding album %s", name);
+		if (tab->path->parent && tab->path->parent->type == LIBRARY_ARTIST) {
+			if (tab->path->parent && tab->path->parent->type == LIBRARY_GENRE) {
+				retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "album", name,
+						"albumartist", tab->path->name,
+						"genre", tab->path->parent->name, NULL);
+			} else {
+				MSG_DEBUG("adding album %s from artist %s", name, tab->path->name);
+				retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "album", name,
+						"albumartist", tab->path->name, NULL);
+			}
+		} else {
+			retval = mpd_send(tab->mpdsource, MPD_CMD_FINDADD, "album", name, NULL);
+		}
+		break;
+	case LIBRARY_SONG:
+	case LIBRARY_PLAYLISTSONG:
+		if (!uri) {
+			/* placeholder of a window that isn't loaded yet */
+			break;
+		}
+		MSG_INFO("adding song %s", name);
+		retval = mpd_send(tab->mpdsource, MPD_CMD_ADD, uri, NULL);
+		break;
+	default:
+		retval = FALSE;
+		break;
+	}
+
+	g_free(name);
+	g_free(display_name);
+	g_free(uri);
+
+	return retval;
+}
+
+void library_tab_save_scroll(struct library_tab *tab)
+{
+	GObject *tw;
+
+	g_assert(tab != NULL);
+	g_assert(tab->path != NULL);
+
+	tw = gtk_builder_get_object(tab->ui, "tw");
+
+	if (tab->path->pos) {
+		gtk_tree_path_free(tab->path->pos);
+	}
+	gtk_tree_view_get_visible_range(GTK_TREE_VIEW(tw), &tab->path->pos, NULL);
+}
+
+void library_tab_set_scroll(struct library_tab *tab)
+{
+	GObject *tw;
+
+	g_assert(tab != NULL);
+	g_assert(tab->path != NULL);
+
+	if (!tab->path->pos) {
+		return;
+	}
+
+	tw = gtk_builder_get_object(tab->ui, "tw");
+	gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(tw), tab->path->pos, NULL, TRUE, 0.0, 0.0);
+}
+
+void library_tab_open_dir(struct library_tab *tab, GtkTreeIter iter)
+{
+	struct library_path *path;
+	const char *icon;
+	gchar *name;
+	gchar *display_name;
+	enum mpd_entity_type type;
+
+	library_tab_save_scroll(tab);
+
+	gtk_tree_model_get(GTK_TREE_MODEL(tab->store), &iter,
+			LIB_COL_NAME, &name,
+			LIB_COL_DISPLAY_NAME, &display_name,
+			LIB_COL_TYPE, &type, -1);
+
+	if (!name) {
+		name = g_strdup(display_name);
+	}
+
+	if (tab->path->selected) {
+		g_free(tab->path->selected);
+	}
+
+	tab->path->selected = name;
+
+	path = library_path_open(tab->path, name, type);
+
+	if (!path) {
+		return;
+	}
+
+	tab->path = path;
+
+	if (path->parent) {
+		icon = listing_icons[path->parent->type];
+	} else {
+		icon = listing_icons[path->type];
+	}
+
+	sonatina_path_bar_open(tab->pathbar, display_name, icon);
+	library_load(tab);
+
+	g_free(display_name);
+}
+
+void library_tab_open_pos(struct library_tab *tab, int pos)
+{
+	struct library_path *path;
+	int i;
+
+	library_tab_save_scroll(tab);
+
+	for (path = tab->root, i = 0; path; path = path->next, i++) {
+		if (i == pos) break;
+	}
+
+	if (!path) {
+		return;
+	}
+	tab->path = path;
+	library_load(tab);
+}
+
+void library_clicked_cb(GtkTreeView *tw, GtkTreePath *path, GtkTreeViewColumn *col, struct library_tab *tab)
+{
+	GtkTreeIter iter;
+
+	if (!gtk_tree_model_get_iter(GTK_TREE_MODEL(tab->store), &iter, path)) {
+		MSG_WARNING("library dir item vanished");
+		return;
+	}
+
+	if (tab->searching) {
+		library_add(tab, iter);
+		return;
+	}
+
+	library_tab_open_dir(tab, iter);
+}
+
+gboolean library_child_type(enum listing_type parent, enum mpd_entity_type mpdtype, enum listing_type *type)
+{
+	switch (parent) {
+	case LIBRARY_FS:
+		if (mpdtype == MPD_ENTITY_TYPE_DIRECTORY) {
+			*type = LIBRARY_FS;
+		} else if (mpdtype == MPD_ENTITY_TYPE_PLAYLIST) {
+			*type = LIBRARY_PLAYLISTSONG;
+		} else {
+			return FALSE;
+		}
+		break;
+	case LIBRARY_PLAYLIST:
+		*type = LIBRARY_PLAYLISTSONG;
+		break;
+	case LIBRARY_SONG:
+	case LIBRARY_PLAYLISTSONG:
+		/* TODO: Add item to playlist instead */
+		return FALSE;
+	default:
+		*type = parent + 1;
+		break;
+	}
+
+	return TRUE;
+}
+
+struct library_path *library_path_open(struct library_path *parent, const char *name, enum mpd_entity_type mpdtype)
+{
+	struct library_path *path;
+	enum listing_type type;
+
+	g_assert(parent != NULL);
+	g_assert(name != NULL);
+
+	MSG_DEBUG("library_path_open(): %s", name);
+
+	if (!library_child_type(parent->type, mpdtype, &type)) {
+		return NULL;
+	}
+
+	path = g_malloc(sizeof(struct library_path));
+	path->type = type;
+	path->parent = parent;
+	path->next = NULL;
+	path->name = g_strdup(name);
+	path->selected = NULL;
+	path->pos = NULL;
+
+	if (!path) {
+		return NULL;
+	}
+
+	if (parent->next) {
+		library_path_free_all(parent->next);
+	}
+
+	parent->next = path;
+
+	return path;
+}
+
+gchar *library_path_get_uri(const struct library_path *root, const struct library_path *path)
+{
+	GString *uri;
+	const struct library_path *cur;
+
+	if (root->type > LIBRARY_GENRE) {
+		return NULL;
+	}
+
+	uri = g_string_new(NULL);
+	for (cur = root; cur && cur != path->next; cur = cur->next) {
+		if (cur->type == LIBRARY_PLAYLIST) {
+			continue;
+		}
+		if (strlen(uri->str) > 0) {
+			g_string_append(uri, "/");
+		}
+		g_string_append(uri, cur->name);
+	}
+
+	return g_string_free(uri, FALSE);
+}
+
+void library_selector_activate(GtkMenuItem *item, gpointer data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	gint type = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(item), "listing"));
+
+	library_set_listing(tab, type);
+	library_load(tab);
+}
+
+GtkWidget *library_selector_menu(struct library_tab *tab)
+{
+	GtkWidget *menu;
+	GtkWidget *item;
+	int i;
+
+	menu = gtk_menu_new();
+
+	for (i = LIBRARY_PLAYLIST; i < LIBRARY_SONG; i++) {
+		item = gtk_menu_item_new_with_label(listing_labels(i));
+		g_object_set_data(G_OBJECT(item), "listing", GINT_TO_POINTER(i));
+		g_signal_connect(G_OBJECT(item), "activate", G_CALLBACK(library_selector_activate), tab);
+		gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+	}
+
+	gtk_widget_show_all(menu);
+
+	return menu;
+}
+
+struct library_selected_call {
+	struct library_tab *tab;
+	gboolean (*row_func)(struct library_tab *, GtkTreeIter);
+	gboolean retval;
+};
+
+void library_process_row(GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	struct library_selected_call *call = (struct library_selected_call *) data;
+
+	if (!call->row_func(call->tab, *iter)) {
+		call->retval = FALSE;
+	}
+}
+
+gboolean library_process_selected(struct library_tab *tab, gboolean (*row_func)(struct library_tab *, GtkTreeIter))
+{
+	struct library_selected_call call;
+
+	call.tab = tab;
+	call.row_func = row_func;
+	call.retval = TRUE;
+
+	sel_tracker_foreach(&tab->selection, GTK_TREE_MODEL(tab->store), library_process_row, &call);
+
+	return call.retval;
+}
+
+void library_selection_changed(GtkTreeSelection *selection, gpointer data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	GtkTreeView *tw;
+	GtkTreePath *cursor;
+
+	/* the cursor row is likely to be opened next */
+	gtk_tree_view_get_cursor(gtk_tree_selection_get_tree_view(selection), &cursor, NULL);
+	if (cursor) {
+		library_prefetch_schedule(tab, cursor);
+		gtk_tree_path_free(cursor);
+	}
+
+	if (!sel_tracker_changed(&tab->selection)) {
+		/* selection is still empty or still non-empty */
+		return;
+	}
+
+	tw = gtk_tree_selection_get_tree_view(selection);
+
+	if (!sel_tracker_is_empty(&tab->selection)) {
+		gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected", G_ACTION_GROUP(tab->selected_actions));
+		if (tab->searching) {
+			/* only songs are found */
+		} else if (tab->path->type == LIBRARY_FS) {
+			gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected-fs", G_ACTION_GROUP(tab->selected_fs_actions));
+		} else if (tab->path->type == LIBRARY_PLAYLIST) {
+			gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected-pl", G_ACTION_GROUP(tab->selected_pl_actions));
+		}
+	} else {
+		/* nothing selected */
+		gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected", NULL);
+		gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected-fs", NULL);
+		gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected-pl", NULL);
+	}
+}
+
+void library_add_action(GSimpleAction *action, GVariant *param, gpointer data)
+{
+	MSG_INFO("Add action activated");
+
+	library_process_selected((struct library_tab *) data, library_add);
+}
+
+void library_replace_action(GSimpleAction *action, GVariant *param, gpointer data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+
+	MSG_INFO("Replace action activated");
+
+	mpd_send(tab->mpdsource, MPD_CMD_CLEAR, NULL);
+	library_process_selected(tab, library_add);
+}
+
+gboolean library_update_row(struct library_tab *tab, GtkTreeIter iter)
+{
+	gchar *uri;
+	gboolean success = TRUE;
+
+	gtk_tree_model_get(GTK_TREE_MODEL(tab->store), &iter, LIB_COL_URI, &uri, -1);
+	if (uri) {
+		success = mpd_send(tab->mpdsource, MPD_CMD_UPDATE, uri, NULL);
+		g_free(uri);
+	}
+
+	return success;
+}
+
+void library_update_action(GSimpleAction *action, GVariant *param, gpointer data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+
+	g_assert(tab->path->type == LIBRARY_FS);
+
+	library_process_selected(tab, library_update_row);
+}
+
+gboolean library_delete_playlist(struct library_tab *tab, GtkTreeIter iter)
+{
+	gchar *uri;
+	gboolean success;
+
+	gtk_tree_model_get(GTK_TREE_MODEL(tab->store), &iter, LIB_COL_URI, &uri, -1);
+	success = mpd_send(tab->mpdsource, MPD_CMD_RM, uri, NULL);
+	g_free(uri);
+
+	return success;
+}
+
+void library_delete_action(GSimpleAction *action, GVariant *param, gpointer data)
+{
+	MSG_INFO("Delete action activated");
+
+	library_process_selected(data, library_delete_playlist);
+}
+
+void library_set_busy(struct library_tab *tab, gboolean busy)
+{
+	GObject *spinner;
+	GObject *tw;
+
+	spinner = gtk_builder_get_object(tab->ui, "spinner");
+	g_object_set(spinner, "active", busy, NULL);
+
+	tw = gtk_builder_get_object(tab->ui, "tw");
+	gtk_widget_set_sensitive(GTK_WIDGET(tw), !busy);
+}
+
+void library_select(struct library_tab *tab, GtkTreeIter *iter)
+{
+	GObject *tw;
+	GtkTreeSelection *select;
+
+	tw = gtk_builder_get_object(tab->ui, "tw");
+	select = gtk_tree_view_get_selection(GTK_TREE_VIEW(tw));
+
+	gtk_tree_selection_select_iter(select, iter);
+}
+
+gboolean library_motion_cb(GtkWidget *tw, GdkEventMotion *event, gpointer data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	GtkTreePath *path;
+
+	if (!gtk_tree_view_get_path_at_pos(GTK_TREE_VIEW(tw), event->x, event->y, &path, NULL, NULL, NULL)) {
+		return FALSE;
+	}
+
+	if (!tab->prefetch_row || gtk_tree_path_compare(path, tab->prefetch_row)) {
+		library_prefetch_schedule(tab, path);
+	}
+	gtk_tree_path_free(path);
+
+	return FALSE;
+}
+
+static gboolean library_prefetch_timeout(gpointer data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+
+	tab->prefetch_timer = 0;
+	if (!library_prefetch(tab) && tab->prefetch_row && tab->mpdsource &&
+	    !mpd_source_is_idle(tab->mpdsource)) {
+		/* try again when the connection is free */
+		tab->prefetch_timer = g_timeout_add(LIBRARY_PREFETCH_DELAY, library_prefetch_timeout, tab);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+void library_prefetch_schedule(struct library_tab *tab, GtkTreePath *row)
+{
+	library_prefetch_cancel_scheduled(tab);
+
+	tab->prefetch_row = gtk_tree_path_copy(row);
+	tab->prefetch_timer = g_timeout_add(LIBRARY_PREFETCH_DELAY, library_prefetch_timeout, tab);
+}
+
+/**
+  @brief Send command listing a child of the current listing unless it is
+  already known.
+  @returns TRUE when a command was sent.
+  */
+static gboolean library_prefetch_send(struct library_tab *tab, const struct library_path *child, const gchar *uri)
+{
+	const gchar *args[LIBRARY_LISTING_MAX_ARGS + 1];
+	struct listing_entry *entry;
+	enum mpd_cmd_type cmd;
+	gchar *key;
+	gint i;
+
+	/* the local copy of the database answers at once anyway */
+	if (tab->cache_valid && child->type != LIBRARY_PLAYLIST && child->type != LIBRARY_PLAYLISTSONG) {
+		return FALSE;
+	}
+
+	key = library_listing_key(child);
+	entry = listing_cache_lookup(&tab->listings, key);
+	cmd = library_listing_command(child, uri, args);
+	if ((entry && !entry->stale) || cmd == MPD_CMD_NONE) {
+		g_free(key);
+		return FALSE;
+	}
+
+	MSG_DEBUG("prefetching listing of %s", child->name);
+	if (!mpd_send(tab->mpdsource, cmd, args[0], args[1], args[2], args[3], args[4], NULL)) {
+		g_free(key);
+		return FALSE;
+	}
+
+	tab->prefetch.cmd = cmd;
+	for (i = 0; args[i]; i++) {
+		tab->prefetch.args = g_list_append(tab->prefetch.args, g_strdup(args[i]));
+	}
+	tab->prefetch.key = key;
+	tab->prefetch.type = child->type;
+	tab->prefetch.open = FALSE;
+
+	return TRUE;
+}
+
+gboolean library_prefetch(struct library_tab *tab)
+{
+	struct library_path child;
+	enum mpd_entity_type mpdtype;
+	GtkTreeIter iter;
+	gchar *display;
+	gchar *name;
+	gchar *uri;
+	gboolean retval = FALSE;
+
+	if (!tab->mpdsource || tab->searching || !tab->prefetch_row || tab->prefetch.cmd != MPD_CMD_NONE ||
+	    tab->prefetch_bytes >= LIBRARY_PREFETCH_BUDGET) {
+		return FALSE;
+	}
+
+	/* a prefetch must never be queued before a command the user waits for */
+	if (!mpd_source_is_idle(tab->mpdsource)) {
+		return FALSE;
+	}
+
+	if (!gtk_tree_model_get_iter(GTK_TREE_MODEL(tab->store), &iter, tab->prefetch_row)) {
+		return FALSE;
+	}
+
+	gtk_tree_model_get(GTK_TREE_MODEL(tab->store), &iter,
+			LIB_COL_DISPLAY_NAME, &display,
+			LIB_COL_NAME, &name,
+			LIB_COL_URI, &uri,
+			LIB_COL_TYPE, &mpdtype, -1);
+	if (!name) {
+		name = display;
+		display = NULL;
+	}
+
+	child.parent = tab->path;
+	child.next = NULL;
+	child.name = name;
+	child.selected = NULL;
+	child.pos = NULL;
+
+	if (library_child_type(tab->path->type, mpdtype, &child.type)) {
+		retval = library_prefetch_send(tab, &child, uri);
 	}
 
-	sonatina_path_bar_open(tab->pathbar, display_name, icon);
-	library_load(tab);
+	g_free(display);
+	g_free(name);
+	g_free(uri);
 
-	g_free(display_name);
+	return retval;
 }
 
-void library_tab_open_pos(struct library_tab *tab, int pos)
+void library_prefetch_cancel_scheduled(struct library_tab *tab)
 {
-	struct library_path *path;
-	int i;
+	if (tab->prefetch_timer) {
+		g_source_remove(tab->prefetch_timer);
+		tab->prefetch_timer = 0;
+	}
+	if (tab->prefetch_row) {
+		gtk_tree_path_free(tab->prefetch_row);
+		tab->prefetch_row = NULL;
+	}
+}
 
-	library_tab_save_scroll(tab);
+void library_prefetch_cancel(struct library_tab *tab)
+{
+	library_prefetch_cancel_scheduled(tab);
+	library_prefetch_clear(tab);
+}
 
-	for (path = tab->root, i = 0; path; path = path->next, i++) {
-		if (i == pos) break;
+static gboolean library_index_step(gpointer data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+
+	if (!lib_index_step(tab->index, LIBRARY_INDEX_STEP)) {
+		return G_SOURCE_CONTINUE;
 	}
 
-	if (!path) {
-		return;
+	tab->index_source = 0;
+	if (tab->searching) {
+		library_search_run(tab);
 	}
-	tab->path = path;
-	library_load(tab);
+
+	return G_SOURCE_REMOVE;
 }
 
-void library_clicked_cb(GtkTreeView *tw, GtkTreePath *path, GtkTreeViewColumn *col, struct library_tab *tab)
+void library_index_start(struct library_tab *tab)
 {
-	GtkTreeIter iter;
+	library_index_stop(tab);
 
-	if (!gtk_tree_model_get_iter(GTK_TREE_MODEL(tab->store), &iter, path)) {
-		MSG_WARNING("library dir item vanished");
-		return;
-	}
+	tab->index = lib_index_new(tab->cache);
+	/* below redrawing and input */
+	tab->index_source = g_idle_add_full(G_PRIORITY_LOW, library_index_step, tab, NULL);
+}
 
-	library_tab_open_dir(tab, iter);
+void library_index_stop(struct library_tab *tab)
+{
+	if (tab->index_source) {
+		g_source_remove(tab->index_source);
+		tab->index_source = 0;
+	}
+	lib_index_free(tab->index);
+	tab->index = NULL;
 }
 
-struct library_path *library_path_open(struct library_path *parent, const char *name, enum mpd_entity_type mpdtype)
+static gboolean library_search_timeout(gpointer data)
 {
-	struct library_path *path;
-	enum listing_type type;
+	struct library_tab *tab = (struct library_tab *) data;
 
-	g_assert(parent != NULL);
-	g_assert(name != NULL);
+	tab->search_timer = 0;
+	library_search_run(tab);
 
-	MSG_DEBUG("library_path_open(): %s", name);
+	return G_SOURCE_REMOVE;
+}
 
-	switch (parent->type) {
-	case LIBRARY_FS:
-		if (mpdtype == MPD_ENTITY_TYPE_DIRECTORY) {
-			type = LIBRARY_FS;
-		} else if (mpdtype == MPD_ENTITY_TYPE_PLAYLIST) {
-			type = LIBRARY_PLAYLISTSONG;
-		} else {
-			return NULL;
-		}
-		break;
-	case LIBRARY_PLAYLIST:
-		type = LIBRARY_PLAYLISTSONG;
-		break;
-	case LIBRARY_SONG:
-	case LIBRARY_PLAYLISTSONG:
-		/* TODO: Add item to playlist instead */
-		return NULL;
-		break;
-	default:
-		type = parent->type + 1;
+static void library_search_cancel_scheduled(struct library_tab *tab)
+{
+	if (tab->search_timer) {
+		g_source_remove(tab->search_timer);
+		tab->search_timer = 0;
 	}
+}
 
-	path = g_malloc(sizeof(struct library_path));
-	path->type = type;
-	path->parent = parent;
-	path->next = NULL;
-	path->name = g_strdup(name);
-	path->selected = NULL;
-	path->pos = NULL;
+void library_search_changed(GtkSearchEntry *entry, gpointer data)
+{
+	struct library_tab *tab = (struct library_tab *) data;
+	const gchar *text;
 
-	if (!path) {
-		return NULL;
+	text = gtk_entry_get_text(GTK_ENTRY(entry));
+
+	if (!text[0]) {
+		if (tab->searching) {
+			library_search_leave(tab);
+			library_load(tab);
+		}
+		return;
 	}
 
-	if (parent->next) {
-		library_path_free_all(parent->next);
+	if (!tab->searching) {
+		library_tab_save_scroll(tab);
+		library_prefetch_cancel_scheduled(tab);
+		tab->searching = TRUE;
+		/* results are ordered by relevance */
+		gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(tab->store),
+				GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
 	}
 
-	parent->next = path;
+	g_free(tab->query);
+	tab->query = g_strdup(text);
 
-	return path;
+	library_search_cancel_scheduled(tab);
+	if (tab->index) {
+		library_search_run(tab);
+	} else {
+		/* don't make the server search for every keystroke */
+		tab->search_timer = g_timeout_add(LIBRARY_SEARCH_DELAY, library_search_timeout, tab);
+	}
 }
 
-gchar *library_path_get_uri(const struct library_path *root, const struct library_path *path)
+/**
+  @brief Build a filter expression matching songs with all words of a query in
+  any tag.
+  @returns Newly allocated expression or NULL if the query has no words.
+  */
+static gchar *library_search_expression(const gchar *query)
 {
-	GString *uri;
-	const struct library_path *cur;
-
-	if (root->type > LIBRARY_GENRE) {
-		return NULL;
-	}
-
-	uri = g_string_new(NULL);
-	for (cur = root; cur && cur != path->next; cur = cur->next) {
-		if (cur->type == LIBRARY_PLAYLIST) {
+	GString *expr;
+	gchar **words;
+	const gchar *c;
+	guint n = 0;
+	guint i;
+
+	expr = g_string_new(NULL);
+	words = g_strsplit_set(query, " \t", -1);
+	for (i = 0; words[i]; i++) {
+		if (!words[i][0]) {
 			continue;
 		}
-		if (strlen(uri->str) > 0) {
-			g_string_append(uri, "/");
+		if (n++ > 0) {
+			g_string_append(expr, " AND ");
 		}
-		g_string_append(uri, cur->name);
+		g_string_append(expr, "(any contains \"");
+		for (c = words[i]; *c; c++) {
+			if (*c == '"' || *c == '\\') {
+				g_string_append_c(expr, '\\');
+			}
+			g_string_append_c(expr, *c);
+		}
+		g_string_append(expr, "\")");
 	}
+	g_strfreev(words);
 
-	return g_string_free(uri, FALSE);
+	if (n == 0) {
+		g_string_free(expr, TRUE);
+		return NULL;
+	}
+	if (n > 1) {
+		g_string_prepend_c(expr, '(');
+		g_string_append_c(expr, ')');
+	}
+
+	return g_string_free(expr, FALSE);
 }
 
-void library_selector_activate(GtkMenuItem *item, gpointer data)
+/**
+  @brief Request next window of results from the server.
+  */
+static void library_search_send(struct library_tab *tab)
 {
-	struct library_tab *tab = (struct library_tab *) data;
-	gint type = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(item), "listing"));
+	gchar window[32];
 
-	library_set_listing(tab, type);
-	library_load(tab);
+	g_snprintf(window, sizeof(window), "%u:%u", tab->search_loaded, tab->search_loaded + LIBRARY_SEARCH_WINDOW);
+	tab->search_pending = mpd_send(tab->mpdsource, MPD_CMD_SEARCH, tab->search_expr, "window", window, NULL);
 }
 
-GtkWidget *library_selector_menu(struct library_tab *tab)
+/**
+  @brief Start searching the server for the current query. Answers to
+  previous searches are ignored when they arrive.
+  */
+static void library_search_server(struct library_tab *tab)
 {
-	GtkWidget *menu;
-	GtkWidget *item;
-	int i;
-
-	menu = gtk_menu_new();
-
-	for (i = LIBRARY_PLAYLIST; i < LIBRARY_SONG; i++) {
-		item = gtk_menu_item_new_with_label(listing_labels(i));
-		g_object_set_data(G_OBJECT(item), "listing", GINT_TO_POINTER(i));
-		g_signal_connect(G_OBJECT(item), "activate", G_CALLBACK(library_selector_activate), tab);
-		gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+	g_free(tab->search_expr);
+	tab->search_expr = library_search_expression(tab->query);
+	tab->search_loaded = 0;
+	tab->search_more = FALSE;
+	tab->search_pending = FALSE;
+
+	if (!tab->search_expr || !tab->mpdsource) {
+		gtk_list_store_clear(tab->store);
+		library_set_busy(tab, FALSE);
+		return;
 	}
 
-	gtk_widget_show_all(menu);
-
-	return menu;
+	MSG_DEBUG("searching server for %s", tab->search_expr);
+	library_set_busy(tab, TRUE);
+	library_search_send(tab);
 }
 
-gboolean library_process_selected(struct library_tab *tab, gboolean (*row_func)(struct library_tab *, GtkTreeIter))
+void library_search_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
 {
+	struct library_tab *tab = (struct library_tab *) data;
+	const gchar *window;
 	GObject *tw;
-	GtkTreeSelection *selection;
-	GtkTreeModel *model;
-	GtkTreeIter iter;
-	GList *rows;
 	GList *cur;
-	gboolean retval = TRUE;
+	guint n = 0;
 
-	tw = gtk_builder_get_object(tab->ui, "tw");
-	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(tw));
-	rows = gtk_tree_selection_get_selected_rows(selection, &model);
+	if (!tab->searching || !tab->search_pending || !args || g_strcmp0(args->data, tab->search_expr)) {
+		MSG_DEBUG("dropping results of an old search");
+		return;
+	}
 
-	for (cur = rows; cur; cur = cur->next) {
-		if (!gtk_tree_model_get_iter(model, &iter, cur->data)) {
-			continue;
-		}
-		row_func(tab, iter);
+	window = g_list_nth_data(args, 2);
+	if (!window || g_ascii_strtoull(window, NULL, 10) != tab->search_loaded) {
+		return;
+	}
+
+	if (tab->search_loaded == 0) {
+		gtk_list_store_clear(tab->store);
+		tw = gtk_builder_get_object(tab->ui, "tw");
+		gtk_tree_view_scroll_to_point(GTK_TREE_VIEW(tw), -1, 0);
 	}
 
-	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+	for (cur = answer->lsinfo.list; cur; cur = cur->next) {
+		library_model_append_entity(tab, cur->data);
+		n++;
+	}
 
-	return retval;
+	tab->search_loaded += n;
+	tab->search_more = n == LIBRARY_SEARCH_WINDOW;
+	tab->search_pending = FALSE;
+	library_set_busy(tab, FALSE);
 }
 
-void library_selection_changed(GtkTreeSelection *selection, gpointer data)
+void library_search_scrolled(GtkAdjustment *adjustment, gpointer data)
 {
 	struct library_tab *tab = (struct library_tab *) data;
-	GtkTreeModel *model;
-	GList *rows;
-	GtkTreeView *tw;
-	GSimpleActionGroup *actions;
+	gdouble page;
 
-	tw = gtk_tree_selection_get_tree_view(selection);
-	rows = gtk_tree_selection_get_selected_rows(selection, &model);
-
-	if (rows) {
-		actions = g_simple_action_group_new();
-		g_action_map_add_action_entries(G_ACTION_MAP(actions), library_selected_actions, G_N_ELEMENTS(library_selected_actions), tab);
-		gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected", G_ACTION_GROUP(actions));
-		g_object_unref(actions);
-		if (tab->path->type == LIBRARY_FS) {
-			actions = g_simple_action_group_new();
-			g_action_map_add_action_entries(G_ACTION_MAP(actions), library_selected_fs_actions, G_N_ELEMENTS(library_selected_fs_actions), tab);
-			gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected-fs", G_ACTION_GROUP(actions));
-			g_object_unref(actions);
-		} else if (tab->path->type == LIBRARY_PLAYLIST) {
-			actions = g_simple_action_group_new();
-			g_action_map_add_action_entries(G_ACTION_MAP(actions), library_selected_pl_actions, G_N_ELEMENTS(library_selected_pl_actions), tab);
-			gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected-pl", G_ACTION_GROUP(actions));
-			g_object_unref(actions);
-		}
-	} else {
-		/* nothing selected */
-		gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected", NULL);
-		gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected-fs", NULL);
-		gtk_widget_insert_action_group(GTK_WIDGET(tw), "library-selected-pl", NULL);
+	if (!tab->searching || !tab->search_expr || !tab->search_more || tab->search_pending) {
+		return;
 	}
 
-	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+	/* ask for more while there is still a page to scroll */
+	page = gtk_adjustment_get_page_size(adjustment);
+	if (gtk_adjustment_get_value(adjustment) + 2 * page >= gtk_adjustment_get_upper(adjustment)) {
+		library_search_send(tab);
+	}
 }
 
-void library_add_action(GSimpleAction *action, GVariant *param, gpointer data)
+void library_search_run(struct library_tab *tab)
 {
-	MSG_INFO("Add action activated");
+	const struct lib_index_hit *hit;
+	struct mpd_song *song;
+	GObject *tw;
+	GArray *hits;
+	guint i;
 
-	library_process_selected((struct library_tab *) data, library_add);
+	if (!tab->index) {
+		library_search_server(tab);
+		return;
+	}
+
+	/* results of the server are replaced */
+	g_free(tab->search_expr);
+	tab->search_expr = NULL;
+
+	if (!tab->index->built) {
+		/* library_index_step() calls us again */
+		library_set_busy(tab, TRUE);
+		return;
+	}
+
+	hits = lib_index_search(tab->index, tab->query, LIBRARY_SEARCH_MAX_RESULTS);
+	MSG_DEBUG("%u songs found for '%s'", hits->len, tab->query);
+
+	gtk_list_store_clear(tab->store);
+	for (i = 0; i < hits->len; i++) {
+		hit = &g_array_index(hits, struct lib_index_hit, i);
+		song = libcache_song_new(tab->cache, &tab->cache->songs[hit->song]);
+		if (song) {
+			library_model_append_song(tab, song);
+			mpd_song_free(song);
+		}
+	}
+	g_array_free(hits, TRUE);
+
+	tw = gtk_builder_get_object(tab->ui, "tw");
+	gtk_tree_view_scroll_to_point(GTK_TREE_VIEW(tw), -1, 0);
+	library_set_busy(tab, FALSE);
 }
 
-void library_replace_action(GSimpleAction *action, GVariant *param, gpointer data)
+void library_search_leave(struct library_tab *tab)
 {
-	struct library_tab *tab = (struct library_tab *) data;
+	GObject *search;
 
-	MSG_INFO("Replace action activated");
+	tab->searching = FALSE;
+	g_free(tab->query);
+	tab->query = NULL;
+	library_search_cancel_scheduled(tab);
+	g_free(tab->search_expr);
+	tab->search_expr = NULL;
+	tab->search_pending = FALSE;
 
-	mpd_send(tab->mpdsource, MPD_CMD_CLEAR, NULL);
-	library_process_selected(tab, library_add);
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(tab->store), LIB_COL_DISPLAY_NAME, GTK_SORT_ASCENDING);
+
+	/* emits search-changed with empty text, which is ignored now */
+	search = gtk_builder_get_object(tab->ui, "search");
+	gtk_entry_set_text(GTK_ENTRY(search), "");
 }
 
-void library_update_action(GSimpleAction *action, GVariant *param, gpointer data)
+static void library_art_cb(const gchar *key, GdkPixbuf *pixbuf, gpointer data)
 {
 	struct library_tab *tab = (struct library_tab *) data;
 	GObject *tw;
-	GtkTreeSelection *select;
-	GtkTreeModel *model;
-	GtkTreeIter iter;
-	GList *rows;
-	GList *row;
+
+	/* rows are drawn again with the art from memory */
+	tw = gtk_builder_get_object(tab->ui, "tw");
+	gtk_widget_queue_draw(GTK_WIDGET(tw));
+}
+
+/**
+  Song of an album looked up in the local copy of the database.
+  */
+struct library_art_song {
+	const gchar *artist;
 	gchar *uri;
+};
 
-	g_assert(tab->path->type == LIBRARY_FS);
+static void library_art_song(const struct libcache *cache, const struct libcache_song *song, gpointer data)
+{
+	struct library_art_song *found = (struct library_art_song *) data;
+	const struct libcache_tag *tag;
+	guint32 i;
 
-	tw = gtk_builder_get_object(tab->ui, "tw");
-	select = gtk_tree_view_get_selection(GTK_TREE_VIEW(tw));
-	rows = gtk_tree_selection_get_selected_rows(select, &model);
+	if (found->uri) {
+		return;
+	}
 
-	for (row = rows; row; row = row->next) {
-		if (!gtk_tree_model_get_iter(model, &iter, row->data)) {
-			continue;
-		}
-		gtk_tree_model_get(model, &iter, LIB_COL_URI, &uri, -1);
-		if (uri) {
-			mpd_send(tab->mpdsource, MPD_CMD_UPDATE, uri, NULL);
-			g_free(uri);
+	/* albums of other artists may have the same name */
+	for (i = song->tags; i < song->tags + song->n_tags; i++) {
+		tag = &cache->tags[i];
+		if ((tag->type == MPD_TAG_ARTIST || tag->type == MPD_TAG_ALBUM_ARTIST) &&
+				!strcmp(libcache_str(cache, tag->value), found->artist)) {
+			found->uri = g_strdup(libcache_str(cache, song->uri));
+			return;
 		}
 	}
-
-	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
 }
 
-gboolean library_delete_playlist(struct library_tab *tab, GtkTreeIter iter)
+/**
+  @brief Request song counts of rows of the shown tag listing unless they are
+  remembered with the listing.
+  */
+static void library_counts_request(struct library_tab *tab)
 {
-	gchar *uri;
-	gboolean success;
+	struct listing_entry *entry;
+	const gchar *args[5];
+	const gchar *tag;
+	gint n = 0;
+	gchar *key;
+
+	tab->counts_requested = TRUE;
+
+	key = library_listing_key(tab->path);
+	entry = listing_cache_lookup(&tab->listings, key);
+	if (entry && entry->counts) {
+		tab->counts = g_hash_table_ref(entry->counts);
+		g_free(key);
+		return;
+	}
 
-	gtk_tree_model_get(GTK_TREE_MODEL(tab->store), &iter, LIB_COL_URI, &uri, -1);
-	success = mpd_send(tab->mpdsource, MPD_CMD_RM, uri, NULL);
-	g_free(uri);
+	/* filtered like library_listing_command() does */
+	switch (tab->path->type) {
+	case LIBRARY_GENRE:
+		tag = "genre";
+		break;
+	case LIBRARY_ARTIST:
+		if (tab->path->parent && tab->path->parent->type == LIBRARY_GENRE) {
+			args[n++] = "genre";
+			args[n++] = tab->path->name;
+		}
+		tag = "albumartist";
+		break;
+	default:
+		if (tab->path->parent && tab->path->parent->type == LIBRARY_ARTIST) {
+			args[n++] = "albumartist";
+			args[n++] = tab->path->name;
+		}
+		tag = "album";
+		break;
+	}
+	args[n++] = "group";
+	args[n++] = tag;
+	args[n] = NULL;
 
-	return success;
+	if (mpd_send(tab->mpdsource, MPD_CMD_COUNTSONGS, args[0], args[1], args[2], args[3], args[4], NULL)) {
+		g_queue_push_tail(&tab->count_keys, key);
+	} else {
+		g_free(key);
+	}
 }
 
-void library_delete_action(GSimpleAction *action, GVariant *param, gpointer data)
+void library_info_data_func(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model,
+		GtkTreeIter *iter, gpointer data)
 {
-	MSG_INFO("Delete action activated");
+	struct library_tab *tab = (struct library_tab *) data;
+	const struct listing_count *count;
+	gchar *display;
+	gchar *name;
+	gchar *text = NULL;
 
-	library_process_selected(data, library_delete_playlist);
-}
+	if (tab->searching || !tab->path || !tab->mpdsource || !library_is_tag_listing(tab->path->type)) {
+		g_object_set(G_OBJECT(cell), "text", NULL, NULL);
+		return;
+	}
 
-void library_set_busy(struct library_tab *tab, gboolean busy)
-{
-	GObject *spinner;
-	GObject *tw;
+	/* only listings that are actually drawn are counted */
+	if (!tab->counts && !tab->counts_requested) {
+		library_counts_request(tab);
+	}
 
-	spinner = gtk_builder_get_object(tab->ui, "spinner");
-	g_object_set(spinner, "active", busy, NULL);
+	if (tab->counts) {
+		gtk_tree_model_get(model, iter, LIB_COL_DISPLAY_NAME, &display, LIB_COL_NAME, &name, -1);
+		count = g_hash_table_lookup(tab->counts, name ? name : display);
+		if (count && count->playtime >= 3600) {
+			text = g_strdup_printf(_("%u songs, %u:%.2u:%.2u"), count->songs,
+					count->playtime / 3600, count->playtime / 60 % 60, count->playtime % 60);
+		} else if (count) {
+			text = g_strdup_printf(_("%u songs, %u:%.2u"), count->songs,
+					count->playtime / 60, count->playtime % 60);
+		}
+		g_free(display);
+		g_free(name);
+	}
 
-	tw = gtk_builder_get_object(tab->ui, "tw");
-	gtk_widget_set_sensitive(GTK_WIDGET(tw), !busy);
+	g_object_set(G_OBJECT(cell), "text", text, NULL);
+	g_free(text);
 }
 
-void library_select(struct library_tab *tab, GtkTreeIter *iter)
+void library_icon_data_func(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model,
+		GtkTreeIter *iter, gpointer data)
 {
-	GObject *tw;
-	GtkTreeSelection *select;
+	struct library_tab *tab = (struct library_tab *) data;
+	struct library_art_song found;
+	GdkPixbuf *pixbuf;
+	gchar *display;
+	gchar *name;
+	gchar *key;
 
-	tw = gtk_builder_get_object(tab->ui, "tw");
-	select = gtk_tree_view_get_selection(GTK_TREE_VIEW(tw));
+	/* albums are only known together with their artist in album listings of an artist */
+	if (tab->searching || !tab->path || tab->path->type != LIBRARY_ALBUM ||
+			!tab->path->parent || tab->path->parent->type != LIBRARY_ARTIST) {
+		return;
+	}
 
-	gtk_tree_selection_select_iter(select, iter);
-}
+	gtk_tree_model_get(model, iter, LIB_COL_DISPLAY_NAME, &display, LIB_COL_NAME, &name, -1);
+	if (name) {
+		/* unknown album */
+		g_free(display);
+		g_free(name);
+		return;
+	}
+
+	key = art_album_key(tab->path->name, display);
+	if (art_cache_lookup(sonatina.art, key, NULL, &pixbuf)) {
+		if (pixbuf) {
+			g_object_set(G_OBJECT(cell), "gicon", pixbuf, NULL);
+		}
+	} else if (!art_cache_pending(sonatina.art, key)) {
+		/* without the local copy only thumbnails on disk are shown */
+		found.artist = tab->path->name;
+		found.uri = NULL;
+		if (tab->cache_valid) {
+			libcache_find(tab->cache, LIBCACHE_ALBUM, display, library_art_song, &found);
+		}
+		art_cache_request(sonatina.art, key, found.uri, library_art_cb, tab);
+		g_free(found.uri);
+	}
 
+	g_free(key);
+	g_free(display);
+}
@@ -4,6 +4,11 @@
 #include "client.h"
 #include "core.h"
 #include "pathbar.h"
+#include "selection.h"
+#include "libcache.h"
+#include "listcache.h"
+#include "libindex.h"
+#include "tagsort.h"
 
 enum listing_type {
 	LIBRARY_PLAYLISTSONG,
@@ -34,6 +39,19 @@ struct library_path {
 	GtkTreePath *pos;
 };
 
+/**
+  Listing requested from the server before the user opened it.
+  */
+struct library_prefetch {
+	enum mpd_cmd_type cmd; /** Command that was sent or MPD_CMD_NONE if no
+				 prefetch is pending */
+	GList *args; /** Arguments of the command */
+	gchar *key; /** Key of the listing in the listing cache */
+	enum listing_type type; /** Type of the listing */
+	gboolean open; /** TRUE if the user opened the listing before the answer
+			 arrived, so it should be shown */
+};
+
 /**
   Structure derivated from struct sonatina_tab.
   */
@@ -47,8 +65,81 @@ struct library_tab {
 	struct library_path *root; /** Root of the browsed tree */
 	struct library_path *path; /** Currently opened node of the browsed tree
 				     */
+	struct sel_tracker selection; /** Selection bookkeeping of the tree view */
+	GSimpleActionGroup *selected_actions; /** Actions for any selection */
+	GSimpleActionGroup *selected_fs_actions; /** Actions for selected
+						   filesystem entries */
+	GSimpleActionGroup *selected_pl_actions; /** Actions for selected stored
+						   playlists */
+	struct song_format *format; /** Compiled format of song rows */
+	GString *fmtbuf; /** Buffer for formatting song rows */
+	struct libcache *cache; /** Local copy of the database or NULL */
+	gboolean cache_valid; /** TRUE if the local copy matches the database */
+	guint64 db_update; /** Database update time the local copy is being
+			     built for */
+	struct libcache_builder *builder; /** Local copy being built or NULL */
+	GQueue build_dirs; /** Directories still to be listed for the local
+			     copy being built */
+	guint build_serial; /** Serial number of the directory listing being
+			      received for the local copy or 0 */
+	guint build_source; /** Source ID of the handler listing the next
+			      directory or 0 */
+	struct listing_cache listings; /** Recently shown listings */
+	gboolean revalidating; /** TRUE while a remembered listing is shown and
+				 the server is asked for a fresh one */
+	guint64 fingerprint; /** Fingerprint of the shown listing, see struct
+			       listing_entry, or 0 if it's unknown */
+	struct library_prefetch prefetch; /** Pending prefetch */
+	GtkTreePath *prefetch_row; /** Row whose listing should be prefetched or
+				     NULL */
+	guint prefetch_timer; /** Source ID of the prefetch timer or 0 */
+	gsize prefetch_bytes; /** Size of listings prefetched since the current
+				listing was opened */
+	struct lib_index *index; /** Search index of the local copy of the
+				   database or NULL */
+	guint index_source; /** Source ID of the idle handler building the
+			      index or 0 */
+	gboolean searching; /** TRUE when search results are shown */
+	gchar *query; /** Current search query */
+	guint search_timer; /** Source ID of the timeout sending the query to
+			      the server or 0 */
+	gchar *search_expr; /** Filter expression searched by the server or
+			      NULL when searching the index */
+	guint search_loaded; /** Number of results received from the server */
+	gboolean search_more; /** TRUE if the server may have more results */
+	gboolean search_pending; /** TRUE while a window of results is being
+				   received */
+	struct tag_sort pending; /** Tags of the listing being filled, appended
+				   in sorted order when it's complete */
+	gboolean windowed; /** TRUE if the song listing is too long to be
+			     loaded at once and is filled by windows as it's
+			     scrolled; its songs are in database order
+			     instead of sorted by display name */
+	GArray *windows; /** gboolean for every window of the windowed listing,
+			   TRUE once it's requested */
+	GHashTable *counts; /** Song counts of rows of the shown tag listing or
+			      NULL if they aren't known */
+	gboolean counts_requested; /** TRUE once counts of the shown listing
+				     were looked up */
+	GQueue count_keys; /** Keys of listings whose counts are requested, in
+			     order of the requests */
 };
 
+#define LIBRARY_LISTING_CACHE_SIZE (8 * 1024 * 1024)
+#define LIBRARY_PREFETCH_DELAY 250 /** ms a row has to stay selected or hovered */
+#define LIBRARY_PREFETCH_BUDGET (1024 * 1024)
+#define LIBRARY_LISTING_MAX_ARGS 5
+#define LIBRARY_INDEX_STEP 2000 /** Songs indexed in one main loop iteration */
+#define LIBRARY_BUILD_DELAY 100 /** ms to wait for a busy connection before
+				  listing the next directory of the database */
+#define LIBRARY_SEARCH_MAX_RESULTS 500
+#define LIBRARY_SEARCH_DELAY 300 /** Milliseconds without typing before the
+				   server is searched */
+#define LIBRARY_SEARCH_WINDOW 200 /** Results requested from the server at
+				    once */
+#define LIBRARY_LISTING_WINDOW 1000 /** Rows of song listings requested from
+				      the server at once */
+
 /**
   Columns of the list store
   */
@@ -81,6 +172,12 @@ void library_tab_set_source(struct sonatina_tab *tab, GSource *source);
   */
 void library_tab_destroy(struct sonatina_tab *tab);
 
+/**
+  @brief Catch up with database changes skipped while the tab was hidden.
+  @param tab Library tab.
+  */
+void library_tab_refresh(struct sonatina_tab *tab);
+
 /**
   @brief Set columns of library tree view.
   @param tw Tree view.
@@ -135,6 +232,53 @@ void library_list_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *a
   */
 void library_lsinfo_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
 
+/**
+  @brief Callback for count command. Remembers song counts of rows of a tag
+  listing or adds placeholder rows for the songs of a windowed listing that are
+  not loaded yet.
+  @param cmd MPD command type.
+  @param args MPD command argument list.
+  @param answer Answer to command.
+  @param data Pointer to library tab.
+  */
+void library_count_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Callback for scrolling of the list; requests windows of a windowed
+  listing that are about to be shown.
+  */
+void library_window_scrolled(GtkAdjustment *adjustment, gpointer data);
+
+/**
+  @brief Callback for stats command. Starts rebuilding local copy of the
+  database when it doesn't match the database on the server.
+  @param cmd MPD command type.
+  @param args MPD command argument list.
+  @param answer Answer to command.
+  @param data Pointer to library tab.
+  */
+void library_stats_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Callback for lsinfo commands listing the database directory by
+  directory; adds the directory to the local copy being built and writes it
+  when all directories are listed.
+  @param cmd MPD command type.
+  @param args MPD command argument list.
+  @param answer Answer to command.
+  @param data Pointer to library tab.
+  */
+void library_lsinfo_raw_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Callback for failed commands. Forgets a failed prefetch.
+  @param cmd MPD command type.
+  @param args MPD command argument list.
+  @param answer NULL.
+  @param data Pointer to library tab.
+  */
+void library_error_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
 /**
   @brief Callback for idle command; calls @a library_load() when a
   MPD_CHANGED_DB bit is set.
@@ -167,6 +311,123 @@ void library_set_listing(struct library_tab *tab, enum listing_type listing);
   */
 gboolean library_load(struct library_tab *tab);
 
+/**
+  @brief Fill library tab from local copy of the database instead of asking the
+  server.
+  @param tab Library tab with valid local copy.
+  @returns TRUE if the listing was filled, FALSE if it has to be requested from
+  the server.
+  */
+gboolean library_load_cached(struct library_tab *tab);
+
+/**
+  @brief Get key identifying a listing in the listing cache.
+  @param path Path node of the listing.
+  @returns Newly allocated string that should be freed with g_free().
+  */
+gchar *library_listing_key(const struct library_path *path);
+
+/**
+  @brief Remember the currently shown listing.
+  @param tab Library tab.
+  */
+void library_listing_remember(struct library_tab *tab);
+
+/**
+  @brief Show a remembered listing.
+  @param tab Library tab.
+  @param entry Remembered listing.
+  */
+void library_listing_show(struct library_tab *tab, const struct listing_entry *entry);
+
+/**
+  @brief Prefetch listing of a row after a short delay unless another row is
+  scheduled in the meantime.
+  @param tab Library tab.
+  @param row Row of the current listing.
+  */
+void library_prefetch_schedule(struct library_tab *tab, GtkTreePath *row);
+
+/**
+  @brief Request listing of the scheduled row from the server if the server is
+  idle, nothing else is being prefetched and the budget is not exhausted.
+  @param tab Library tab.
+  @returns TRUE when a command was sent.
+  */
+gboolean library_prefetch(struct library_tab *tab);
+
+/**
+  @brief Cancel scheduled prefetch but keep waiting for the pending one.
+  @param tab Library tab.
+  */
+void library_prefetch_cancel_scheduled(struct library_tab *tab);
+
+/**
+  @brief Cancel scheduled prefetch and forget the pending one.
+  @param tab Library tab.
+  */
+void library_prefetch_cancel(struct library_tab *tab);
+
+/**
+  @brief Start building search index of the local copy of the database in
+  the background.
+  @param tab Library tab with opened local copy.
+  */
+void library_index_start(struct library_tab *tab);
+
+/**
+  @brief Stop building and free search index. Must be called before the local
+  copy it indexes is closed.
+  @param tab Library tab.
+  */
+void library_index_stop(struct library_tab *tab);
+
+/**
+  @brief Callback for search entry's 'search-changed' signal.
+  @param entry Search entry.
+  @param data Pointer to library tab.
+  */
+void library_search_changed(GtkSearchEntry *entry, gpointer data);
+
+/**
+  @brief Show results of the current query. The index of the local copy of the
+  database is searched when it exists, the server otherwise.
+  @param tab Library tab in search mode.
+  */
+void library_search_run(struct library_tab *tab);
+
+/**
+  @brief Callback for answers to the search command.
+  */
+void library_search_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Callback for scrolling of the list; requests more results from the
+  server when the end of the list is near.
+  */
+void library_search_scrolled(GtkAdjustment *adjustment, gpointer data);
+
+/**
+  @brief Leave search mode; the caller should load a listing afterwards.
+  @param tab Library tab.
+  */
+void library_search_leave(struct library_tab *tab);
+
+/**
+  @brief Cell data function of the column showing song counts and playtime of
+  rows of tag listings. Counts of all rows of the listing are requested with
+  one command when the first row is drawn.
+  */
+void library_info_data_func(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model,
+		GtkTreeIter *iter, gpointer data);
+
+/**
+  @brief Cell data function of the icon column showing album art in album
+  listings of an artist. Art is requested for rows as they are drawn.
+  */
+void library_icon_data_func(GtkTreeViewColumn *column, GtkCellRenderer *cell, GtkTreeModel *model,
+		GtkTreeIter *iter, gpointer data);
+
 /**
   @brief Add item to current playlist.
   @param tab Library tab.
@@ -175,6 +436,15 @@ gboolean library_load(struct library_tab *tab);
   */
 gboolean library_add(struct library_tab *tab, GtkTreeIter iter);
 
+/**
+  @brief Get type of a listing opened from a row of another listing.
+  @param parent Type of the listing containing the row.
+  @param mpdtype MPD entity type of the row.
+  @param type Type of the opened listing.
+  @returns FALSE if the row can't be opened.
+  */
+gboolean library_child_type(enum listing_type parent, enum mpd_entity_type mpdtype, enum listing_type *type);
+
 /**
   @brief Create new path root.
   @param listing Listing type.
@@ -205,6 +475,12 @@ void library_path_free(struct library_path *path);
   */
 void library_path_free_all(struct library_path *path);
 
+/**
+  @brief Callback for motion events of the library tree view; schedules
+  prefetch of the hovered row.
+  */
+gboolean library_motion_cb(GtkWidget *tw, GdkEventMotion *event, gpointer data);
+
 /**
   @brief Callback function for library tree view.
   */
@@ -212,11 +488,19 @@ void library_clicked_cb(GtkTreeView *tw, GtkTreePath *path, GtkTreeViewColumn *c
 
 /**
   @brief Append an item specified by libmpd's entity to library list.
-  @param model Gtk list store used as model for tree view.
+  @param tab Library tab.
   @param entity MPD entity.
   @returns GtkTreeIter pointing to the added item.
   */
-GtkTreeIter library_model_append_entity(GtkListStore *model, const struct mpd_entity *entity);
+GtkTreeIter library_model_append_entity(struct library_tab *tab, const struct mpd_entity *entity);
+
+/**
+  @brief Append a song to library list.
+  @param tab Library tab.
+  @param song MPD song.
+  @returns GtkTreeIter pointing to the added item.
+  */
+GtkTreeIter library_model_append_song(struct library_tab *tab, const struct mpd_song *song);
 
 /**
   @brief Append an item specified by type and name to library list.
@@ -227,6 +511,15 @@ GtkTreeIter library_model_append_entity(GtkListStore *model, const struct mpd_en
   */
 GtkTreeIter library_model_append(GtkListStore *model, enum listing_type type, const char *name, const char *uri, enum mpd_entity_type mpdtype);
 
+/**
+  @brief Set an item of library list, like @a library_model_append() does.
+  @param model GTK list store used as model for tree view.
+  @param iter Item to set.
+  @param type Type of the item.
+  @param name Name of the item.
+  */
+void library_model_set(GtkListStore *model, GtkTreeIter *iter, enum listing_type type, const char *name, const char *uri, enum mpd_entity_type mpdtype);
+
 /**
   @brief Get path string for given path. This string doesn't begin with slash to
   be compatible with MPD lsinfo command.
@@ -266,10 +559,61 @@ void library_add_action(GSimpleAction *action, GVariant *param, gpointer data);
   */
 void library_replace_action(GSimpleAction *action, GVariant *param, gpointer data);
 
+/**
+  @brief Send database update command for a single filesystem entry.
+  @param tab Library tab.
+  @param iter Iterator pointing at the entry.
+  @returns TRUE when the command was successfully sent.
+  */
+gboolean library_update_row(struct library_tab *tab, GtkTreeIter iter);
+
 void library_update_action(GSimpleAction *action, GVariant *param, gpointer data);
 
 void library_delete_action(GSimpleAction *action, GVariant *param, gpointer data);
 
+/**
+  @brief Settings callback called when library format is changed.
+  @param value New format.
+  @param data Settings entry that changed.
+  */
+void library_format_changed(union settings_value value, void *data);
+
+/**
+  @brief Settings callback called when local copy of the database is enabled or
+  disabled.
+  @param value New value.
+  @param data Settings entry that changed.
+  */
+void library_cache_changed(union settings_value value, void *data);
+
+/**
+  @brief Ask the server for the shown listing again without clearing it. When
+  the answer arrives, the list is left alone if the listing didn't change and
+  only changed rows are updated otherwise.
+  @param tab Library tab.
+  @returns TRUE if the listing was requested.
+  */
+gboolean library_revalidate(struct library_tab *tab);
+
+/**
+  @brief Callback for changes of tag listing order settings and of loading
+  albums of all artists at once.
+  */
+void library_sort_changed(union settings_value value, void *data);
+
+/**
+  @brief Open local copy of the database of the connected profile and check
+  whether it is up to date.
+  @param tab Library tab.
+  */
+void library_cache_open(struct library_tab *tab);
+
+/**
+  @brief Close local copy of the database.
+  @param tab Library tab.
+  */
+void library_cache_close(struct library_tab *tab);
+
 void library_set_busy(struct library_tab *tab, gboolean busy);
 
 void library_select(struct library_tab *tab, GtkTreeIter *iter);
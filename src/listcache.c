@@ -0,0 +1,186 @@
+#include <string.h>
+#include <glib.h>
+
+#include "listcache.h"
+#include "util.h"
+
+#define LISTING_FNV_OFFSET G_GUINT64_CONSTANT(14695981039346656037)
+#define LISTING_FNV_PRIME G_GUINT64_CONSTANT(1099511628211)
+
+/**
+  @brief Mix bytes into a 64-bit FNV-1a hash.
+  */
+static guint64 listing_fnv(guint64 hash, const void *data, gsize len)
+{
+	const guchar *p = data;
+	gsize i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= LISTING_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static void listing_entry_free(gpointer data)
+{
+	struct listing_entry *entry = (struct listing_entry *) data;
+	struct listing_row *row;
+	guint i;
+
+	for (i = 0; i < entry->rows->len; i++) {
+		row = &g_array_index(entry->rows, struct listing_row, i);
+		g_free(row->name);
+		g_free(row->uri);
+	}
+	g_array_free(entry->rows, TRUE);
+	if (entry->counts) {
+		g_hash_table_unref(entry->counts);
+	}
+	g_free(entry->key);
+	g_free(entry);
+}
+
+/**
+  @brief Unlink entry from the LRU queue and the table and free it.
+  */
+static void listing_cache_remove(struct listing_cache *cache, struct listing_entry *entry)
+{
+	g_queue_unlink(&cache->lru, &entry->link);
+	cache->size -= entry->size;
+	/* the table owns entries */
+	g_hash_table_remove(cache->entries, entry->key);
+}
+
+void listing_cache_init(struct listing_cache *cache, gsize max_size)
+{
+	cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, listing_entry_free);
+	g_queue_init(&cache->lru);
+	cache->size = 0;
+	cache->max_size = max_size;
+}
+
+void listing_cache_free(struct listing_cache *cache)
+{
+	listing_cache_clear(cache);
+	g_hash_table_destroy(cache->entries);
+}
+
+void listing_cache_clear(struct listing_cache *cache)
+{
+	g_queue_init(&cache->lru);
+	g_hash_table_remove_all(cache->entries);
+	cache->size = 0;
+}
+
+void listing_cache_invalidate(struct listing_cache *cache)
+{
+	GList *cur;
+
+	for (cur = cache->lru.head; cur; cur = cur->next) {
+		((struct listing_entry *) cur->data)->stale = TRUE;
+	}
+}
+
+struct listing_entry *listing_cache_lookup(struct listing_cache *cache, const gchar *key)
+{
+	struct listing_entry *entry;
+
+	entry = g_hash_table_lookup(cache->entries, key);
+	if (entry) {
+		g_queue_unlink(&cache->lru, &entry->link);
+		g_queue_push_head_link(&cache->lru, &entry->link);
+	}
+
+	return entry;
+}
+
+struct listing_entry *listing_entry_new(const gchar *key)
+{
+	struct listing_entry *entry;
+
+	entry = g_malloc(sizeof(struct listing_entry));
+	entry->key = g_strdup(key);
+	entry->rows = g_array_new(FALSE, FALSE, sizeof(struct listing_row));
+	entry->size = sizeof(struct listing_entry) + strlen(key) + 1;
+	entry->stale = FALSE;
+	entry->counts = NULL;
+	entry->fingerprint = LISTING_FNV_OFFSET;
+	entry->link.data = entry;
+	entry->link.prev = NULL;
+	entry->link.next = NULL;
+
+	return entry;
+}
+
+void listing_entry_append(struct listing_entry *entry, const gchar *name, const gchar *uri, gint mpdtype)
+{
+	struct listing_row row;
+
+	row.name = g_strdup(name);
+	row.uri = g_strdup(uri);
+	row.mpdtype = mpdtype;
+	g_array_append_val(entry->rows, row);
+
+	/* terminating zeros keep "ab" + "c" apart from "a" + "bc" */
+	entry->fingerprint = listing_fnv(entry->fingerprint, name ? name : "", name ? strlen(name) + 1 : 1);
+	entry->fingerprint = listing_fnv(entry->fingerprint, uri ? uri : "", uri ? strlen(uri) + 1 : 1);
+	entry->fingerprint = listing_fnv(entry->fingerprint, &mpdtype, sizeof(mpdtype));
+
+	entry->size += sizeof(struct listing_row) + (name ? strlen(name) + 1 : 0) + (uri ? strlen(uri) + 1 : 0);
+}
+
+void listing_cache_insert(struct listing_cache *cache, struct listing_entry *entry)
+{
+	struct listing_entry *old;
+
+	old = g_hash_table_lookup(cache->entries, entry->key);
+	if (old) {
+		listing_cache_remove(cache, old);
+	}
+
+	if (entry->size > cache->max_size) {
+		MSG_DEBUG("listing %s is too large to be remembered", entry->key);
+		listing_entry_free(entry);
+		return;
+	}
+
+	while (cache->size + entry->size > cache->max_size) {
+		listing_cache_remove(cache, g_queue_peek_tail(&cache->lru));
+	}
+
+	g_hash_table_insert(cache->entries, entry->key, entry);
+	g_queue_push_head_link(&cache->lru, &entry->link);
+	cache->size += entry->size;
+}
+
+GHashTable *listing_counts_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+}
+
+void listing_cache_set_counts(struct listing_cache *cache, struct listing_entry *entry, GHashTable *counts)
+{
+	GHashTableIter iter;
+	gpointer name;
+	gsize size = 0;
+
+	if (entry->counts) {
+		return;
+	}
+
+	g_hash_table_iter_init(&iter, counts);
+	while (g_hash_table_iter_next(&iter, &name, NULL)) {
+		size += sizeof(struct listing_count) + strlen(name) + 1;
+	}
+
+	entry->counts = g_hash_table_ref(counts);
+	entry->size += size;
+	cache->size += size;
+
+	/* the entry itself was just used and stays */
+	while (cache->size > cache->max_size && g_queue_peek_tail(&cache->lru) != entry) {
+		listing_cache_remove(cache, g_queue_peek_tail(&cache->lru));
+	}
+}
@@ -0,0 +1,126 @@
+#ifndef LISTCACHE_H
+#define LISTCACHE_H
+
+#include <glib.h>
+
+/**
+  Single row of a remembered listing.
+  */
+struct listing_row {
+	gchar *name; /** Name the row was appended with */
+	gchar *uri; /** URI or NULL */
+	gint mpdtype; /** enum mpd_entity_type */
+};
+
+/**
+  Songs under a row of a remembered tag listing.
+  */
+struct listing_count {
+	guint songs;
+	guint playtime; /** Seconds */
+};
+
+/**
+  Remembered listing.
+  */
+struct listing_entry {
+	gchar *key; /** Key identifying the listing */
+	GArray *rows; /** struct listing_row */
+	gsize size; /** Estimated memory used by the entry */
+	gboolean stale; /** TRUE if the database changed since the listing was
+			  received */
+	GHashTable *counts; /** Maps row names to struct listing_count or NULL
+			      if they aren't known */
+	guint64 fingerprint; /** Hash of names, URIs and types of all rows; equal
+			       fingerprints mean equal listings */
+	GList link; /** Link in the LRU queue */
+};
+
+/**
+  LRU cache of listings limited by memory used by the entries.
+  */
+struct listing_cache {
+	GHashTable *entries; /** Maps keys to struct listing_entry */
+	GQueue lru; /** Entries, most recently used first */
+	gsize size; /** Estimated memory used by all entries */
+	gsize max_size; /** Limit of @a size */
+};
+
+/**
+  @brief Initialize listing cache.
+  @param cache Cache to initialize.
+  @param max_size Memory limit in bytes.
+  */
+void listing_cache_init(struct listing_cache *cache, gsize max_size);
+
+/**
+  @brief Free memory allocated by the cache.
+  @param cache Listing cache.
+  */
+void listing_cache_free(struct listing_cache *cache);
+
+/**
+  @brief Remove all entries.
+  @param cache Listing cache.
+  */
+void listing_cache_clear(struct listing_cache *cache);
+
+/**
+  @brief Mark all entries as stale. Stale entries can still be looked up.
+  @param cache Listing cache.
+  */
+void listing_cache_invalidate(struct listing_cache *cache);
+
+/**
+  @brief Find an entry and mark it as most recently used.
+  @param cache Listing cache.
+  @param key Key of the listing.
+  @returns Entry owned by the cache or NULL.
+  */
+struct listing_entry *listing_cache_lookup(struct listing_cache *cache, const gchar *key);
+
+/**
+  @brief Create a new entry that can be filled and inserted into a cache.
+  @param key Key of the listing.
+  @returns Newly allocated entry that should be passed to @a
+  listing_cache_insert().
+  */
+struct listing_entry *listing_entry_new(const gchar *key);
+
+/**
+  @brief Append a row to an entry that hasn't been inserted yet.
+  @param entry Listing entry.
+  @param name Name of the row.
+  @param uri URI of the row or NULL.
+  @param mpdtype MPD entity type of the row.
+  */
+void listing_entry_append(struct listing_entry *entry, const gchar *name, const gchar *uri, gint mpdtype);
+
+/**
+  @brief Insert an entry, replacing an entry with the same key, and evict least
+  recently used entries to stay within the memory limit.
+  @param cache Listing cache.
+  @param entry Entry created with @a listing_entry_new(); the cache takes its
+  ownership.
+  */
+void listing_cache_insert(struct listing_cache *cache, struct listing_entry *entry);
+
+/**
+  @brief Create a table of song counts of rows.
+  @returns Newly allocated table that maps row names to struct listing_count
+  and should be released with g_hash_table_unref().
+  */
+GHashTable *listing_counts_new(void);
+
+/**
+  @brief Remember song counts of rows of an inserted entry and evict least
+  recently used entries to stay within the memory limit. Counts that are
+  already known are kept.
+  @param cache Listing cache.
+  @param entry Entry owned by the cache.
+  @param counts Table created with @a listing_counts_new(); the entry takes a
+  reference.
+  */
+void listing_cache_set_counts(struct listing_cache *cache, struct listing_entry *entry, GHashTable *counts);
+
+#endif
@@ -7,6 +7,8 @@
 #include "client.h"
 #include "gui.h"
 #include "settings.h"
+#include "plcache.h"
+#include "cellrenderer.h"
 
 static GActionEntry playlist_selected_actions[] = {
 	{ "remove", playlist_remove_action, NULL, NULL, NULL }
@@ -22,6 +24,7 @@ gboolean pl_tab_init(struct sonatina_tab *tab)
 	struct pl_tab *pltab = (struct pl_tab *) tab;
 	GObject *tw;
 	GObject *menu;
+	GObject *entry;
 	GtkTreeSelection *selection;
 	gchar *format;
 
@@ -33,6 +36,20 @@ gboolean pl_tab_init(struct sonatina_tab *tab)
 	}
 
 	pltab->store = NULL;
+	pltab->columns = NULL;
+	pltab->formats = NULL;
+	pltab->fmtbuf = g_string_new(NULL);
+	pltab->filter = NULL;
+	pltab->have_version = FALSE;
+	pltab->updating = FALSE;
+	pltab->length = 0;
+	pltab->filling = FALSE;
+	pltab->fill_source = 0;
+	pltab->active = -1;
+	g_queue_init(&pltab->edits);
+	pltab->move_from = -1;
+	pltab->removed = g_array_new(FALSE, FALSE, sizeof(gint));
+	fold_buffer_init(&pltab->text);
 	format = sonatina_settings_get_string("playlist", "format");
 	pl_tab_set_format(pltab, format);
 	g_free(format);
@@ -47,9 +64,15 @@ gboolean pl_tab_init(struct sonatina_tab *tab)
 
 	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(tw));
 	gtk_tree_selection_set_mode(selection, GTK_SELECTION_MULTIPLE);
-	g_signal_connect(G_OBJECT(tw), "row-activated", G_CALLBACK(playlist_clicked_cb), NULL);
+	sel_tracker_init(&pltab->selection, selection);
+	pltab->selected_actions = g_simple_action_group_new();
+	g_action_map_add_action_entries(G_ACTION_MAP(pltab->selected_actions), playlist_selected_actions, G_N_ELEMENTS(playlist_selected_actions), pltab);
+	g_signal_connect(G_OBJECT(tw), "row-activated", G_CALLBACK(playlist_clicked_cb), pltab);
 	g_signal_connect(G_OBJECT(selection), "changed", G_CALLBACK(pl_selection_changed), pltab);
 
+	entry = gtk_builder_get_object(pltab->ui, "filter");
+	g_signal_connect(entry, "search-changed", G_CALLBACK(pl_filter_changed), pltab);
+
 	/* set tab widget */
 	tab->widget = GTK_WIDGET(gtk_builder_get_object(pltab->ui, "top"));
 
@@ -69,7 +92,8 @@ void pl_tab_set_format(struct pl_tab *tab, const char *format)
 	GObject *tw;
 	GtkCellRenderer *renderer;
 	GtkTreeViewColumn *col;
-	gchar *title;
+
+	pl_tab_free_format(tab);
 
 	tab->n_columns = 1;
 	for (i = 0; format[i]; i++) {
@@ -78,6 +102,10 @@ void pl_tab_set_format(struct pl_tab *tab, const char *format)
 	}
 
 	tab->columns = g_strsplit(format, "|", 0);
+	tab->formats = g_malloc(tab->n_columns * sizeof(struct song_format *));
+	for (i = 0; tab->columns[i]; i++) {
+		tab->formats[i] = song_format_compile(tab->columns[i]);
+	}
 
 	types = g_malloc((PL_COUNT + tab->n_columns) * sizeof(GType));
 
@@ -88,19 +116,25 @@ void pl_tab_set_format(struct pl_tab *tab, const char *format)
 		types[PL_COUNT + i] = G_TYPE_STRING;
 	}
 
+	if (tab->filter) {
+		g_object_unref(tab->filter);
+		tab->filter = NULL;
+	}
 	if (tab->store) {
 		g_object_unref(G_OBJECT(tab->store));
 	}
+	fold_buffer_clear(&tab->text);
 
 	tab->store = gtk_list_store_newv(PL_COUNT + tab->n_columns, types);
 	g_signal_connect(G_OBJECT(tab->store), "row-changed", G_CALLBACK(playlist_row_changed_cb), tab);
+	g_signal_connect(G_OBJECT(tab->store), "row-deleted", G_CALLBACK(playlist_row_deleted_cb), tab);
 	g_free(types);
 
 	tw = gtk_builder_get_object(tab->ui, "tw");
-	gtk_tree_view_set_model(GTK_TREE_VIEW(tw), GTK_TREE_MODEL(tab->store));
+	pl_filter_apply(tab);
 
-	renderer = gtk_cell_renderer_text_new();
-	g_object_set(G_OBJECT(renderer), "weight-set", TRUE, NULL);
+	/* layouts cached by the renderer are dropped together with old columns */
+	renderer = sonatina_cell_renderer_text_new();
 
 	/* remove all columns */
 	for (i = 0; (col = gtk_tree_view_get_column(GTK_TREE_VIEW(tw), i)); i++) {
@@ -109,13 +143,67 @@ void pl_tab_set_format(struct pl_tab *tab, const char *format)
 
 	/* add new columns */
 	for (i = 0; tab->columns[i]; i++) {
-		title = song_attr_format(tab->columns[i], NULL);
 		MSG_DEBUG("adding column with format '%s' to playlist tw", tab->columns[i]);
-		col = gtk_tree_view_column_new_with_attributes(title, renderer, "weight", PL_WEIGHT, "text", PL_COUNT + i, NULL);
+		col = gtk_tree_view_column_new_with_attributes(song_format_run(tab->formats[i], NULL, tab->fmtbuf),
+				renderer, "weight", PL_WEIGHT, "text", PL_COUNT + i, NULL);
 		gtk_tree_view_append_column(GTK_TREE_VIEW(tw), col);
 	}
 }
 
+void pl_tab_free_format(struct pl_tab *tab)
+{
+	size_t i;
+
+	if (tab->formats) {
+		for (i = 0; i < tab->n_columns; i++) {
+			song_format_free(tab->formats[i]);
+		}
+		g_free(tab->formats);
+		tab->formats = NULL;
+	}
+
+	g_strfreev(tab->columns);
+	tab->columns = NULL;
+}
+
+void pl_format_changed(union settings_value value, void *data)
+{
+	struct pl_tab *tab;
+
+	tab = (struct pl_tab *) sonatina_get_tab("playlist");
+	if (!tab) {
+		return;
+	}
+
+	pl_tab_set_format(tab, value.string);
+	sonatina_update_tagtypes(FALSE);
+
+	/* rows are gone, status answer will request the whole queue */
+	pl_fill_cancel(tab);
+	tab->have_version = FALSE;
+	tab->updating = FALSE;
+	if (tab->mpdsource) {
+		mpd_send(tab->mpdsource, MPD_CMD_STATUS, NULL);
+	}
+}
+
+/**
+  @brief Detach the store from the view and drop the filter, both would handle
+  every row while the whole store is rebuilt. @a pl_filter_apply() attaches it
+  again.
+  */
+static void pl_store_detach(struct pl_tab *pl)
+{
+	GObject *tw;
+
+	tw = gtk_builder_get_object(pl->ui, "tw");
+	gtk_tree_view_set_model(GTK_TREE_VIEW(tw), NULL);
+	if (pl->filter) {
+		g_object_unref(pl->filter);
+		pl->filter = NULL;
+	}
+}
+
 void pl_tab_set_source(struct sonatina_tab *tab, GSource *source)
 {
 	struct pl_tab *pltab = (struct pl_tab *) tab;
@@ -126,15 +214,43 @@ void pl_tab_set_source(struct sonatina_tab *tab, GSource *source)
 	tw = gtk_builder_get_object(pltab->ui, "tw");
 
 	if (source) {
+		mpd_source_register(source, MPD_CMD_STATUS, pl_process_status, tab);
 		mpd_source_register(source, MPD_CMD_CURRENTSONG, pl_process_song, tab);
 		mpd_source_register(source, MPD_CMD_PLINFO, pl_process_pl, tab);
+		mpd_source_register(source, MPD_CMD_PLCHANGES, pl_process_changes, tab);
+		mpd_source_register(source, MPD_CMD_DELETEID, pl_edit_cb, tab);
+		mpd_source_register(source, MPD_CMD_MOVEID, pl_edit_cb, tab);
+		mpd_source_register(source, MPD_CMD_CLEAR, pl_edit_cb, tab);
+		g_queue_clear(&pltab->edits);
+		pltab->move_from = -1;
+		mpd_source_register_error(source, pl_error_cb, tab);
+
+		/* show the queue as it was before the first status answer */
+		if (sonatina.profile) {
+			pl_store_detach(pltab);
+			if (plcache_load(pltab, sonatina.profile, &pltab->version)) {
+				pltab->have_version = TRUE;
+			}
+			pl_filter_apply(pltab);
+		}
 
 		actions = g_simple_action_group_new();
 		g_action_map_add_action_entries(G_ACTION_MAP(actions), playlist_actions, G_N_ELEMENTS(playlist_actions), pltab);
 		gtk_widget_insert_action_group(GTK_WIDGET(tw), "playlist", G_ACTION_GROUP(actions));
 		g_object_unref(actions);
 	} else {
+		/* rows edited locally may not have reached the server */
+		if (pltab->have_version && g_queue_is_empty(&pltab->edits) && !pltab->updating && !pltab->filling &&
+		    sonatina.profile) {
+			plcache_save(pltab, sonatina.profile);
+		}
+		pl_fill_cancel(pltab);
+		pltab->have_version = FALSE;
+		pltab->updating = FALSE;
+		pl_store_detach(pltab);
 		gtk_list_store_clear(pltab->store);
+		fold_buffer_clear(&pltab->text);
+		pl_filter_apply(pltab);
 		gtk_widget_insert_action_group(GTK_WIDGET(tw), "playlist", NULL);
 		gtk_widget_insert_action_group(GTK_WIDGET(tw), "playlist-selected", NULL);
 	}
@@ -146,10 +262,20 @@ void pl_tab_destroy(struct sonatina_tab *tab)
 
 	gtk_widget_destroy(tab->widget);
 
-	g_strfreev(pltab->columns);
+	pl_fill_cancel(pltab);
+	pl_tab_free_format(pltab);
+	g_string_free(pltab->fmtbuf, TRUE);
+	if (pltab->filter) {
+		g_object_unref(pltab->filter);
+	}
+	fold_buffer_free(&pltab->text);
+	g_array_free(pltab->removed, TRUE);
+	g_queue_clear(&pltab->edits);
 	gtk_list_store_clear(pltab->store);
 	g_object_unref(pltab->store);
 	g_object_unref(pltab->ui);
+	g_object_unref(pltab->selected_actions);
+	sel_tracker_free(&pltab->selection);
 }
 
 void pl_set_active(struct pl_tab *pl, int pos_req)
@@ -178,10 +304,11 @@ void pl_update(struct pl_tab *pl, const struct mpd_song *song)
 	GtkTreePath *path;
 	GtkTreeIter iter;
 	size_t i;
-	gchar *str;
+	const gchar *text;
 
 	if (!song) {
 		gtk_list_store_clear(pl->store);
+		fold_buffer_clear(&pl->text);
 		return;
 	}
 
@@ -191,22 +318,31 @@ void pl_update(struct pl_tab *pl, const struct mpd_song *song)
 	if (!gtk_tree_model_get_iter(GTK_TREE_MODEL(pl->store), &iter, path)) {
 		gtk_list_store_insert(pl->store, &iter, pos);
 	}
-	gtk_tree_path_free(path);
 
 	gtk_list_store_set(pl->store, &iter, PL_ID, id, PL_POS, pos, PL_WEIGHT, PANGO_WEIGHT_NORMAL, -1);
 
+	fold_buffer_begin_row(&pl->text, pos);
 	for (i = 0; i < pl->n_columns; i++) {
-		str = song_attr_format(pl->columns[i], song);
-		gtk_list_store_set(pl->store, &iter, PL_COUNT + i, str, -1);
-		g_free(str);
+		text = song_format_run(pl->formats[i], song, pl->fmtbuf);
+		fold_buffer_append(&pl->text, text);
+		gtk_list_store_set(pl->store, &iter, PL_COUNT + i, text, -1);
+	}
+
+	fold_buffer_end_row(&pl->text);
+	if (pl->filter) {
+		/* the filter model has seen the row before its text was known */
+		gtk_tree_model_row_changed(GTK_TREE_MODEL(pl->store), path, &iter);
 	}
+	gtk_tree_path_free(path);
 }
 
 void playlist_clicked_cb(GtkTreeView *tw, GtkTreePath *path, GtkTreeViewColumn *col, gpointer data)
 {
+	struct pl_tab *tab = (struct pl_tab *) data;
 	GtkTreeModel *store;
 	GtkTreeIter iter;
-	int pos;
+	char buf[INT_BUF_SIZE];
+	int id, pos;
 
 	store = gtk_tree_view_get_model(tw);
 
@@ -215,9 +351,44 @@ void playlist_clicked_cb(GtkTreeView *tw, GtkTreePath *path, GtkTreeViewColumn *
 		return;
 	}
 
-	gtk_tree_model_get(store, &iter, PL_POS, &pos, -1);
+	gtk_tree_model_get(store, &iter, PL_ID, &id, PL_POS, &pos, -1);
 
-	sonatina_play(pos);
+	if (id < 0) {
+		/* placeholder, its position is right */
+		sonatina_play(pos);
+		return;
+	}
+
+	/* positions may be ahead of the server after local edits, ids are not */
+	snprintf(buf, sizeof(buf), "%d", id);
+	mpd_send(tab->mpdsource, MPD_CMD_PLAYID, buf, NULL);
+}
+
+/**
+  @brief Remember an edit just sent to the server, its answer is recognized by
+  @a pl_edit_answered().
+  */
+static void pl_edit_sent(struct pl_tab *tab)
+{
+	g_queue_push_tail(&tab->edits, GUINT_TO_POINTER(mpd_source_last_sent(tab->mpdsource)));
+}
+
+/**
+  @brief Forget the oldest edit if the answer being processed belongs to it.
+  @returns TRUE if the answer belongs to an edit of the tab.
+  */
+static gboolean pl_edit_answered(struct pl_tab *tab)
+{
+	guint serial;
+
+	/* answers come in order, so only the oldest edit can be answered */
+	serial = GPOINTER_TO_UINT(g_queue_peek_head(&tab->edits));
+	if (!serial || serial != mpd_source_answered(tab->mpdsource)) {
+		return FALSE;
+	}
+	g_queue_pop_head(&tab->edits);
+
+	return TRUE;
 }
 
 void playlist_row_changed_cb(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, struct pl_tab *tab)
@@ -235,15 +406,86 @@ void playlist_row_changed_cb(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter
 		return;
 	}
 
+	if (id < 0) {
+		/* placeholder of a song that isn't loaded yet */
+		return;
+	}
+
 	if (pos == indices[0]) {
 		/* position not changed */
 		return;
 	}
 
+	/*
+	 * The dragged row is inserted before the original one is deleted, so
+	 * rows moved down end up one row above the drop position.
+	 */
+	tab->move_from = pos;
+	tab->move_to = pos < indices[0] ? indices[0] - 1 : indices[0];
+
 	snprintf(from, sizeof(from), "%d", id);
-	snprintf(to, sizeof(to), "%d", indices[0]);
+	snprintf(to, sizeof(to), "%d", tab->move_to);
 	MSG_DEBUG("moveid %s %s (pos %d)", from, to, pos);
-	mpd_send(tab->mpdsource, MPD_CMD_MOVEID, from, to, NULL);
+	if (mpd_send(tab->mpdsource, MPD_CMD_MOVEID, from, to, NULL)) {
+		pl_edit_sent(tab);
+	}
+}
+
+/**
+  @brief Set positions of rows in a range of the store to their indices.
+  */
+static void pl_renumber(struct pl_tab *pl, gint first, gint last)
+{
+	GtkTreeIter iter;
+	gint i, pos;
+
+	if (!gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(pl->store), &iter, NULL, first)) {
+		return;
+	}
+
+	i = first;
+	do {
+		gtk_tree_model_get(GTK_TREE_MODEL(pl->store), &iter, PL_POS, &pos, -1);
+		if (pos != i) {
+			gtk_list_store_set(pl->store, &iter, PL_POS, i, -1);
+		}
+		i++;
+	} while ((last < 0 || i <= last) && gtk_tree_model_iter_next(GTK_TREE_MODEL(pl->store), &iter));
+}
+
+void playlist_row_deleted_cb(GtkTreeModel *model, GtkTreePath *path, struct pl_tab *tab)
+{
+	gint from = tab->move_from;
+	gint to = tab->move_to;
+
+	if (from < 0) {
+		return;
+	}
+
+	/* the original of the dragged row is gone, the store shows the move */
+	tab->move_from = -1;
+	fold_buffer_move(&tab->text, from, to);
+	pl_renumber(tab, MIN(from, to), MAX(from, to));
+}
+
+void pl_edit_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct pl_tab *tab = (struct pl_tab *) data;
+
+	/* clears sent by the library are answered here too */
+	pl_edit_answered(tab);
+}
+
+/**
+  @brief Drop the store and load the whole queue again, e.g. when it doesn't
+  match the server.
+  */
+static void pl_reload(struct pl_tab *pl)
+{
+	pl_fill_cancel(pl);
+	pl->have_version = FALSE;
+	pl->updating = FALSE;
+	mpd_send(pl->mpdsource, MPD_CMD_STATUS, NULL);
 }
 
 void pl_process_song(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
@@ -256,73 +498,442 @@ void pl_process_song(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *a
 	} else {
 		pos = -1;
 	}
+	tab->active = pos;
+
+	if (sonatina_tab_defer(&tab->tab)) {
+		/* every row is visited, do it once when the tab is shown */
+		return;
+	}
 	pl_set_active(tab, pos);
 }
 
+/**
+  @brief Request the next window of the queue.
+  */
+static void pl_fill_send(struct pl_tab *pl)
+{
+	guint end;
+	char buf[2 * INT_BUF_SIZE];
+
+	/* from the current song to the end, then from the beginning */
+	if (pl->fill_next >= pl->fill_start) {
+		end = MIN(pl->fill_next + PL_FILL_WINDOW, pl->fill_length);
+	} else {
+		end = MIN(pl->fill_next + PL_FILL_WINDOW, pl->fill_start);
+	}
+
+	snprintf(buf, sizeof(buf), "%u:%u", pl->fill_next, end);
+	mpd_send(pl->mpdsource, MPD_CMD_PLINFO, buf, NULL);
+}
+
+static gboolean pl_fill_idle(gpointer data)
+{
+	struct pl_tab *pl = (struct pl_tab *) data;
+
+	pl->fill_source = 0;
+	pl_fill_send(pl);
+
+	return G_SOURCE_REMOVE;
+}
+
+/**
+  @brief Finish loading the queue.
+  */
+static void pl_fill_done(struct pl_tab *pl)
+{
+	MSG_DEBUG("queue of %u songs loaded", pl->fill_length);
+	pl->filling = FALSE;
+	pl->version = pl->target;
+	pl->have_version = TRUE;
+	pl->updating = FALSE;
+
+	if (pl->fill_stale) {
+		/* changes made while filling are requested as usual */
+		mpd_send(pl->mpdsource, MPD_CMD_STATUS, NULL);
+	}
+}
+
+/**
+  @brief Scroll to the current song once the window around it is loaded.
+  */
+static void pl_fill_scroll(struct pl_tab *pl)
+{
+	GtkTreePath *path;
+	GObject *tw;
+
+	if (pl->filter || pl->fill_song >= pl->fill_length) {
+		return;
+	}
+
+	tw = gtk_builder_get_object(pl->ui, "tw");
+	path = gtk_tree_path_new_from_indices(pl->fill_song, -1);
+	gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(tw), path, NULL, TRUE, 0.5, 0);
+	gtk_tree_path_free(path);
+}
+
+void pl_fill_begin(struct pl_tab *pl, guint length, gint song)
+{
+	pl_fill_cancel(pl);
+	pl_store_detach(pl);
+	pl_update(pl, NULL);
+	pl_filter_apply(pl);
+
+	pl->fill_length = length;
+	pl->fill_song = song >= 0 ? (guint) song : 0;
+	pl->fill_stale = FALSE;
+
+	if (length == 0) {
+		pl_fill_done(pl);
+		return;
+	}
+
+	/* center the first window on the current song */
+	pl->fill_start = pl->fill_song > PL_FILL_WINDOW / 2 ? pl->fill_song - PL_FILL_WINDOW / 2 : 0;
+	if (pl->fill_start + PL_FILL_WINDOW > length) {
+		pl->fill_start = length > PL_FILL_WINDOW ? length - PL_FILL_WINDOW : 0;
+	}
+	pl->fill_next = pl->fill_start;
+	pl->filling = TRUE;
+
+	MSG_DEBUG("loading queue of %u songs from %u", length, pl->fill_start);
+	pl_fill_send(pl);
+}
+
+void pl_fill_cancel(struct pl_tab *pl)
+{
+	if (pl->fill_source) {
+		g_source_remove(pl->fill_source);
+		pl->fill_source = 0;
+	}
+	pl->filling = FALSE;
+}
+
 void pl_process_pl(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
 {
 	GList *cur;
 	struct mpd_song *song;
 	struct pl_tab *tab = (struct pl_tab *) data;
+	guint start;
+	guint i;
+
+	if (!tab->filling || !args) {
+		return;
+	}
+
+	start = g_ascii_strtoull(args->data, NULL, 10);
+	if (start != tab->fill_next) {
+		/* answer to a cancelled fill */
+		return;
+	}
+
+	if (start == tab->fill_start) {
+		/* placeholders are created in one go once there is something to show */
+		pl_store_detach(tab);
+		for (i = 0; i < tab->fill_length; i++) {
+			gtk_list_store_insert_with_values(tab->store, NULL, -1, PL_ID, -1, PL_POS, i,
+					PL_WEIGHT, PANGO_WEIGHT_NORMAL, -1);
+		}
+	}
 
-	pl_update(tab, NULL);
 	for (cur = answer->plinfo.list; cur; cur = cur->next) {
 		song = (struct mpd_song *) cur->data;
 		pl_update(tab, song);
 	}
+
+	if (start == tab->fill_start) {
+		pl_filter_apply(tab);
+		pl_fill_scroll(tab);
+	}
+
+	if (tab->fill_next >= tab->fill_start) {
+		tab->fill_next = MIN(tab->fill_next + PL_FILL_WINDOW, tab->fill_length);
+		if (tab->fill_next == tab->fill_length) {
+			tab->fill_next = 0;
+		}
+	} else {
+		tab->fill_next = MIN(tab->fill_next + PL_FILL_WINDOW, tab->fill_start);
+	}
+
+	if (tab->fill_next == tab->fill_start) {
+		pl_fill_done(tab);
+		return;
+	}
+
+	/* below redrawing and input, the visible part is already shown */
+	tab->fill_source = g_idle_add_full(G_PRIORITY_LOW, pl_fill_idle, tab, NULL);
+}
+
+void pl_error_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct pl_tab *tab = (struct pl_tab *) data;
+
+	if (pl_edit_answered(tab)) {
+		/* the store shows an edit the server refused, roll it back */
+		MSG_WARNING("queue edit failed, reloading queue");
+		pl_reload(tab);
+		return;
+	}
+
+	if (cmd != MPD_CMD_PLINFO || !tab->filling) {
+		return;
+	}
+
+	/* the queue got shorter than the window, start over */
+	MSG_WARNING("loading queue failed");
+	pl_reload(tab);
+}
+
+void pl_tab_refresh(struct sonatina_tab *tab)
+{
+	struct pl_tab *pltab = (struct pl_tab *) tab;
+
+	pl_set_active(pltab, pltab->active);
+	if (pltab->mpdsource) {
+		mpd_send(pltab->mpdsource, MPD_CMD_STATUS, NULL);
+	}
+}
+
+void pl_process_status(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct pl_tab *tab = (struct pl_tab *) data;
+	guint version;
+	char buf[INT_BUF_SIZE];
+
+	if (!answer->status) {
+		return;
+	}
+
+	version = mpd_status_get_queue_version(answer->status);
+	tab->length = mpd_status_get_queue_length(answer->status);
+
+	if (tab->filling) {
+		/* compared again when the whole queue is loaded */
+		tab->fill_stale |= version != tab->target;
+		return;
+	}
+
+	if (tab->updating ? version == tab->target : tab->have_version && version == tab->version) {
+		if (tab->updating || !g_queue_is_empty(&tab->edits) ||
+		    gtk_tree_model_iter_n_children(GTK_TREE_MODEL(tab->store), NULL) == (gint) tab->length) {
+			/* up to date or already requested */
+			return;
+		}
+		/* e.g. a cached queue of the same version that doesn't match */
+		MSG_WARNING("queue length doesn't match the server, reloading it");
+		tab->have_version = FALSE;
+	}
+
+	if (!g_queue_is_empty(&tab->edits)) {
+		/* edits in flight change the version again, wait for their status */
+		return;
+	}
+
+	if (sonatina_tab_defer(&tab->tab)) {
+		/* status is requested again when the tab is shown */
+		return;
+	}
+
+	/*
+	 * MPD executes commands in order, so the answer reflects at least
+	 * this version.
+	 */
+	tab->target = version;
+	tab->updating = TRUE;
+
+	if (tab->have_version) {
+		MSG_DEBUG("queue version %u -> %u", tab->version, version);
+		snprintf(buf, sizeof(buf), "%u", tab->version);
+		mpd_send(tab->mpdsource, MPD_CMD_PLCHANGES, buf, NULL);
+	} else {
+		pl_fill_begin(tab, tab->length, mpd_status_get_song_pos(answer->status));
+	}
+}
+
+void pl_process_changes(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data)
+{
+	struct pl_tab *tab = (struct pl_tab *) data;
+	GList *cur;
+
+	for (cur = answer->plinfo.list; cur; cur = cur->next) {
+		pl_update(tab, (struct mpd_song *) cur->data);
+	}
+	pl_truncate(tab, tab->length);
+
+	if (g_queue_is_empty(&tab->edits) && gtk_tree_model_iter_n_children(GTK_TREE_MODEL(tab->store), NULL) != (gint) tab->length) {
+		/* local edits didn't end up as expected */
+		MSG_WARNING("queue doesn't match the server, reloading it");
+		pl_reload(tab);
+		return;
+	}
+
+	if (tab->updating) {
+		tab->version = tab->target;
+		tab->have_version = TRUE;
+		tab->updating = FALSE;
+	}
+}
+
+void pl_truncate(struct pl_tab *pl, guint length)
+{
+	GtkTreeIter iter;
+	gint n;
+
+	n = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(pl->store), NULL);
+	if (n <= (gint) length) {
+		return;
+	}
+
+	MSG_DEBUG("removing %d songs past the end of the queue", n - (gint) length);
+	gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(pl->store), &iter, NULL, length);
+	while (gtk_list_store_remove(pl->store, &iter));
+	fold_buffer_truncate(&pl->text, length);
 }
 
 void pl_selection_changed(GtkTreeSelection *selection, gpointer data)
 {
 	struct pl_tab *tab = (struct pl_tab *) data;
-	GtkTreeModel *model;
-	GList *rows;
 	GtkTreeView *tw;
-	GSimpleActionGroup *actions;
+
+	if (!sel_tracker_changed(&tab->selection)) {
+		/* selection is still empty or still non-empty */
+		return;
+	}
 
 	tw = gtk_tree_selection_get_tree_view(selection);
-	rows = gtk_tree_selection_get_selected_rows(selection, &model);
 
-	if (rows) {
-		actions = g_simple_action_group_new();
-		g_action_map_add_action_entries(G_ACTION_MAP(actions), playlist_selected_actions, G_N_ELEMENTS(playlist_selected_actions), tab);
-		gtk_widget_insert_action_group(GTK_WIDGET(tw), "playlist-selected", G_ACTION_GROUP(actions));
-		g_object_unref(actions);
-	} else {
+	if (sel_tracker_is_empty(&tab->selection)) {
 		gtk_widget_insert_action_group(GTK_WIDGET(tw), "playlist-selected", NULL);
+	} else {
+		gtk_widget_insert_action_group(GTK_WIDGET(tw), "playlist-selected", G_ACTION_GROUP(tab->selected_actions));
+	}
+}
+
+void pl_filter_apply(struct pl_tab *tab)
+{
+	GObject *tw;
+
+	tw = gtk_builder_get_object(tab->ui, "tw");
+
+	if (!fold_buffer_searching(&tab->text)) {
+		if (tab->filter) {
+			gtk_tree_view_set_model(GTK_TREE_VIEW(tw), GTK_TREE_MODEL(tab->store));
+			g_object_unref(tab->filter);
+			tab->filter = NULL;
+		} else if (gtk_tree_view_get_model(GTK_TREE_VIEW(tw)) != GTK_TREE_MODEL(tab->store)) {
+			gtk_tree_view_set_model(GTK_TREE_VIEW(tw), GTK_TREE_MODEL(tab->store));
+		}
+		g_object_set(tw, "reorderable", TRUE, NULL);
+		return;
 	}
 
-	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+	if (tab->filter) {
+		gtk_tree_model_filter_refilter(GTK_TREE_MODEL_FILTER(tab->filter));
+		return;
+	}
+
+	/* moving rows of a filtered view makes no sense */
+	g_object_set(tw, "reorderable", FALSE, NULL);
+
+	tab->filter = gtk_tree_model_filter_new(GTK_TREE_MODEL(tab->store), NULL);
+	gtk_tree_model_filter_set_visible_func(GTK_TREE_MODEL_FILTER(tab->filter), pl_filter_visible, tab, NULL);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(tw), tab->filter);
+}
+
+gboolean pl_filter_visible(GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	struct pl_tab *tab = (struct pl_tab *) data;
+	gint pos;
+
+	gtk_tree_model_get(model, iter, PL_POS, &pos, -1);
+
+	return fold_buffer_row_matches(&tab->text, pos);
+}
+
+void pl_filter_changed(GtkSearchEntry *entry, gpointer data)
+{
+	struct pl_tab *tab = (struct pl_tab *) data;
+
+	fold_buffer_search(&tab->text, gtk_entry_get_text(GTK_ENTRY(entry)));
+	pl_filter_apply(tab);
+}
+
+void playlist_remove_row(GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	struct pl_tab *tab = (struct pl_tab *) data;
+	GtkTreePath *path;
+	GtkTreeIter child;
+	gint id, row;
+	char buf[INT_BUF_SIZE];
+
+	gtk_tree_model_get(model, iter, PL_ID, &id, -1);
+	if (id < 0) {
+		/* placeholder of a song that isn't loaded yet */
+		return;
+	}
+
+	snprintf(buf, sizeof(buf), "%d", id);
+	if (!mpd_send(tab->mpdsource, MPD_CMD_DELETEID, buf, NULL)) {
+		return;
+	}
+	pl_edit_sent(tab);
+
+	if (model != GTK_TREE_MODEL(tab->store)) {
+		gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model), &child, iter);
+		iter = &child;
+	}
+	path = gtk_tree_model_get_path(GTK_TREE_MODEL(tab->store), iter);
+	row = gtk_tree_path_get_indices(path)[0];
+	g_array_append_val(tab->removed, row);
+	gtk_tree_path_free(path);
+}
+
+static gint pl_row_cmp(gconstpointer a, gconstpointer b)
+{
+	return *(const gint *) a - *(const gint *) b;
 }
 
 void playlist_remove_action(GSimpleAction *action, GVariant *param, gpointer data)
 {
 	struct pl_tab *tab = (struct pl_tab *) data;
 	GObject *tw;
-	GtkTreeSelection *selection;
-	GtkTreeModel *model;
 	GtkTreeIter iter;
-	GList *rows;
-	GList *row;
-	gint id;
-	char buf[INT_BUF_SIZE];
+	const gint *rows;
+	gboolean valid;
+	gint row;
+	guint i;
 
 	MSG_INFO("Remove action activated");
 
 	tw = gtk_builder_get_object(tab->ui, "tw");
-	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(tw));
-	rows = gtk_tree_selection_get_selected_rows(selection, &model);
+	g_array_set_size(tab->removed, 0);
+	sel_tracker_foreach(&tab->selection, gtk_tree_view_get_model(GTK_TREE_VIEW(tw)), playlist_remove_row, tab);
+
+	if (tab->filling || !tab->removed->len) {
+		/* windows being loaded are placed by position, wait for the server */
+		return;
+	}
 
-	for (row = rows; row; row = row->next) {
-		if (!gtk_tree_model_get_iter(model, &iter, row->data)) {
-			continue;
+	/* show the result right away, the next queue version confirms it */
+	g_array_sort(tab->removed, pl_row_cmp);
+	rows = (const gint *) tab->removed->data;
+
+	/* one walk over the store from the first removed row */
+	row = rows[0];
+	valid = gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(tab->store), &iter, NULL, row);
+	for (i = 0; valid && i < tab->removed->len; row++) {
+		if (rows[i] == row) {
+			valid = gtk_list_store_remove(tab->store, &iter);
+			while (i < tab->removed->len && rows[i] == row) {
+				i++;
+			}
+		} else {
+			valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(tab->store), &iter);
 		}
-		gtk_tree_model_get(model, &iter, PL_ID, &id, -1);
-		snprintf(buf, sizeof(buf), "%d", id);
-		mpd_send(tab->mpdsource, MPD_CMD_DELETEID, buf, NULL);
 	}
+	fold_buffer_remove_rows(&tab->text, rows, tab->removed->len);
 
-	g_list_free_full(rows, (GDestroyNotify) gtk_tree_path_free);
+	pl_renumber(tab, rows[0], -1);
+	g_array_set_size(tab->removed, 0);
 }
 
 void playlist_clear_action(GSimpleAction *action, GVariant *param, gpointer data)
@@ -331,7 +942,13 @@ void playlist_clear_action(GSimpleAction *action, GVariant *param, gpointer data
 
 	MSG_INFO("Clear action activated");
 
-	mpd_send(tab->mpdsource, MPD_CMD_CLEAR, NULL);
+	if (!mpd_send(tab->mpdsource, MPD_CMD_CLEAR, NULL)) {
+		return;
+	}
+	pl_edit_sent(tab);
+	if (!tab->filling) {
+		pl_update(tab, NULL);
+	}
 }
 
 void playlist_shuffle_action(GSimpleAction *action, GVariant *param, gpointer data)
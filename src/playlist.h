@@ -6,6 +6,8 @@
 #include "core.h"
 #include "client.h"
 #include "settings.h"
+#include "selection.h"
+#include "foldbuf.h"
 
 enum pl_columns {
 	PL_ID,
@@ -24,10 +26,44 @@ struct pl_tab {
 	GSource *mpdsource; /** Connected MPD source or NULL */
 	size_t n_columns; /** Number of user-defined columns */
 	gchar **columns; /** Format of user-defined columns; NULL-terminated array of length n_columns */
+	struct song_format **formats; /** Compiled formats of user-defined
+					columns; array of length n_columns */
+	GString *fmtbuf; /** Buffer for formatting columns */
 	GtkListStore *store; /** Contains internal coulumns and user-defined
 			       columns. Number of coulumns is PL_COUNT + n_columns */
+	struct sel_tracker selection; /** Selection bookkeeping of the tree view */
+	GSimpleActionGroup *selected_actions; /** Actions available when some
+						rows are selected */
+	struct fold_buffer text; /** Case-folded text of user-defined columns
+				   of every row */
+	GtkTreeModel *filter; /** Filtered view of store while filter entry is
+				not empty, NULL otherwise */
+	guint version; /** Queue version the store corresponds to */
+	gboolean have_version; /** TRUE when version is valid */
+	guint target; /** Queue version of the requested update */
+	gboolean updating; /** TRUE while a queue update is requested */
+	guint length; /** Queue length from the last status */
+	gboolean filling; /** TRUE while the whole queue is loaded by windows */
+	gboolean fill_stale; /** TRUE if the queue changed while filling */
+	guint fill_length; /** Queue length when filling started */
+	guint fill_song; /** Position of the current song when filling started */
+	guint fill_start; /** First row of the window around the current song */
+	guint fill_next; /** First row of the window requested next */
+	guint fill_source; /** Source ID of the idle handler requesting the next
+			     window or 0 */
+	gint active; /** Position of the current song or -1 */
+	GQueue edits; /** Serial numbers (guint) of deletes, moves and clears
+			already applied to the store that the server hasn't
+			answered yet, oldest first */
+	gint move_from; /** Position of a row being dragged or -1 */
+	gint move_to; /** Position the dragged row is moved to */
+	GArray *removed; /** Rows of the store (gint) collected by
+			   playlist_remove_row() */
 };
 
+#define PL_FILL_WINDOW 500 /** Songs requested at once while the whole queue is
+			     loaded */
+
 /**
   @brief Initialize playlist tab.
   @param tab Tab to initialize.
@@ -35,8 +71,26 @@ struct pl_tab {
   */
 gboolean pl_tab_init(struct sonatina_tab *tab);
 
+/**
+  @brief Set format of playlist columns. Columns are separated by '|'.
+  @param tab Playlist tab.
+  @param format Format string.
+  */
 void pl_tab_set_format(struct pl_tab *tab, const char *format);
 
+/**
+  @brief Free column formats of a playlist tab.
+  @param tab Playlist tab.
+  */
+void pl_tab_free_format(struct pl_tab *tab);
+
+/**
+  @brief Settings callback called when playlist format is changed.
+  @param value New format.
+  @param data Settings entry that changed.
+  */
+void pl_format_changed(union settings_value value, void *data);
+
 /**
   @brief Set MPD source of a playlist tab.
   @param tab Playlist tab
@@ -50,6 +104,12 @@ void pl_tab_set_source(struct sonatina_tab *tab, GSource *source);
   */
 void pl_tab_destroy(struct sonatina_tab *tab);
 
+/**
+  @brief Catch up with queue changes skipped while the tab was hidden.
+  @param tab Playlist tab.
+  */
+void pl_tab_refresh(struct sonatina_tab *tab);
+
 /**
   @brief Set one song on the playlist to be displayed as currently playing.
   @param pl Playlist tab.
@@ -72,11 +132,119 @@ void pl_update(struct pl_tab *pl, const struct mpd_song *song);
 void playlist_clicked_cb(GtkTreeView *tw, GtkTreePath *path, GtkTreeViewColumn *col, gpointer data);
 void playlist_row_changed_cb(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, struct pl_tab *tab);
 
+/**
+  @brief GTK callback for row-deleted signal of the store. Finishes moving of a
+  dragged row.
+  */
+void playlist_row_deleted_cb(GtkTreeModel *model, GtkTreePath *path, struct pl_tab *tab);
+
+/**
+  @brief Callback for answers to queue edits applied to the store in advance.
+  Answers to the same commands sent by others are ignored.
+  */
+void pl_edit_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
 void pl_process_song(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Callback for playlistinfo command. Replaces placeholders with songs of
+  a window of the queue and requests the next one.
+  @param cmd MPD command type.
+  @param args MPD command argument list.
+  @param answer Answer to command.
+  @param data Pointer to playlist tab.
+  */
 void pl_process_pl(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
 
+/**
+  @brief Callback for failed commands. Starts loading the queue again when a
+  window couldn't be loaded.
+  @param cmd MPD command type.
+  @param args MPD command argument list.
+  @param answer NULL.
+  @param data Pointer to playlist tab.
+  */
+void pl_error_cb(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Start loading the whole queue. The window around the current song is
+  requested first, the rest of the queue is requested window by window when
+  the main loop is idle. Rows are shown as placeholders until they are loaded;
+  placeholders are added together with the first window.
+  @param pl Playlist tab.
+  @param length Queue length.
+  @param song Position of the current song or -1.
+  */
+void pl_fill_begin(struct pl_tab *pl, guint length, gint song);
+
+/**
+  @brief Stop loading the queue.
+  @param pl Playlist tab.
+  */
+void pl_fill_cancel(struct pl_tab *pl);
+
+/**
+  @brief Callback for status command. Requests changes of the queue since the
+  version the playlist tab shows or whole queue if the version is unknown.
+  @param cmd MPD command type.
+  @param args MPD command argument list.
+  @param answer Answer to command.
+  @param data Pointer to playlist tab.
+  */
+void pl_process_status(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Callback for plchanges command. Updates changed songs and removes
+  songs past the end of the queue.
+  @param cmd MPD command type.
+  @param args MPD command argument list.
+  @param answer Answer to command.
+  @param data Pointer to playlist tab.
+  */
+void pl_process_changes(enum mpd_cmd_type cmd, GList *args, union mpd_cmd_answer *answer, void *data);
+
+/**
+  @brief Remove rows past the end of the queue.
+  @param pl Playlist tab.
+  @param length Queue length.
+  */
+void pl_truncate(struct pl_tab *pl, guint length);
+
 void pl_selection_changed(GtkTreeSelection *selection, gpointer data);
 
+/**
+  @brief Show either all rows of the playlist or rows matching the filter
+  entry in the tree view. Rows can't be reordered while filtered.
+  @param tab Playlist tab.
+  */
+void pl_filter_apply(struct pl_tab *tab);
+
+/**
+  @brief Visibility function of the filtered playlist model.
+  @param model Playlist list store.
+  @param iter Row to test.
+  @param data Pointer to playlist tab.
+  @returns TRUE if the row matches the filter.
+  */
+gboolean pl_filter_visible(GtkTreeModel *model, GtkTreeIter *iter, gpointer data);
+
+/**
+  @brief Callback for filter entry's 'search-changed' signal.
+  @param entry Filter entry.
+  @param data Pointer to playlist tab.
+  */
+void pl_filter_changed(GtkSearchEntry *entry, gpointer data);
+
+/**
+  @brief Remove a single row from MPD's playlist. The row is remembered in @a
+  removed of the tab and removed from the store by the caller. Used with @a
+  sel_tracker_foreach().
+  @param model Playlist model.
+  @param iter Row to remove.
+  @param data Pointer to playlist tab.
+  */
+void playlist_remove_row(GtkTreeModel *model, GtkTreeIter *iter, gpointer data);
+
 void playlist_remove_action(GSimpleAction *action, GVariant *param, gpointer data);
 void playlist_clear_action(GSimpleAction *action, GVariant *param, gpointer data);
 void playlist_shuffle_action(GSimpleAction *action, GVariant *param, gpointer data);
@@ -0,0 +1,250 @@
+#include <string.h>
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include "plcache.h"
+#include "playlist.h"
+#include "foldbuf.h"
+#include "profile.h"
+#include "util.h"
+
+/*
+ * Snapshot layout; integers are 32 bits wide in host byte order and strings
+ * are stored as their length followed by the bytes including the terminating
+ * null byte:
+ *
+ *   magic, file version, queue version, number of rows, column format
+ *   for every row: song id, text of every column
+ *
+ * Position of a song is its index in the file.
+ */
+static const char plcache_magic[8] = { 'S', 'O', 'N', 'Q', 'U', 'E', 'U', 'E' };
+
+#define PLCACHE_FILE_VERSION 1
+
+struct plcache_reader {
+	const gchar *p; /** Current position */
+	const gchar *end; /** End of data */
+};
+
+static void plcache_put_u32(GByteArray *buf, guint32 val)
+{
+	g_byte_array_append(buf, (const guint8 *) &val, sizeof(val));
+}
+
+static void plcache_put_str(GByteArray *buf, const gchar *str)
+{
+	guint32 len;
+
+	len = strlen(str) + 1;
+	plcache_put_u32(buf, len);
+	g_byte_array_append(buf, (const guint8 *) str, len);
+}
+
+static gboolean plcache_get_u32(struct plcache_reader *reader, guint32 *val)
+{
+	if (reader->end - reader->p < (gssize) sizeof(*val)) {
+		return FALSE;
+	}
+
+	memcpy(val, reader->p, sizeof(*val));
+	reader->p += sizeof(*val);
+
+	return TRUE;
+}
+
+static gboolean plcache_get_str(struct plcache_reader *reader, const gchar **str)
+{
+	guint32 len;
+
+	if (!plcache_get_u32(reader, &len)) {
+		return FALSE;
+	}
+	if (len == 0 || (guint32) (reader->end - reader->p) < len || reader->p[len - 1] != '\0') {
+		return FALSE;
+	}
+
+	*str = reader->p;
+	reader->p += len;
+
+	return TRUE;
+}
+
+gchar *plcache_path(const char *profile)
+{
+	return sonatina_profile_cache_path(profile, "queue");
+}
+
+gboolean plcache_save(struct pl_tab *tab, const char *profile)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(tab->store);
+	GByteArray *buf;
+	GtkTreeIter iter;
+	gboolean valid;
+	gboolean success;
+	gint id;
+	gchar *str;
+	gchar *path;
+	gchar *dir;
+	size_t i;
+	guint n_rows;
+	GError *err = NULL;
+
+	n_rows = gtk_tree_model_iter_n_children(model, NULL);
+	buf = g_byte_array_new();
+
+	g_byte_array_append(buf, (const guint8 *) plcache_magic, sizeof(plcache_magic));
+	plcache_put_u32(buf, PLCACHE_FILE_VERSION);
+	plcache_put_u32(buf, tab->version);
+	plcache_put_u32(buf, n_rows);
+	str = g_strjoinv("|", tab->columns);
+	plcache_put_str(buf, str);
+	g_free(str);
+
+	for (valid = gtk_tree_model_get_iter_first(model, &iter); valid; valid = gtk_tree_model_iter_next(model, &iter)) {
+		gtk_tree_model_get(model, &iter, PL_ID, &id, -1);
+		plcache_put_u32(buf, id);
+		for (i = 0; i < tab->n_columns; i++) {
+			gtk_tree_model_get(model, &iter, PL_COUNT + i, &str, -1);
+			plcache_put_str(buf, str ? str : "");
+			g_free(str);
+		}
+	}
+
+	path = plcache_path(profile);
+	dir = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0700);
+
+	success = g_file_set_contents(path, (const gchar *) buf->data, buf->len, &err);
+	if (success) {
+		MSG_INFO("saved snapshot of %u songs, queue version %u", n_rows, tab->version);
+	} else {
+		MSG_WARNING("couldn't save queue snapshot: %s", err->message);
+		g_error_free(err);
+	}
+
+	g_free(dir);
+	g_free(path);
+	g_byte_array_free(buf, TRUE);
+
+	return success;
+}
+
+/**
+  @brief Append rows of a snapshot to the playlist tab.
+  @returns FALSE if the snapshot is damaged or doesn't match the tab.
+  */
+static gboolean plcache_parse(struct pl_tab *tab, struct plcache_reader *reader, guint *version)
+{
+	guint32 file_version;
+	guint32 queue_version;
+	guint32 n_rows;
+	guint32 id;
+	guint32 row;
+	const gchar *str;
+	gchar *format;
+	gboolean match;
+	gint *columns;
+	GValue *values;
+	gint n_values;
+	gint i;
+	GtkTreeIter iter;
+
+	if (reader->end - reader->p < (gssize) sizeof(plcache_magic) ||
+	    memcmp(reader->p, plcache_magic, sizeof(plcache_magic))) {
+		return FALSE;
+	}
+	reader->p += sizeof(plcache_magic);
+
+	if (!plcache_get_u32(reader, &file_version) || file_version != PLCACHE_FILE_VERSION ||
+	    !plcache_get_u32(reader, &queue_version) ||
+	    !plcache_get_u32(reader, &n_rows) ||
+	    !plcache_get_str(reader, &str)) {
+		return FALSE;
+	}
+
+	/* rows contain formatted text, so they are useless with other columns */
+	format = g_strjoinv("|", tab->columns);
+	match = !strcmp(format, str);
+	g_free(format);
+	if (!match) {
+		MSG_INFO("queue snapshot was saved with different playlist format");
+		return FALSE;
+	}
+
+	n_values = PL_COUNT + tab->n_columns;
+	columns = g_malloc(n_values * sizeof(gint));
+	values = g_malloc0(n_values * sizeof(GValue));
+	for (i = 0; i < n_values; i++) {
+		columns[i] = i;
+		g_value_init(&values[i], i < PL_COUNT ? G_TYPE_INT : G_TYPE_STRING);
+	}
+	g_value_set_int(&values[PL_WEIGHT], PANGO_WEIGHT_NORMAL);
+
+	for (row = 0; row < n_rows; row++) {
+		if (!plcache_get_u32(reader, &id)) {
+			break;
+		}
+		g_value_set_int(&values[PL_ID], id);
+		g_value_set_int(&values[PL_POS], row);
+
+		fold_buffer_begin_row(&tab->text, row);
+		for (i = PL_COUNT; i < n_values; i++) {
+			if (!plcache_get_str(reader, &str)) {
+				break;
+			}
+			g_value_set_static_string(&values[i], str);
+			fold_buffer_append(&tab->text, str);
+		}
+		if (i < n_values) {
+			break;
+		}
+		fold_buffer_end_row(&tab->text);
+
+		gtk_list_store_insert_with_valuesv(tab->store, &iter, -1, columns, values, n_values);
+	}
+
+	for (i = 0; i < n_values; i++) {
+		g_value_unset(&values[i]);
+	}
+	g_free(values);
+	g_free(columns);
+
+	if (row < n_rows) {
+		MSG_WARNING("queue snapshot is truncated");
+		pl_update(tab, NULL);
+		return FALSE;
+	}
+
+	*version = queue_version;
+
+	return TRUE;
+}
+
+gboolean plcache_load(struct pl_tab *tab, const char *profile, guint *version)
+{
+	struct plcache_reader reader;
+	gchar *path;
+	gchar *data;
+	gsize len;
+	gboolean success;
+
+	path = plcache_path(profile);
+	success = g_file_get_contents(path, &data, &len, NULL);
+	g_free(path);
+
+	if (!success) {
+		return FALSE;
+	}
+
+	reader.p = data;
+	reader.end = data + len;
+	success = plcache_parse(tab, &reader, version);
+	g_free(data);
+
+	if (success) {
+		MSG_INFO("loaded queue snapshot, queue version %u", *version);
+	}
+
+	return success;
+}
@@ -0,0 +1,35 @@
+#ifndef PLCACHE_H
+#define PLCACHE_H
+
+#include <glib.h>
+
+#include "playlist.h"
+
+/**
+  @brief Get path of the queue snapshot of a connection profile. Snapshots are
+  stored in the user's cache directory.
+  @param profile Name of the profile.
+  @returns Newly allocated string that should be freed with g_free().
+  */
+gchar *plcache_path(const char *profile);
+
+/**
+  @brief Save song ids and formatted columns of the playlist tab together with
+  the queue version they correspond to.
+  @param tab Playlist tab.
+  @param profile Name of the connected profile.
+  @returns TRUE on success, FALSE otherwise.
+  */
+gboolean plcache_save(struct pl_tab *tab, const char *profile);
+
+/**
+  @brief Fill an empty playlist tab with a saved snapshot. Snapshot is rejected
+  when it was saved with a different column format.
+  @param tab Playlist tab.
+  @param profile Name of the connected profile.
+  @param version Location to store the queue version of the snapshot.
+  @returns TRUE if the snapshot was loaded, FALSE otherwise.
+  */
+gboolean plcache_load(struct pl_tab *tab, const char *profile, guint *version);
+
+#endif
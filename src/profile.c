@@ -221,6 +221,22 @@ const struct sonatina_profile *sonatina_get_profile(const char *name)
 	return (struct sonatina_profile *) node->data;
 }
 
+gchar *sonatina_profile_cache_path(const char *profile, const char *prefix)
+{
+	gchar *sum;
+	gchar *name;
+	gchar *path;
+
+	/* profile names may contain anything, file is named by their hash */
+	sum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, profile, -1);
+	name = g_strdup_printf("%s-%s", prefix, sum);
+	path = g_build_filename(g_get_user_cache_dir(), PACKAGE, name, NULL);
+	g_free(name);
+	g_free(sum);
+
+	return path;
+}
+
 void sonatina_profile_free(struct sonatina_profile *profile)
 {
 	g_assert(profile != NULL);
@@ -68,6 +68,14 @@ GList *sonatina_lookup_profile(const char *name);
   */
 const struct sonatina_profile *sonatina_get_profile(const char *name);
 
+/**
+  @brief Get path of a file in the cache directory that belongs to a profile.
+  @param profile Name of the profile.
+  @param prefix Prefix of the file name describing its contents.
+  @returns Newly allocated path that should be freed with g_free().
+  */
+gchar *sonatina_profile_cache_path(const char *profile, const char *prefix);
+
 /**
   @brief Free profile structure and its members.
   */
@@ -0,0 +1,157 @@
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include "selection.h"
+#include "util.h"
+
+void sel_tracker_init(struct sel_tracker *tracker, GtkTreeSelection *selection)
+{
+	tracker->selection = selection;
+	tracker->empty = TRUE;
+	tracker->dirty = FALSE;
+	tracker->count = 0;
+	tracker->ranges = g_array_new(FALSE, FALSE, sizeof(struct row_range));
+}
+
+void sel_tracker_free(struct sel_tracker *tracker)
+{
+	if (tracker->ranges) {
+		g_array_free(tracker->ranges, TRUE);
+		tracker->ranges = NULL;
+	}
+}
+
+/**
+  @brief Check whether the cursor row of the tracked tree view is selected.
+  Clicking, shift-clicking or Ctrl+A always leave the cursor row selected, so
+  this answers most changes without walking the selection.
+  */
+static gboolean sel_tracker_cursor_selected(struct sel_tracker *tracker)
+{
+	GtkTreeView *tw;
+	GtkTreePath *path;
+	gboolean selected;
+
+	tw = gtk_tree_selection_get_tree_view(tracker->selection);
+	gtk_tree_view_get_cursor(tw, &path, NULL);
+
+	if (!path) {
+		return FALSE;
+	}
+
+	selected = gtk_tree_selection_path_is_selected(tracker->selection, path);
+	gtk_tree_path_free(path);
+
+	return selected;
+}
+
+gboolean sel_tracker_changed(struct sel_tracker *tracker)
+{
+	gboolean empty;
+
+	tracker->dirty = TRUE;
+
+	if (sel_tracker_cursor_selected(tracker)) {
+		empty = FALSE;
+	} else {
+		empty = gtk_tree_selection_count_selected_rows(tracker->selection) == 0;
+	}
+
+	if (empty == tracker->empty) {
+		return FALSE;
+	}
+
+	MSG_DEBUG("selection is now %s", empty ? "empty" : "non-empty");
+	tracker->empty = empty;
+
+	return TRUE;
+}
+
+gboolean sel_tracker_is_empty(const struct sel_tracker *tracker)
+{
+	return tracker->empty;
+}
+
+static void sel_tracker_add_row(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data)
+{
+	struct sel_tracker *tracker = (struct sel_tracker *) data;
+	struct row_range range;
+	struct row_range *last;
+	gint *indices;
+
+	indices = gtk_tree_path_get_indices(path);
+	if (!indices) {
+		return;
+	}
+
+	tracker->count++;
+
+	if (tracker->ranges->len > 0) {
+		last = &g_array_index(tracker->ranges, struct row_range, tracker->ranges->len - 1);
+		if (last->end == indices[0]) {
+			last->end++;
+			return;
+		}
+	}
+
+	range.start = indices[0];
+	range.end = indices[0] + 1;
+	g_array_append_val(tracker->ranges, range);
+}
+
+/**
+  @brief Rebuild count and interval set of a dirty tracker. Selected rows are
+  visited in order without allocating their paths, so a select-all produces a
+  single interval.
+  */
+static void sel_tracker_sync(struct sel_tracker *tracker)
+{
+	if (!tracker->dirty) {
+		return;
+	}
+
+	g_array_set_size(tracker->ranges, 0);
+	tracker->count = 0;
+
+	if (!tracker->empty) {
+		gtk_tree_selection_selected_foreach(tracker->selection, sel_tracker_add_row, tracker);
+	}
+
+	tracker->dirty = FALSE;
+}
+
+gint sel_tracker_count(struct sel_tracker *tracker)
+{
+	sel_tracker_sync(tracker);
+
+	return tracker->count;
+}
+
+const GArray *sel_tracker_ranges(struct sel_tracker *tracker)
+{
+	sel_tracker_sync(tracker);
+
+	return tracker->ranges;
+}
+
+void sel_tracker_foreach(struct sel_tracker *tracker, GtkTreeModel *model,
+		void (*func)(GtkTreeModel *, GtkTreeIter *, gpointer), gpointer data)
+{
+	const GArray *ranges;
+	const struct row_range *range;
+	GtkTreeIter iter;
+	guint i;
+	gint row;
+	gboolean valid;
+
+	ranges = sel_tracker_ranges(tracker);
+
+	for (i = 0; i < ranges->len; i++) {
+		range = &g_array_index(ranges, struct row_range, i);
+		valid = gtk_tree_model_iter_nth_child(model, &iter, NULL, range->start);
+		for (row = range->start; valid && row < range->end; row++) {
+			func(model, &iter, data);
+			valid = gtk_tree_model_iter_next(model, &iter);
+		}
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <gtk/gtk.h>
+
+/**
+  Half-open interval of selected rows of a flat tree model.
+  */
+struct row_range {
+	gint start; /** Index of the first selected row */
+	gint end; /** Index one past the last selected row */
+};
+
+/**
+  Selection bookkeeping for a GtkTreeView with GTK_SELECTION_MULTIPLE mode.
+
+  GtkTreeSelection's 'changed' signal doesn't tell what changed, so asking for
+  the list of selected rows on every change costs time and memory proportional
+  to the selection size. This structure only tracks whether the selection is
+  empty, which in common cases is decided from the cursor row, and builds the
+  selected row count and interval set lazily when somebody asks for them.
+  */
+struct sel_tracker {
+	GtkTreeSelection *selection; /** Tracked selection */
+	gboolean empty; /** TRUE if nothing is selected */
+	gboolean dirty; /** TRUE when count and ranges need to be rebuilt */
+	gint count; /** Number of selected rows; valid when not dirty */
+	GArray *ranges; /** Sorted disjoint intervals of selected rows (struct
+			  row_range); valid when not dirty */
+};
+
+/**
+  @brief Initialize selection tracker.
+  @param tracker Tracker to initialize.
+  @param selection Selection to track.
+  */
+void sel_tracker_init(struct sel_tracker *tracker, GtkTreeSelection *selection);
+
+/**
+  @brief Free memory allocated by @a sel_tracker_init().
+  @param tracker Selection tracker.
+  */
+void sel_tracker_free(struct sel_tracker *tracker);
+
+/**
+  @brief Update tracker after a selection change. Should be called from the
+  selection's 'changed' signal handler.
+  @param tracker Selection tracker.
+  @returns TRUE when the selection changed from empty to non-empty or vice
+  versa, FALSE otherwise.
+  */
+gboolean sel_tracker_changed(struct sel_tracker *tracker);
+
+/**
+  @brief Check whether anything is selected.
+  @param tracker Selection tracker.
+  @returns TRUE if no row is selected.
+  */
+gboolean sel_tracker_is_empty(const struct sel_tracker *tracker);
+
+/**
+  @brief Get number of selected rows.
+  @param tracker Selection tracker.
+  @returns Number of selected rows.
+  */
+gint sel_tracker_count(struct sel_tracker *tracker);
+
+/**
+  @brief Get intervals of selected rows.
+  @param tracker Selection tracker.
+  @returns Array of struct row_range owned by the tracker. It is valid until
+  the next selection change.
+  */
+const GArray *sel_tracker_ranges(struct sel_tracker *tracker);
+
+/**
+  @brief Call a function for every selected row in ascending order.
+  @param tracker Selection tracker.
+  @param model Model of the tree view.
+  @param func Function that will be called for every selected row.
+  @param data User data passed to @a func.
+  */
+void sel_tracker_foreach(struct sel_tracker *tracker, GtkTreeModel *model,
+		void (*func)(GtkTreeModel *, GtkTreeIter *, gpointer), gpointer data);
+
+#endif
@@ -6,6 +6,8 @@
 
 #include "settings.h"
 #include "core.h"
+#include "playlist.h"
+#include "library.h"
 #include "util.h"
 #include "gettext.h"
 
@@ -16,11 +18,15 @@ GKeyFile *rc;
 
 struct settings_entry settings[] = {
 	{ "main", "active_profile", SETTINGS_STRING, NULL, NULL, NULL },
-	{ "main", "title", SETTINGS_STRING, __("Song line 1"), NULL, NULL },
-	{ "main", "subtitle", SETTINGS_STRING, __("Song line 2"), NULL, NULL },
-	{ "playlist", "format", SETTINGS_STRING, __("Playlist entry"), NULL, NULL },
-	{ "library", "format", SETTINGS_STRING, __("Library entry"), NULL, NULL },
+	{ "main", "title", SETTINGS_STRING, __("Song line 1"), NULL, sonatina_title_format_changed },
+	{ "main", "subtitle", SETTINGS_STRING, __("Song line 2"), NULL, sonatina_title_format_changed },
+	{ "playlist", "format", SETTINGS_STRING, __("Playlist entry"), NULL, pl_format_changed },
+	{ "library", "format", SETTINGS_STRING, __("Library entry"), NULL, library_format_changed },
 	{ "library", "icon_size", SETTINGS_NUM, __("Icon size"), NULL, NULL },
+	{ "library", "cache", SETTINGS_BOOL, __("Keep local copy of the library"), NULL, library_cache_changed },
+	{ "library", "ignore_the", SETTINGS_BOOL, __("Ignore leading \"The\" when sorting"), NULL, library_sort_changed },
+	{ "library", "albums_by_date", SETTINGS_BOOL, __("Sort albums by date"), NULL, library_sort_changed },
+	{ "library", "album_tree", SETTINGS_BOOL, __("Load albums of all artists at once"), NULL, library_sort_changed },
 	{ NULL, NULL, SETTINGS_UNKNOWN, NULL, NULL, NULL }
 };
 
@@ -36,6 +42,14 @@ void sonatina_settings_default(GKeyFile *rc)
 		g_key_file_set_string(rc, "library", "format", DEFAULT_LIBRARY_FORMAT);
 	if (!g_key_file_get_integer(rc, "library", "icon_size", NULL))
 		g_key_file_set_integer(rc, "library", "icon_size", DEFAULT_LIBRARY_ICON_SIZE);
+	if (!g_key_file_has_key(rc, "library", "cache", NULL))
+		g_key_file_set_boolean(rc, "library", "cache", DEFAULT_LIBRARY_CACHE);
+	if (!g_key_file_has_key(rc, "library", "ignore_the", NULL))
+		g_key_file_set_boolean(rc, "library", "ignore_the", DEFAULT_LIBRARY_IGNORE_THE);
+	if (!g_key_file_has_key(rc, "library", "albums_by_date", NULL))
+		g_key_file_set_boolean(rc, "library", "albums_by_date", DEFAULT_LIBRARY_ALBUMS_BY_DATE);
+	if (!g_key_file_has_key(rc, "library", "album_tree", NULL))
+		g_key_file_set_boolean(rc, "library", "album_tree", DEFAULT_LIBRARY_ALBUM_TREE);
 }
 
 gboolean sonatina_settings_load()
@@ -155,6 +169,10 @@ gboolean sonatina_settings_set(const char *section, const char *name, union sett
 		break;
 	}
 
+	if (entry->changed_cb) {
+		entry->changed_cb(value, (void *) entry);
+	}
+
 	return TRUE;
 }
 
@@ -9,6 +9,10 @@
 #define DEFAULT_PLAYLIST_FORMAT "%N|%T|%A"
 #define DEFAULT_LIBRARY_FORMAT "%N %T"
 #define DEFAULT_LIBRARY_ICON_SIZE (GTK_ICON_SIZE_BUTTON)
+#define DEFAULT_LIBRARY_CACHE FALSE
+#define DEFAULT_LIBRARY_IGNORE_THE FALSE
+#define DEFAULT_LIBRARY_ALBUMS_BY_DATE FALSE
+#define DEFAULT_LIBRARY_ALBUM_TREE FALSE
 
 enum settings_type {
 	SETTINGS_UNKNOWN,
@@ -29,7 +33,11 @@ struct settings_entry {
 	enum settings_type type;
 	const char *label;
 	const char *tooltip;
-	void (*changed_cb)(union settings_value, void *);
+	void (*changed_cb)(union settings_value, void *); /** Called with the
+							    new value and
+							    this entry when
+							    the value is
+							    set */
 
 };
 
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include <glib.h>
 #include <mpd/client.h>
 
@@ -132,39 +134,236 @@ const char *get_song_attr_name(enum song_attr attr)
 	return NULL;
 }
 
-gchar *song_attr_format(const char *format, const struct mpd_song *song)
+#define SONG_FORMAT_MAX_DEPTH 16
+
+/**
+  @brief Append literal text to a format being compiled, merging it with the
+  previous text operation if possible.
+  */
+static void song_format_add_text(GArray *ops, GString *text, const char *str, size_t len)
 {
-	GString *buf;
-	enum song_attr type;
-	char *attr;
-	const char *name;
+	struct song_format_op op;
+	struct song_format_op *last;
+
+	if (ops->len > 0) {
+		last = &g_array_index(ops, struct song_format_op, ops->len - 1);
+		if (last->type == SONG_FORMAT_TEXT && last->offset + last->len == text->len) {
+			g_string_append_len(text, str, len);
+			last->len += len;
+			return;
+		}
+	}
+
+	op.type = SONG_FORMAT_TEXT;
+	op.attr = -1;
+	op.offset = text->len;
+	op.len = len;
+	g_string_append_len(text, str, len);
+	g_array_append_val(ops, op);
+}
+
+struct song_format *song_format_compile(const char *format)
+{
+	struct song_format *fmt;
+	struct song_format_op op;
+	GArray *ops;
+	GString *text;
+	size_t stack[SONG_FORMAT_MAX_DEPTH];
+	int depth = 0;
+	int skipped = 0;
 	size_t i;
-	int block = 0;
 
-	buf = g_string_new("");
+	fmt = g_malloc(sizeof(struct song_format));
+	fmt->tags = 0;
 
-	for (i = 0; format[i]; i++) {
+	ops = g_array_new(FALSE, FALSE, sizeof(struct song_format_op));
+	text = g_string_new(NULL);
+
+	for (i = 0; format && format[i]; i++) {
 		if (format[i] == '%') {
+			if (format[i + 1] == '\0' || format[i + 1] == '%') {
+				song_format_add_text(ops, text, "%", 1);
+				if (format[i + 1] == '%') {
+					i++;
+				}
+				continue;
+			}
 			i++;
-			type = song_attr_format_to_type(format[i]);
-			if (song) {
-				attr = get_song_attr(type, song);
-				g_string_append(buf, attr);
-				g_free(attr);
-			} else {
-				name = get_song_attr_name(type);
-				g_string_append(buf, name);
+			op.type = SONG_FORMAT_ATTR;
+			op.attr = song_attr_format_to_type(format[i]);
+			op.offset = 0;
+			op.len = 0;
+			if (op.attr >= 0 && op.attr < MPD_TAG_COUNT) {
+				fmt->tags |= (guint64) 1 << op.attr;
 			}
+			g_array_append_val(ops, op);
 		} else if (format[i] == '{') {
-			block++;
+			if (depth == SONG_FORMAT_MAX_DEPTH) {
+				skipped++;
+				continue;
+			}
+			op.type = SONG_FORMAT_BEGIN;
+			op.attr = -1;
+			op.offset = 0;
+			op.len = 0;
+			stack[depth++] = ops->len;
+			g_array_append_val(ops, op);
 		} else if (format[i] == '}') {
-			block--;
+			if (skipped > 0) {
+				skipped--;
+				continue;
+			}
+			if (depth == 0) {
+				/* unmatched closing brace */
+				continue;
+			}
+			op.type = SONG_FORMAT_END;
+			op.attr = -1;
+			op.offset = 0;
+			op.len = 0;
+			g_array_index(ops, struct song_format_op, stack[--depth]).offset = ops->len;
+			g_array_append_val(ops, op);
 		} else {
-			g_string_append_c(buf, format[i]);
+			song_format_add_text(ops, text, &format[i], 1);
 		}
 	}
-	
-	return g_string_free(buf, FALSE);
 
+	/* close unterminated blocks */
+	while (depth > 0) {
+		op.type = SONG_FORMAT_END;
+		op.attr = -1;
+		op.offset = 0;
+		op.len = 0;
+		g_array_index(ops, struct song_format_op, stack[--depth]).offset = ops->len;
+		g_array_append_val(ops, op);
+	}
+
+	fmt->n_ops = ops->len;
+	fmt->ops = (struct song_format_op *) (void *) g_array_free(ops, FALSE);
+	fmt->text = g_string_free(text, FALSE);
+
+	return fmt;
 }
 
+void song_format_free(struct song_format *fmt)
+{
+	if (!fmt) {
+		return;
+	}
+
+	g_free(fmt->ops);
+	g_free(fmt->text);
+	g_free(fmt);
+}
+
+/**
+  @brief Append value of a song attribute to a buffer without any temporary
+  allocation.
+  @returns FALSE if the song doesn't have the attribute, TRUE otherwise.
+  */
+static gboolean song_attr_append(GString *buf, int attr, const struct mpd_song *song)
+{
+	const char *str;
+	int num;
+
+	if (attr >= 0 && attr < MPD_TAG_COUNT) {
+		str = mpd_song_get_tag(song, attr, 0);
+		if (!str) {
+			return FALSE;
+		}
+		g_string_append(buf, str);
+		return TRUE;
+	}
+
+	switch (attr) {
+	case SONG_ATTR_ID:
+		g_string_append_printf(buf, "%u", mpd_song_get_id(song));
+		break;
+	case SONG_ATTR_POS:
+		g_string_append_printf(buf, "%u", mpd_song_get_pos(song));
+		break;
+	case SONG_ATTR_LENGTH:
+		num = mpd_song_get_duration(song);
+		g_string_append_printf(buf, "%d:%.2d", num/60, num%60);
+		break;
+	case SONG_ATTR_TIME:
+		g_string_append(buf, "0:00");
+		break;
+	case SONG_ATTR_MOD:
+		g_string_append_printf(buf, "%ld", (long) mpd_song_get_last_modified(song));
+		break;
+	case SONG_ATTR_URI:
+		g_string_append(buf, mpd_song_get_uri(song));
+		break;
+	case SONG_ATTR_FILE:
+		str = strrchr(mpd_song_get_uri(song), '/');
+		g_string_append(buf, str ? str + 1 : mpd_song_get_uri(song));
+		break;
+	default:
+		g_string_append(buf, _("(unknown)"));
+		break;
+	}
+
+	return TRUE;
+}
+
+const gchar *song_format_run(const struct song_format *fmt, const struct mpd_song *song, GString *buf)
+{
+	const struct song_format_op *op;
+	size_t starts[SONG_FORMAT_MAX_DEPTH];
+	size_t blocks[SONG_FORMAT_MAX_DEPTH];
+	const char *name;
+	int depth = 0;
+	size_t i;
+
+	g_string_truncate(buf, 0);
+
+	for (i = 0; i < fmt->n_ops; i++) {
+		op = &fmt->ops[i];
+		switch (op->type) {
+		case SONG_FORMAT_TEXT:
+			g_string_append_len(buf, fmt->text + op->offset, op->len);
+			break;
+		case SONG_FORMAT_BEGIN:
+			starts[depth] = buf->len;
+			blocks[depth] = op->offset;
+			depth++;
+			break;
+		case SONG_FORMAT_END:
+			depth--;
+			break;
+		case SONG_FORMAT_ATTR:
+			if (!song) {
+				name = get_song_attr_name(op->attr);
+				g_string_append(buf, name ? name : _("(unknown)"));
+			} else if (!song_attr_append(buf, op->attr, song)) {
+				if (depth > 0) {
+					/* drop the whole block */
+					depth--;
+					g_string_truncate(buf, starts[depth]);
+					i = blocks[depth];
+				} else if (op->attr == MPD_TAG_TITLE) {
+					song_attr_append(buf, SONG_ATTR_FILE, song);
+				} else {
+					g_string_append(buf, _("Untagged"));
+				}
+			}
+			break;
+		}
+	}
+
+	return buf->str;
+}
+
+gchar *song_attr_format(const char *format, const struct mpd_song *song)
+{
+	struct song_format *fmt;
+	GString *buf;
+
+	fmt = song_format_compile(format);
+	buf = g_string_new(NULL);
+	song_format_run(fmt, song, buf);
+	song_format_free(fmt);
+
+	return g_string_free(buf, FALSE);
+}
@@ -28,7 +28,67 @@ gchar *get_song_attr(enum song_attr attr, const struct mpd_song *song);
 const char *get_song_attr_name(enum song_attr attr);
 
 /**
-  @brief Replace certain '%'-specifiers with song attributes.
+  Type of a single operation of a compiled song format.
+  */
+enum song_format_op_type {
+	SONG_FORMAT_TEXT, /** Append literal text */
+	SONG_FORMAT_ATTR, /** Append song attribute */
+	SONG_FORMAT_BEGIN, /** Beginning of a conditional block */
+	SONG_FORMAT_END /** End of a conditional block */
+};
+
+struct song_format_op {
+	enum song_format_op_type type;
+	int attr; /** Attribute for SONG_FORMAT_ATTR */
+	size_t offset; /** Offset of literal text for SONG_FORMAT_TEXT, index of
+			 the matching SONG_FORMAT_END for SONG_FORMAT_BEGIN */
+	size_t len; /** Length of literal text for SONG_FORMAT_TEXT */
+};
+
+/**
+  Format string compiled into a list of operations. Text in '{' and '}' forms a
+  conditional block that is left out when any attribute inside it is missing in
+  the song. Blocks can be nested.
+  */
+struct song_format {
+	gchar *text; /** Literal text referenced by operations */
+	struct song_format_op *ops; /** Operations */
+	size_t n_ops; /** Number of operations */
+	guint64 tags; /** Bit mask of MPD tags used by the format; bit n is set
+			when tag n of enum mpd_tag_type is used */
+};
+
+/**
+  @brief Compile format string. See @a song_attr_format() for description of
+  format strings.
+  @param format Format string.
+  @returns Newly allocated compiled format that should be freed with @a
+  song_format_free().
+  */
+struct song_format *song_format_compile(const char *format);
+
+/**
+  @brief Free compiled format.
+  @param fmt Compiled format or NULL.
+  */
+void song_format_free(struct song_format *fmt);
+
+/**
+  @brief Format song attributes according to a compiled format.
+  @param fmt Compiled format.
+  @param song mpdclient song whose attributes should be used. If @a song is
+  NULL, attribute names will be used instead of values.
+  @param buf Buffer that will be overwritten with the result. It can be
+  reused for subsequent calls to avoid allocations.
+  @returns Formatted string owned by @a buf.
+  */
+const gchar *song_format_run(const struct song_format *fmt, const struct mpd_song *song, GString *buf);
+
+/**
+  @brief Replace certain '%'-specifiers with song attributes. Text enclosed
+  in '{' and '}' is displayed only when all attributes in it are set. When
+  a format is used repeatedly, use @a song_format_compile() and @a
+  song_format_run() instead.
   @param format Format string.
   @param song mpdclient song whose attributes should be used. If @a song is
   NULL, attribute names will be used instead of values.
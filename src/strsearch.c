@@ -0,0 +1,129 @@
+#include <string.h>
+
+#include "strsearch.h"
+#include "util.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRSEARCH_X86
+#include <immintrin.h>
+#endif
+
+typedef const char *(*strsearch_func)(const char *, size_t, const char *, size_t);
+
+static const char *strsearch_scalar(const char *hay, size_t len, const char *needle, size_t nlen)
+{
+	const char *p;
+	const char *end;
+
+	end = hay + len - nlen + 1;
+	for (p = hay; p < end; p++) {
+		p = memchr(p, needle[0], end - p);
+		if (!p) {
+			return NULL;
+		}
+		if (memcmp(p, needle, nlen) == 0) {
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+#ifdef STRSEARCH_X86
+
+/*
+ * Both vector kernels compare a block of candidate positions against the
+ * first and the last byte of the needle at once and only verify positions
+ * where both bytes match. For case-folded text with a needle of two or more
+ * characters this rejects almost every position without a branch.
+ */
+
+__attribute__((target("sse2")))
+static const char *strsearch_sse2(const char *hay, size_t len, const char *needle, size_t nlen)
+{
+	__m128i first, last, a, b;
+	unsigned int mask;
+	size_t i;
+
+	first = _mm_set1_epi8(needle[0]);
+	last = _mm_set1_epi8(needle[nlen - 1]);
+
+	for (i = 0; i + nlen - 1 + 16 <= len; i += 16) {
+		a = _mm_loadu_si128((const __m128i *) (hay + i));
+		b = _mm_loadu_si128((const __m128i *) (hay + i + nlen - 1));
+		mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while (mask) {
+			if (memcmp(hay + i + __builtin_ctz(mask), needle, nlen) == 0) {
+				return hay + i + __builtin_ctz(mask);
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return strsearch_scalar(hay + i, len - i, needle, nlen);
+}
+
+__attribute__((target("avx2")))
+static const char *strsearch_avx2(const char *hay, size_t len, const char *needle, size_t nlen)
+{
+	__m256i first, last, a, b;
+	unsigned int mask;
+	size_t i;
+
+	first = _mm256_set1_epi8(needle[0]);
+	last = _mm256_set1_epi8(needle[nlen - 1]);
+
+	for (i = 0; i + nlen - 1 + 32 <= len; i += 32) {
+		a = _mm256_loadu_si256((const __m256i *) (hay + i));
+		b = _mm256_loadu_si256((const __m256i *) (hay + i + nlen - 1));
+		mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		while (mask) {
+			if (memcmp(hay + i + __builtin_ctz(mask), needle, nlen) == 0) {
+				return hay + i + __builtin_ctz(mask);
+			}
+			mask &= mask - 1;
+		}
+	}
+
+	return strsearch_sse2(hay + i, len - i, needle, nlen);
+}
+
+#endif
+
+/**
+  @brief Choose the fastest implementation supported by the CPU.
+  */
+static strsearch_func strsearch_select(void)
+{
+#ifdef STRSEARCH_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		MSG_DEBUG("using AVX2 substring search");
+		return strsearch_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		MSG_DEBUG("using SSE2 substring search");
+		return strsearch_sse2;
+	}
+#endif
+	MSG_DEBUG("using scalar substring search");
+	return strsearch_scalar;
+}
+
+const char *strsearch_find(const char *hay, size_t len, const char *needle, size_t nlen)
+{
+	static strsearch_func impl = NULL;
+
+	if (nlen == 0) {
+		return hay;
+	}
+	if (nlen > len) {
+		return NULL;
+	}
+
+	if (!impl) {
+		impl = strsearch_select();
+	}
+
+	return impl(hay, len, needle, nlen);
+}
@@ -0,0 +1,22 @@
+#ifndef STRSEARCH_H
+#define STRSEARCH_H
+
+#include <stddef.h>
+
+/**
+  @brief Find first occurrence of a byte string in a buffer. Unlike strstr()
+  the buffer doesn't have to be terminated and may contain null bytes, so it
+  can be used to scan many strings stored back to back in a single pass.
+
+  SSE2 or AVX2 implementation is selected at run time when the CPU supports
+  it; a portable implementation is used otherwise.
+  @param hay Buffer to search.
+  @param len Length of @a hay in bytes.
+  @param needle String to find.
+  @param nlen Length of @a needle in bytes.
+  @returns Pointer to the first occurrence of @a needle in @a hay or NULL if
+  there is none. Empty needle matches at @a hay.
+  */
+const char *strsearch_find(const char *hay, size_t len, const char *needle, size_t nlen);
+
+#endif
@@ -0,0 +1,203 @@
+#include <string.h>
+#include <glib.h>
+
+#include "tagsort.h"
+#include "util.h"
+
+/**
+  Part of the rows sorted by one thread.
+  */
+struct tag_sort_slice {
+	struct tag_sort_row *rows;
+	guint len;
+	guint flags;
+};
+
+void tag_sort_init(struct tag_sort *sort, guint flags)
+{
+	sort->rows = g_array_new(FALSE, FALSE, sizeof(struct tag_sort_row));
+	sort->chunk = g_string_chunk_new(16 * 1024);
+	sort->flags = flags;
+}
+
+void tag_sort_free(struct tag_sort *sort)
+{
+	tag_sort_clear(sort, 0);
+	g_array_free(sort->rows, TRUE);
+	g_string_chunk_free(sort->chunk);
+}
+
+void tag_sort_clear(struct tag_sort *sort, guint flags)
+{
+	guint i;
+
+	for (i = 0; i < sort->rows->len; i++) {
+		g_free(g_array_index(sort->rows, struct tag_sort_row, i).key);
+	}
+	g_array_set_size(sort->rows, 0);
+	g_string_chunk_clear(sort->chunk);
+	sort->flags = flags;
+}
+
+void tag_sort_append(struct tag_sort *sort, const gchar *name, const gchar *date)
+{
+	struct tag_sort_row row;
+
+	row.name = name ? g_string_chunk_insert_const(sort->chunk, name) : NULL;
+	row.date = date && date[0] ? g_string_chunk_insert_const(sort->chunk, date) : NULL;
+	row.key = NULL;
+	g_array_append_val(sort->rows, row);
+}
+
+static gchar *tag_sort_key(const gchar *name, guint flags)
+{
+	if (!name) {
+		return g_strdup("");
+	}
+
+	if ((flags & TAG_SORT_IGNORE_THE) && !g_ascii_strncasecmp(name, "the ", 4) && name[4]) {
+		name += 4;
+	}
+
+	return g_utf8_collate_key(name, -1);
+}
+
+static gint tag_sort_cmp(gconstpointer a, gconstpointer b, gpointer data)
+{
+	const struct tag_sort_row *x = (const struct tag_sort_row *) a;
+	const struct tag_sort_row *y = (const struct tag_sort_row *) b;
+	guint flags = GPOINTER_TO_UINT(data);
+	gint cmp;
+
+	if (flags & TAG_SORT_BY_DATE && x->date != y->date) {
+		if (!x->date || !y->date) {
+			return x->date ? -1 : 1;
+		}
+		cmp = strcmp(x->date, y->date);
+		if (cmp) {
+			return cmp;
+		}
+	}
+
+	return strcmp(x->key, y->key);
+}
+
+static gpointer tag_sort_slice_run(gpointer data)
+{
+	struct tag_sort_slice *slice = (struct tag_sort_slice *) data;
+	guint i;
+
+	for (i = 0; i < slice->len; i++) {
+		slice->rows[i].key = tag_sort_key(slice->rows[i].name, slice->flags);
+	}
+	/* g_qsort_with_data() is a stable merge sort */
+	g_qsort_with_data(slice->rows, slice->len, sizeof(struct tag_sort_row), tag_sort_cmp,
+			GUINT_TO_POINTER(slice->flags));
+
+	return NULL;
+}
+
+/**
+  @brief Merge two adjacent sorted slices.
+  @param tmp Buffer large enough for both slices.
+  */
+static void tag_sort_merge(struct tag_sort_slice *a, const struct tag_sort_slice *b, struct tag_sort_row *tmp)
+{
+	guint i = 0, j = 0, k = 0;
+
+	while (i < a->len && j < b->len) {
+		/* ties go to the left slice to keep the sort stable */
+		if (tag_sort_cmp(&b->rows[j], &a->rows[i], GUINT_TO_POINTER(a->flags)) < 0) {
+			tmp[k++] = b->rows[j++];
+		} else {
+			tmp[k++] = a->rows[i++];
+		}
+	}
+	while (i < a->len) {
+		tmp[k++] = a->rows[i++];
+	}
+	while (j < b->len) {
+		tmp[k++] = b->rows[j++];
+	}
+
+	memcpy(a->rows, tmp, k * sizeof(struct tag_sort_row));
+	a->len = k;
+}
+
+static void tag_sort_parallel(struct tag_sort_slice *slices, guint n, guint len)
+{
+	GThread *threads[TAG_SORT_MAX_THREADS];
+	struct tag_sort_row *tmp;
+	guint i, step;
+
+	/* the first slice is sorted by this thread */
+	for (i = 1; i < n; i++) {
+		threads[i] = g_thread_new("tagsort", tag_sort_slice_run, &slices[i]);
+	}
+	tag_sort_slice_run(&slices[0]);
+	for (i = 1; i < n; i++) {
+		g_thread_join(threads[i]);
+	}
+
+	tmp = g_malloc(len * sizeof(struct tag_sort_row));
+	for (step = 1; step < n; step *= 2) {
+		for (i = 0; i + step < n; i += 2 * step) {
+			tag_sort_merge(&slices[i], &slices[i + step], tmp);
+		}
+	}
+	g_free(tmp);
+
+	MSG_DEBUG("%u values sorted by %u threads", len, n);
+}
+
+/**
+  @brief Drop all but the first occurrence of every name.
+  */
+static void tag_sort_unique(struct tag_sort *sort)
+{
+	struct tag_sort_row *rows = (struct tag_sort_row *) sort->rows->data;
+	GHashTable *seen;
+	guint i, k;
+
+	/* names are interned in the chunk, equal names are equal pointers */
+	seen = g_hash_table_new(NULL, NULL);
+	for (i = 0, k = 0; i < sort->rows->len; i++) {
+		if (g_hash_table_contains(seen, rows[i].name)) {
+			g_free(rows[i].key);
+			continue;
+		}
+		g_hash_table_add(seen, (gpointer) rows[i].name);
+		rows[k++] = rows[i];
+	}
+	g_array_set_size(sort->rows, k);
+	g_hash_table_destroy(seen);
+}
+
+void tag_sort_run(struct tag_sort *sort)
+{
+	struct tag_sort_slice slices[TAG_SORT_MAX_THREADS];
+	struct tag_sort_row *rows = (struct tag_sort_row *) sort->rows->data;
+	guint len = sort->rows->len;
+	guint n, i;
+
+	n = 1;
+	if (len >= TAG_SORT_PARALLEL_MIN) {
+		n = CLAMP(g_get_num_processors(), 1, TAG_SORT_MAX_THREADS);
+	}
+
+	for (i = 0; i < n; i++) {
+		slices[i].rows = rows + (gsize) len * i / n;
+		slices[i].len = (gsize) len * (i + 1) / n - (gsize) len * i / n;
+		slices[i].flags = sort->flags;
+	}
+
+	if (n == 1) {
+		tag_sort_slice_run(&slices[0]);
+	} else {
+		tag_sort_parallel(slices, n, len);
+	}
+
+	if (sort->flags & TAG_SORT_BY_DATE) {
+		tag_sort_unique(sort);
+	}
+}
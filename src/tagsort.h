@@ -0,0 +1,72 @@
+#ifndef TAGSORT_H
+#define TAGSORT_H
+
+#include <glib.h>
+
+/*
+ * Sorting of genre, artist and album listings. Every value gets a collation
+ * key once, so comparisons are plain strcmp() instead of g_utf8_collate(),
+ * and large listings are sorted by several threads.
+ */
+
+#define TAG_SORT_IGNORE_THE (1 << 0) /** Sort "The Band" as "Band" */
+#define TAG_SORT_BY_DATE (1 << 1) /** Sort by date first, undated values last;
+				    a value listed with several dates is kept
+				    only at its earliest one */
+
+#define TAG_SORT_PARALLEL_MIN 8192 /** Smaller listings are sorted by the
+				     calling thread */
+#define TAG_SORT_MAX_THREADS 4
+
+/**
+  Value being sorted.
+  */
+struct tag_sort_row {
+	const gchar *name; /** Tag value */
+	const gchar *date; /** Date or NULL */
+	gchar *key; /** Collation key of the name */
+};
+
+struct tag_sort {
+	GArray *rows; /** struct tag_sort_row */
+	GStringChunk *chunk; /** Storage of names and dates */
+	guint flags; /** TAG_SORT_* flags */
+};
+
+/**
+  @brief Initialize an empty sort.
+  @param sort Sort to initialize.
+  @param flags TAG_SORT_* flags.
+  */
+void tag_sort_init(struct tag_sort *sort, guint flags);
+
+/**
+  @brief Free memory allocated by the sort.
+  @param sort Sort.
+  */
+void tag_sort_free(struct tag_sort *sort);
+
+/**
+  @brief Remove all values.
+  @param sort Sort.
+  @param flags TAG_SORT_* flags of the next sort.
+  */
+void tag_sort_clear(struct tag_sort *sort, guint flags);
+
+/**
+  @brief Add a value to be sorted.
+  @param sort Sort.
+  @param name Tag value or NULL; it's copied.
+  @param date Date of the value or NULL; it's copied.
+  */
+void tag_sort_append(struct tag_sort *sort, const gchar *name, const gchar *date);
+
+/**
+  @brief Compute collation keys and sort the values with a merge sort, so
+  values with equal keys keep their order. Large sorts are split between
+  several threads.
+  @param sort Sort.
+  */
+void tag_sort_run(struct tag_sort *sort);
+
+#endif
@@ -90,41 +90,70 @@ struct mpd_tag_entity *mpd_tag_entity_begin(const struct mpd_pair *pair)
 	return entity;
 }
 
+/**
+  @brief Get the field of an entity holding a tag.
+  @param name Tag name, compared case-insensitively.
+  @returns Pointer to the field or NULL for other tags.
+  */
+static gchar **mpd_tag_entity_field(struct mpd_tag_entity *entity, const char *name)
+{
+	if (!g_ascii_strcasecmp(name, "Genre")) {
+		return &entity->genre;
+	} else if (!g_ascii_strcasecmp(name, "Artist") || !g_ascii_strcasecmp(name, "AlbumArtist")) {
+		return &entity->artist;
+	} else if (!g_ascii_strcasecmp(name, "Album")) {
+		return &entity->album;
+	} else if (!g_ascii_strcasecmp(name, "Date")) {
+		return &entity->date;
+	}
+
+	return NULL;
+}
+
 gboolean mpd_tag_entity_feed(struct mpd_tag_entity *entity, const struct mpd_pair *pair)
 {
+	gchar **field;
+
 	g_assert(entity != NULL);
 	g_assert(pair != NULL);
 
-	if (!g_strcmp0(pair->name, "Genre")) {
-		if (!entity->genre) {
-			entity->genre = g_strdup(pair->value);
-			return TRUE;
-		}
-	} else if (!g_strcmp0(pair->name, "Artist")) {
-		if (!entity->artist) {
-			entity->artist = g_strdup(pair->value);
-			return TRUE;
-		}
-	} else if (!g_strcmp0(pair->name, "AlbumArtist")) {
-		if (!entity->artist) {
-			entity->artist = g_strdup(pair->value);
-			return TRUE;
-		}
-	} else if (!g_strcmp0(pair->name, "Album")) {
-		if (!entity->album) {
-			entity->album = g_strdup(pair->value);
-			return TRUE;
-		}
-	} else if (!g_strcmp0(pair->name, "Date")) {
-		if (!entity->date) {
-			entity->date = g_strdup(pair->value);
-			return TRUE;
-		}
+	field = mpd_tag_entity_field(entity, pair->name);
+	if (field && !*field) {
+		*field = g_strdup(pair->value);
+		return TRUE;
 	}
 
 	return FALSE;
 }
 
+struct mpd_tag_entity *mpd_tag_entity_next(const struct mpd_tag_entity *prev, const struct mpd_pair *pair, const char *tag)
+{
+	struct mpd_tag_entity *entity;
+	gchar **field;
+
+	entity = g_malloc(sizeof(struct mpd_tag_entity));
+
+	entity->genre = g_strdup(prev->genre);
+	entity->artist = g_strdup(prev->artist);
+	entity->album = g_strdup(prev->album);
+	entity->date = g_strdup(prev->date);
+
+	field = mpd_tag_entity_field(entity, tag);
+	if (field) {
+		g_free(*field);
+		*field = NULL;
+	}
+	field = mpd_tag_entity_field(entity, pair->name);
+	if (field) {
+		g_free(*field);
+		*field = NULL;
+	}
+
+	mpd_tag_entity_feed(entity, pair);
+
+	return entity;
+}
+
 void mpd_tag_entity_free(struct mpd_tag_entity *entity)
 {
 	if (entity->genre) {
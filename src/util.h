@@ -44,6 +44,7 @@ struct mpd_tag_entity {
 
 struct mpd_tag_entity *mpd_tag_entity_begin(const struct mpd_pair *pair);
 gboolean mpd_tag_entity_feed(struct mpd_tag_entity *entity, const struct mpd_pair *pair);
+struct mpd_tag_entity *mpd_tag_entity_next(const struct mpd_tag_entity *prev, const struct mpd_pair *pair, const char *tag);
 void mpd_tag_entity_free(struct mpd_tag_entity *entity);
 
 GtkBuilder *load_tab_ui(const char *name);
@@ -65,6 +66,17 @@ struct mpd_tag_entity *mpd_tag_entity_begin(const struct mpd_pair *pair);
   */
 gboolean mpd_tag_entity_feed(struct mpd_tag_entity *entity, const struct mpd_pair *pair);
 
+/**
+  @brief Begin parsing the next entity of a list answer with groups. Group
+  values are only sent when they change, so the new entity keeps values of the
+  previous one except the listed tag and the tag of @a pair.
+  @param prev Previous entity.
+  @param pair First pair in the new entity.
+  @param tag Name of the listed tag.
+  @returns Newly allocated mpd_tag_entity.
+  */
+struct mpd_tag_entity *mpd_tag_entity_next(const struct mpd_tag_entity *prev, const struct mpd_pair *pair, const char *tag);
+
 /**
   @brief Free @a mpd_tag_entity allocated by @a mpd_tag_entity_begin().
   @param entity A @a mpd_tag_entity object.